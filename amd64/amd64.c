@@ -36,7 +36,7 @@ static int8_t gprmap[][4] = {
 	{ REG_AH, REG_AX, REG_EAX, REG_RAX },		/* REG_AH */
 	{ REG_BL, REG_BX, REG_EBX, REG_RBX },		/* REG_BL */
 	{ REG_BH, REG_BX, REG_EBX, REG_RBX },		/* REG_BH */
-	{ REG_CL, REG_CX, REG_ECX, REG_EDX },		/* REG_CL */
+	{ REG_CL, REG_CX, REG_ECX, REG_RCX },		/* REG_CL */
 	{ REG_CH, REG_CX, REG_ECX, REG_RCX },		/* REG_CH */
 	{ REG_DL, REG_DX, REG_EDX, REG_RDX },		/* REG_DL */
 	{ REG_DH, REG_DX, REG_EDX, REG_RDX },		/* REG_DH */
@@ -71,7 +71,7 @@ static int8_t gprmap[][4] = {
 	{ REG_CL, REG_CX, REG_ECX, REG_RCX },		/* REG_ECX */
 	{ REG_DL, REG_DX, REG_EDX, REG_RDX },		/* REG_EDX */
 	{ REG_SIL, REG_SI, REG_ESI, REG_RSI },		/* REG_ESI */
-	{ REG_DIL, REG_DI, REG_RDI, REG_RDI },		/* REG_EDI */
+	{ REG_DIL, REG_DI, REG_EDI, REG_RDI },		/* REG_EDI */
 	{ REG_R8B, REG_R8W, REG_R8D, REG_R8 },		/* REG_R8D */
 	{ REG_R9B, REG_R9W, REG_R9D, REG_R9 },		/* REG_R9D */
 	{ REG_R10B, REG_R10W, REG_R10D, REG_R10 },	/* REG_R10D */
@@ -85,8 +85,9 @@ static int8_t gprmap[][4] = {
 	{ REG_BL, REG_BX, REG_EBX, REG_RBX },		/* REG_RBX */
 	{ REG_CL, REG_CX, REG_ECX, REG_RCX },		/* REG_RCX */
 	{ REG_DL, REG_DX, REG_EDX, REG_RDX },		/* REG_RDX */
+	{ -1, -1, -1, REG_RBP },			/* REG_RBP */
 	{ REG_SIL, REG_SI, REG_ESI, REG_RSI },		/* REG_RSI */
-	{ REG_DIL, REG_DI, REG_EDI, REG_RSI },		/* REG_RDI */
+	{ REG_DIL, REG_DI, REG_EDI, REG_RDI },		/* REG_RDI */
 	{ REG_R8B, REG_R8W, REG_R8D, REG_R8 },		/* REG_R8 */
 	{ REG_R9B, REG_R9W, REG_R9D, REG_R9 },		/* REG_R9 */
 	{ REG_R10B, REG_R10W, REG_R10D, REG_R10 },	/* REG_R10 */
@@ -97,6 +98,10 @@ static int8_t gprmap[][4] = {
 	{ REG_R15B, REG_R15W, REG_R15D, REG_R15 }	/* REG_R15 */
 };
 
+/* Fails to compile unless gprmap has a row for every register. */
+extern char gprmap_rows[sizeof gprmap / sizeof gprmap[0] == REG_R15 + 1 ?
+    1 : -1];
+
 void
 targinit(void)
 {
@@ -351,9 +356,9 @@ pass_emit_call(struct ir_func *fn, struct ir_call *call)
 
 	if (call->ic_firstvararg != -1) {
 		if (nsse == 0)
-			printf("\txorl\t%%eax, %%eax\n");
+			emitf("\txorl\t%%eax, %%eax\n");
 		else
-			printf("\tmovb\t$%d, %%al\n", nsse);
+			emitf("\tmovb\t$%d, %%al\n", nsse);
 	}
 
 	emitf("\tcall\t%s\n", call->ic_fn->is_name);
@@ -364,19 +369,19 @@ pass_emit_call(struct ir_func *fn, struct ir_call *call)
 	sym = call->ic_ret->ie_sym;
 	if (IR_ISBYTE(rety)) {
 		if (sym->is_id != REG_AL)
-			emitf("\tmovb\t%s, %%al\n", sym->is_name);
+			emitf("\tmovb\t%%al, %s\n", sym->is_name);
 	} else if (IR_ISWORD(rety)) {
 		if (sym->is_id != REG_AX)
-			emitf("\tmovw\t%s, %%ax\n", sym->is_name);
+			emitf("\tmovw\t%%ax, %s\n", sym->is_name);
 	} else if (IR_ISLONG(rety)) {
 		if (sym->is_id != REG_EAX)
-			emitf("\tmovl\t%s, %%eax\n", sym->is_name);
+			emitf("\tmovl\t%%eax, %s\n", sym->is_name);
 	} else if (IR_ISQUAD(rety) || IR_ISPTR(rety)) {
 		if (sym->is_id != REG_RAX)
-			emitf("\tmovq\t%s, %%rax\n", sym->is_name);
+			emitf("\tmovq\t%%rax, %s\n", sym->is_name);
 	} else if (IR_ISF64(rety)) {
 		if (sym->is_id != REG_XMM0)
-			emitf("\tmovsd\t%s, %%xmm0\n", sym->is_name);
+			emitf("\tmovsd\t%%xmm0, %s\n", sym->is_name);
 	} else
 		fatalx("pass_emit_call: can't handle return type %d",
 		    rety->it_op);
@@ -437,14 +442,35 @@ pass_ralloc_retreg(struct ir_type *type)
 	}
 }
 
+/*
+ * %rax is used to push stack arguments, to pass the number of vector
+ * registers to varargs functions and, like %xmm0, to move return values
+ * into place.
+ */
+void
+pass_ralloc_clobbers(struct ir_func *fn, struct regset *rs)
+{
+	regset_addreg(rs, REG_RAX);
+	regset_addreg(rs, REG_XMM0);
+}
+
+int
+pass_shrinkwrap_machdep(struct ir_func *fn)
+{
+	return 1;
+}
+
 void
 pass_emit_ret(struct ir_func *fn, struct ir_ret *ret)
 {
 	struct ir_symbol *sym;
 	struct ir_type *rety;
 
-	if (ret->ir_deadret)
+	if (ret->ir_deadret) {
+		if (ret->i_flags & IR_RET_NOFRAME)
+			emitf("\tret\n");
 		return;
+	}
 	if (ret->ir_retexpr != NULL) {
 		rety = ret->ir_retexpr->ie_type;
 		sym = ret->ir_retexpr->ie_sym;
@@ -467,7 +493,9 @@ pass_emit_ret(struct ir_func *fn, struct ir_ret *ret)
 			fatalx("pass_emit_ret: bad return type: %d",
 			    rety->it_op);
 	}
-	if ((struct ir_insn *)ret != TAILQ_LAST(&fn->if_iq, ir_insnq))
+	if (ret->i_flags & IR_RET_NOFRAME)
+		emitf("\tret\n");
+	else if ((struct ir_insn *)ret != TAILQ_LAST(&fn->if_iq, ir_insnq))
 		emitf("\tjmp\t.L%d\n", fn->if_retlab);
 }
 
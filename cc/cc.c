@@ -17,6 +17,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 
+#include <ctype.h>
 #include <err.h>
 #include <errno.h>
 #include <limits.h>
@@ -195,6 +196,10 @@ main(int argc, char **argv)
 					ofile = argv[++i];
 				break;
 			case 'O':
+				/* -Os, -Ospeed, ...: select a cost model. */
+				if (isalpha((unsigned char)argv[i][2]))
+					addarg(zargs, &nzargs, ZARGS_MAX,
+					    argv[i]);
 				break;
 			case 'p':
 				if (strcmp(&argv[i][1], "pg") == 0)
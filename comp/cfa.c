@@ -595,6 +595,37 @@ cfa_bb_append_insn(struct ir_func *fn, struct ir_insn *old,
 	ir_append_insn(fn, old, insn);
 }
 
+/*
+ * Recompute the first and last instruction of each basic block after
+ * instructions were inserted or deleted behind the CFG's back, as the
+ * code generator does. Unlike cfa_buildcfg, the blocks themselves are
+ * kept, so phi arguments still refer to valid blocks. An instruction
+ * without a block belongs to the block of the instruction after it.
+ */
+void
+cfa_bb_resync(struct ir_func *fn)
+{
+	struct cfa_bb *bb;
+	struct ir_insn *insn;
+
+	SIMPLEQ_FOREACH(bb, &fn->if_cfadata->c_bbqh, cb_glolink)
+		bb->cb_first = bb->cb_last = NULL;
+	bb = NULL;
+	for (insn = TAILQ_LAST(&fn->if_iq, ir_insnq); insn != NULL;
+	    insn = TAILQ_PREV(insn, ir_insnq, ii_link)) {
+		if (insn->ii_bb == NULL) {
+			if (bb == NULL)
+				fatalx("cfa_bb_resync: no block for "
+				    "instruction in %s", fn->if_sym->is_name);
+			insn->ii_bb = bb;
+		}
+		bb = insn->ii_bb;
+		if (bb->cb_last == NULL)
+			bb->cb_last = insn;
+		bb->cb_first = insn;
+	}
+}
+
 void
 cfa_cfgsort(struct ir_func *fn, int how)
 {
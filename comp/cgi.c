@@ -25,7 +25,10 @@
 #include <sys/types.h>
 #include <sys/queue.h>
 
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "comp/cgi.h"
 #include "cg.h"
@@ -42,6 +45,131 @@ static struct memarea cgarea;
 static struct cgdatastack *allcgdata;
 static struct cgdatastack *nextcgdata;
 
+#ifdef CG_AUTOMATON
+/*
+ * States of the tree-parsing automaton. The generator gives us the
+ * normalized rules, and we build the states and transitions the first
+ * time they are needed. Costs in a state are relative to its cheapest
+ * nonterminal. States live until the compiler exits, so labeling a node
+ * usually takes one hash lookup.
+ *
+ * The constraints of chain rules may only be evaluated once the right
+ * side of the rule matched. Their outcome is the input of another
+ * transition, which has no operator and only the state as its child.
+ *
+ * The layout of struct cg_data depends on the operator of the node, so
+ * a state keeps one for each operator it was reached with.
+ */
+struct cgopdata {
+	struct	cgopdata *co_link;
+	struct	cg_data co_data;
+	int	co_op;
+};
+
+struct cgstate {
+	struct	cgopdata *cs_opdata;
+	struct	cgstate *cs_link;
+	u_int	cs_decided;	/* Evaluated chain rule constraints. */
+	u_int	cs_true;	/* Constraints that were true. */
+	u_int	cs_pending;	/* Constraints to evaluate next. */
+	short	cs_cost[CG_NALLNTS];
+	short	cs_pattern[CG_NTERMS];
+};
+
+struct cgtrans {
+	struct	cgtrans *ct_link;
+	struct	cgstate *ct_kids[2];
+	struct	cgstate *ct_state;
+	u_int	ct_mask;
+	int	ct_op;
+};
+
+#define CG_HASHSIZE	1024
+#define CG_TRANSHASH	16384
+#define CG_MAXSTATES	8192
+
+static struct memarea cgautoarea;
+static struct cgstate *cgstates[CG_HASHSIZE];
+static struct cgtrans *cgtrans[CG_TRANSHASH];
+static int cgnstates = -1;
+
+static struct cgstate *cgi_label(CGI_IR *);
+static int cgi_predmask(CGI_IR *, u_int *);
+static int cgi_chainpred(CGI_IR *, int);
+static struct cgstate *cgi_trans(int, u_int, struct cgstate **);
+static struct cgstate *cgi_newstate(int, u_int, struct cgstate **);
+static int cgi_addrule(struct cgstate *, struct cg_rule *, int);
+static struct cg_data *cgi_opdata(struct cgstate *, int);
+#endif
+
+#ifdef CG_PROFILE
+/*
+ * Counters for tuning the grammar, written out by cg_profile(). A try
+ * derives a nonterminal with a pattern, and a win is a try that lowered
+ * its cost. With the automaton, tries and wins are only counted when a
+ * state is built. Uses count the patterns the actions were run for and
+ * emits those with an emit string. A pair counts how often a pattern
+ * was used for a leaf of another one, to find hot sequences that could
+ * get a rule of their own.
+ */
+struct cgprof {
+	u_long	cp_tries;
+	u_long	cp_wins;
+	u_long	cp_uses;
+	u_long	cp_emits;
+};
+
+struct cgpair {
+	u_long	cp_count;
+	short	cp_parent;
+	short	cp_kid;
+};
+
+static struct cgprof cgprofpat[CG_NPATTERNS];
+static struct cgprof cgprofnt[CG_NTERMS];
+static u_long cgprofpairs[CG_NPATTERNS][CG_NPATTERNS];
+
+static void cgi_proftry(int, int, int);
+static int cgi_profcmp(const void *, const void *);
+static int cgi_paircmp(const void *, const void *);
+#endif
+
+/*
+ * Instructions may share expressions, see NOTES. A shared node is
+ * labeled only once. Before any action runs, cg_action turns the DAG
+ * into a tree: A shared node is either copied into each parent or
+ * computed once into a new virtual register, whichever is cheaper with
+ * the patterns chosen for its parents.
+ */
+#define CG_MAXSHARED	32
+
+struct cgshared {
+	CGI_IR	*sh_node;
+	void	*sh_state;
+};
+
+struct cguses {
+	CGI_IR	*cu_node;
+	int	cu_leaves;	/* Uses where a pattern has it as a leaf. */
+	int	cu_dupcost;	/* Cost of covering it at each such leaf. */
+	int	cu_mincost;	/* Cost of the cheapest of these covers. */
+};
+
+static struct cgshared cgshared[CG_MAXSHARED];
+static int cgnshared;
+
+static struct cgshared *cgi_findshared(CGI_IR *);
+static void cgi_addshared(CGI_IR *, void *);
+static int cgi_undag(CGI_CTX *, CGI_IR *);
+static CGI_IR *cgi_firstshared(CGI_IR *);
+static int cgi_countuses(CGI_IR *, CGI_IR *);
+static void cgi_plan(CGI_IR **, int, struct cguses *);
+static int cgi_cover(CGI_IR **, int);
+static void cgi_unshare(CGI_IR **, CGI_IR *, CGI_IR *, int *);
+
+static CGI_IR **cgi_subtree(CGI_IR **, int, int);
+static CGI_IR *cgi_actionemit(CGI_CTX *, CGI_IR *, CGI_IR *, int);
+
 void
 cgi_prematch(CGI_IR *ir)
 {
@@ -66,9 +194,8 @@ cgi_malloc(size_t size)
 }
 
 static struct cg_data *
-cgi_getdata(void)
+cgi_getdata(CGI_IR *ir)
 {
-	short *p;
 	struct cg_data *cd;
 	struct cgdatastack *elem;
 
@@ -82,9 +209,8 @@ cgi_getdata(void)
 	}
 
 	cd = &elem->c_data;
-	cd->cd_pattern[0] = -1;
-	for (p = cd->cd_cost; p < &cd->cd_cost[CG_NTERMS]; p++)
-		*p = CG_MAXCOST;
+	cd->cd_slot = cg_slotmap(CGI_IROP(ir));
+	cd->cd_valid = 0;
 	return cd;
 }
 
@@ -99,6 +225,31 @@ void
 cg_start(void)
 {
 	cgi_meminit();
+#ifdef CG_AUTOMATON
+	if (cgnstates == -1) {
+		mem_area_init(&cgautoarea);
+		cgnstates = 0;
+	}
+#endif
+}
+
+/*
+ * Select the cost model by name. The automaton caches states computed
+ * with the costs of the model, so this must be done before selecting
+ * code. Returns -1 if there is no such model.
+ */
+int
+cg_setcostmodel(const char *name)
+{
+	int i;
+
+	for (i = 0; cg_costmodels[i] != NULL; i++) {
+		if (strcmp(cg_costmodels[i], name) == 0) {
+			cg_costmodel = i;
+			return 0;
+		}
+	}
+	return -1;
 }
 
 void
@@ -107,28 +258,350 @@ cgi_recycle(void)
 	nextcgdata = allcgdata;
 }
 
-void
-cg(CGI_IR *ir)
+static void
+cgi_match(CGI_IR *ir)
 {
 	int i;
 	CGI_IR *p;
 	struct cg_data *cd;
 
+	if (CGI_SHARED(ir) && cgi_findshared(ir) != NULL)
+		return;
 	cgi_prematch(ir);
 	for (i = 0; i < ir_nkids[ir->i_op]; i++) {
 		p = CGI_IRCHILD(ir, i);
-		cg(p);
+		cgi_match(p);
 	}
-	cd = cgi_getdata();
+	cd = cgi_getdata(ir);
 	CGI_DATA(ir) = cd;
 	cg_match(ir, cd);
+	if (CGI_SHARED(ir))
+		cgi_addshared(ir, NULL);
+}
+
+#ifdef CG_AUTOMATON_CHECK
+static struct cg_data **checkv;
+static size_t ncheck, maxcheck;
+
+static void
+cgi_savedata(CGI_IR *ir)
+{
+	int i;
+
+	if (ncheck == maxcheck) {
+		maxcheck = maxcheck == 0 ? 64 : maxcheck * 2;
+		checkv = xrealloc(checkv, maxcheck * sizeof *checkv);
+	}
+	checkv[ncheck++] = CGI_GETDATA(ir);
+	for (i = 0; i < ir_nkids[ir->i_op]; i++)
+		cgi_savedata(CGI_IRCHILD(ir, i));
+}
+
+static void
+cgi_checkdata(CGI_IR *ir, CGI_IR *root)
+{
+	int i, nt;
+	struct cg_data *cd, *md;
+
+	cd = checkv[ncheck++];
+	md = CGI_GETDATA(ir);
+	for (nt = 0; nt < CG_NTERMS; nt++) {
+		if (CG_PATTERN(cd, nt) != CG_PATTERN(md, nt)) {
+			CGI_IRDUMP(root);
+			CGI_FATALX("automaton selects pattern %d for "
+			    "nonterminal %d, cg_match %d", CG_PATTERN(cd, nt),
+			    nt, CG_PATTERN(md, nt));
+		}
+	}
+	CGI_DATA(ir) = cd;
+	for (i = 0; i < ir_nkids[ir->i_op]; i++)
+		cgi_checkdata(CGI_IRCHILD(ir, i), root);
+}
+
+/*
+ * Match the tree that the automaton labeled again with cg_match, and
+ * check that both select the same pattern for every nonterminal of
+ * every node. The labels of the automaton are kept.
+ */
+static void
+cgi_checklabel(CGI_IR *ir)
+{
+#ifdef CG_INTERP
+	if (cgi_loaded)
+		return;
+#endif
+	ncheck = 0;
+	cgi_savedata(ir);
+	cgnshared = 0;
+	cgi_match(ir);
+	ncheck = 0;
+	cgi_checkdata(ir, ir);
+}
+#endif
+
+void
+cg(CGI_IR *ir)
+{
+#ifdef CG_AUTOMATON
+	cgnshared = 0;
+	if (cgi_label(ir) != NULL) {
+#ifdef CG_AUTOMATON_CHECK
+		cgi_checklabel(ir);
+#endif
+		return;
+	}
+#endif
+#ifdef CG_INTERP
+	if (cgi_loaded) {
+		CGI_IRDUMP(ir);
+		CGI_FATALX("could not label instruction");
+	}
+#endif
+	cgnshared = 0;
+	cgi_match(ir);
+}
+
+#ifdef CG_AUTOMATON
+/*
+ * Label ir with a state of the automaton. Returns NULL if a node in the
+ * tree has to be matched by cg_match, because of dynamic costs.
+ */
+static struct cgstate *
+cgi_label(CGI_IR *ir)
+{
+	int i;
+	u_int mask;
+	struct cgstate *kids[2] = { NULL, NULL }, *s;
+	struct cgshared *sh;
+
+	if (CGI_SHARED(ir) && (sh = cgi_findshared(ir)) != NULL)
+		return sh->sh_state;
+	cgi_prematch(ir);
+	for (i = 0; i < ir_nkids[ir->i_op]; i++) {
+		if ((kids[i] = cgi_label(CGI_IRCHILD(ir, i))) == NULL)
+			return NULL;
+	}
+	if (cgi_predmask(ir, &mask) == -1)
+		return NULL;
+	s = cgi_trans(ir->i_op, mask, kids);
+	while (s != NULL && s->cs_pending != 0) {
+		mask = 0;
+		for (i = 0; i < sizeof mask * CHAR_BIT; i++) {
+			if (s->cs_pending & 1U << i && cgi_chainpred(ir, i))
+				mask |= 1U << i;
+		}
+		kids[0] = s;
+		kids[1] = NULL;
+		s = cgi_trans(-1, mask, kids);
+	}
+	if (s == NULL)
+		return NULL;
+	CGI_DATA(ir) = cgi_opdata(s, ir->i_op);
+	if (CGI_SHARED(ir))
+		cgi_addshared(ir, s);
+	return s;
+}
+
+static int
+cgi_predmask(CGI_IR *ir, u_int *mask)
+{
+#ifdef CG_INTERP
+	if (cgi_loaded)
+		return cgi_loadpredmask(ir, mask);
+#endif
+	return cg_predmask(ir, mask);
+}
+
+static int
+cgi_chainpred(CGI_IR *ir, int pred)
+{
+#ifdef CG_INTERP
+	if (cgi_loaded)
+		return cgi_loadchainpred(ir, pred);
+#endif
+	return cg_chainpred(ir, pred);
+}
+
+static struct cgstate *
+cgi_trans(int op, u_int mask, struct cgstate **kids)
+{
+	u_int h;
+	struct cgtrans *ct;
+
+	h = op * 31 + mask;
+	h = h * 31 + (u_long)kids[0] / sizeof **kids;
+	h = h * 31 + (u_long)kids[1] / sizeof **kids;
+	h ^= h >> 13;
+	h %= CG_TRANSHASH;
+	for (ct = cgtrans[h]; ct != NULL; ct = ct->ct_link) {
+		if (ct->ct_op == op && ct->ct_mask == mask &&
+		    ct->ct_kids[0] == kids[0] && ct->ct_kids[1] == kids[1])
+			return ct->ct_state;
+	}
+	if (cgnstates >= CG_MAXSTATES)
+		return NULL;
+	ct = mem_alloc(&cgautoarea, sizeof *ct);
+	ct->ct_op = op;
+	ct->ct_mask = mask;
+	ct->ct_kids[0] = kids[0];
+	ct->ct_kids[1] = kids[1];
+	ct->ct_state = cgi_newstate(op, mask, kids);
+	ct->ct_link = cgtrans[h];
+	cgtrans[h] = ct;
+	return ct->ct_state;
+}
+
+/*
+ * Compute the state for a node with operator op, the given outcome of
+ * the constraints and the states of its children. If op is -1, mask is
+ * the outcome of the pending chain rule constraints of kids[0]. Returns
+ * an existing state if there is an equal one.
+ */
+static struct cgstate *
+cgi_newstate(int op, u_int mask, struct cgstate **kids)
+{
+	int changes, cost, i, min;
+	u_int bit, h;
+	struct cg_rule *r;
+	struct cgstate s, *sp;
+
+	if (op == -1) {
+		s = *kids[0];
+		s.cs_decided |= s.cs_pending;
+		s.cs_true |= mask;
+	} else {
+		for (i = 0; i < CG_NALLNTS; i++)
+			s.cs_cost[i] = CG_MAXCOST;
+		for (i = 0; i < CG_NTERMS; i++)
+			s.cs_pattern[i] = -1;
+		s.cs_decided = s.cs_true = 0;
+	}
+
+	for (r = cg_rules; op != -1 && r < &cg_rules[cg_nrules]; r++) {
+		if (r->cr_op != op ||
+		    (r->cr_pred != -1 && !(mask & 1U << r->cr_pred)))
+			continue;
+		cost = r->cr_cost[cg_costmodel];
+		for (i = 0; i < 2; i++) {
+			if (r->cr_kids[i] == -1)
+				continue;
+			if (kids[i] == NULL ||
+			    kids[i]->cs_cost[r->cr_kids[i]] >= CG_MAXCOST)
+				break;
+			cost += kids[i]->cs_cost[r->cr_kids[i]];
+		}
+		if (i == 2)
+			cgi_addrule(&s, r, cost);
+	}
+	do {
+		changes = 0;
+		for (r = cg_rules; r < &cg_rules[cg_nrules]; r++) {
+			if (r->cr_op != -1 ||
+			    (r->cr_pred != -1 &&
+			    !(s.cs_true & 1U << r->cr_pred)) ||
+			    s.cs_cost[r->cr_kids[0]] >= CG_MAXCOST)
+				continue;
+			cost = s.cs_cost[r->cr_kids[0]] +
+			    r->cr_cost[cg_costmodel];
+			changes |= cgi_addrule(&s, r, cost);
+		}
+	} while (changes);
+
+	s.cs_pending = 0;
+	for (r = cg_rules; r < &cg_rules[cg_nrules]; r++) {
+		if (r->cr_op != -1 || r->cr_pred == -1)
+			continue;
+		bit = 1U << r->cr_pred;
+		if (!(s.cs_decided & bit) &&
+		    s.cs_cost[r->cr_kids[0]] < CG_MAXCOST)
+			s.cs_pending |= bit;
+	}
+
+	min = CG_MAXCOST;
+	for (i = 0; i < CG_NALLNTS; i++) {
+		if (s.cs_cost[i] < min)
+			min = s.cs_cost[i];
+	}
+	h = s.cs_decided * 31 + s.cs_true;
+	for (i = 0; i < CG_NALLNTS; i++) {
+		if (s.cs_cost[i] < CG_MAXCOST)
+			s.cs_cost[i] -= min;
+		h = h * 31 + s.cs_cost[i];
+	}
+	for (i = 0; i < CG_NTERMS; i++)
+		h = h * 31 + s.cs_pattern[i];
+
+	h %= CG_HASHSIZE;
+	for (sp = cgstates[h]; sp != NULL; sp = sp->cs_link) {
+		if (sp->cs_decided == s.cs_decided &&
+		    sp->cs_true == s.cs_true &&
+		    memcmp(sp->cs_cost, s.cs_cost, sizeof s.cs_cost) == 0 &&
+		    memcmp(sp->cs_pattern, s.cs_pattern,
+		    sizeof s.cs_pattern) == 0)
+			return sp;
+	}
+	sp = mem_alloc(&cgautoarea, sizeof *sp);
+	*sp = s;
+	sp->cs_opdata = NULL;
+	sp->cs_link = cgstates[h];
+	cgstates[h] = sp;
+	cgnstates++;
+	return sp;
 }
 
 static int
+cgi_addrule(struct cgstate *s, struct cg_rule *r, int cost)
+{
+#ifdef CG_PROFILE
+	if (r->cr_pattern != -1 && r->cr_nt < CG_NTERMS)
+		cgi_proftry(r->cr_pattern, r->cr_nt,
+		    cost < s->cs_cost[r->cr_nt]);
+#endif
+	if (cost >= s->cs_cost[r->cr_nt])
+		return 0;
+	s->cs_cost[r->cr_nt] = cost;
+	if (r->cr_nt < CG_NTERMS)
+		s->cs_pattern[r->cr_nt] = r->cr_pattern;
+	return 1;
+}
+
+static struct cg_data *
+cgi_opdata(struct cgstate *s, int op)
+{
+	int i;
+	uint8_t *slot;
+	struct cgopdata *co;
+	struct cg_data *cd;
+
+	for (co = s->cs_opdata; co != NULL; co = co->co_link) {
+		if (co->co_op == op)
+			return &co->co_data;
+	}
+	co = mem_alloc(&cgautoarea, sizeof *co);
+	co->co_link = s->cs_opdata;
+	co->co_op = op;
+	s->cs_opdata = co;
+	cd = &co->co_data;
+	cd->cd_slot = slot = cg_slotmap(op);
+	cd->cd_valid = 0;
+	for (i = 0; i < CG_NTERMS; i++) {
+		if (s->cs_cost[i] >= CG_MAXCOST)
+			continue;
+		if (slot[i] == CG_NSLOTS)
+			CGI_FATALX("cgi_opdata: no slot for %d", i);
+		cd->cd_valid |= 1U << slot[i];
+		cd->cd_cost[slot[i]] = s->cs_cost[i];
+		cd->cd_pattern[slot[i]] = s->cs_pattern[i];
+	}
+	return cd;
+}
+#endif
+
+static void
 cg_do_action(CGI_CTX *ctx, CGI_IR *insn, CGI_IR **ir, int nt)
 {
 	short idx;
-	int i, pattern, skip = 1;
+	int i, pattern;
 	short *nts;
 	struct cg_data *cd;
 	CGI_IR *n, **p;
@@ -138,42 +611,242 @@ cg_do_action(CGI_CTX *ctx, CGI_IR *insn, CGI_IR **ir, int nt)
 		CGI_IRDUMP(insn);
 		CGI_FATALX("no cg_data for instruction");
 	}
-	pattern = cd->cd_pattern[nt];
+	pattern = CG_PATTERN(cd, nt);
 	idx = cg_pattern_nts[pattern];
 	nts = cg_nts[idx];
 
+#ifdef CG_PROFILE
+	cgprofpat[pattern].cp_uses++;
+	cgprofnt[nt].cp_uses++;
+	if (cg_emitstrs[pattern] != NULL) {
+		cgprofpat[pattern].cp_emits++;
+		cgprofnt[nt].cp_emits++;
+	}
+#endif
 	for (i = 0; nts[i] != -1; i++) {
-		p = cg_pattern_subtree(ir, pattern, i);
-		skip &= cg_do_action(ctx, insn, p, nts[i]);
+		p = cgi_subtree(ir, pattern, i);
+#ifdef CG_PROFILE
+		if (CGI_DATA(*p) != NULL &&
+		    CG_VALID(CGI_GETDATA(*p), nts[i]))
+			cgprofpairs[pattern][CG_PATTERN(CGI_GETDATA(*p),
+			    nts[i])]++;
+#endif
+		cg_do_action(ctx, insn, p, nts[i]);
 	}
 
 	n = *ir;
 	if (cg_emitstrs[pattern] != NULL)
 		CGI_IREMIT(n, cg_emitstrs[pattern]);
-	if (cg_hasaction[pattern]) {
-		*ir = cg_actionemit(ctx, insn, n, pattern);
-		skip = 0;
-	}
-	return skip;
+	if (cg_hasaction[pattern])
+		*ir = cgi_actionemit(ctx, insn, n, pattern);
 }
 
-int
+static CGI_IR **
+cgi_subtree(CGI_IR **ir, int pattern, int n)
+{
+#ifdef CG_INTERP
+	if (cgi_loaded)
+		return cgi_loadsubtree(ir, pattern, n);
+#endif
+	return cg_pattern_subtree(ir, pattern, n);
+}
+
+static CGI_IR *
+cgi_actionemit(CGI_CTX *ctx, CGI_IR *insn, CGI_IR *n, int pattern)
+{
+#ifdef CG_INTERP
+	if (cgi_loaded)
+		return cgi_loadaction(ctx, insn, n, pattern);
+#endif
+	return cg_actionemit(ctx, insn, n, pattern);
+}
+
+void
 cg_action(CGI_CTX *ctx, CGI_IR *ir)
 {
 	CGI_IR *p = ir;
-	int skip;
 	struct cg_data *cd;
 
-	cd = CGI_DATA(ir);
-	if (cd->cd_cost[cg_startnt] >= CG_MAXCOST) {
-		CGI_IRDUMP(ir);
-		CGI_FATALX("could not match instruction");
+	for (;;) {
+		cd = CGI_DATA(ir);
+		if (!CG_VALID(cd, cg_startnt)) {
+			CGI_IRDUMP(ir);
+			CGI_FATALX("could not match instruction");
+		}
+		if (!cgi_undag(ctx, ir))
+			break;
+		cg(ir);
 	}
 
-	skip = cg_do_action(ctx, ir, &p, cg_startnt);
+	cg_do_action(ctx, ir, &p, cg_startnt);
 	if (ir != p)
 		CGI_FATALX("attempted to rewrite top-level insn");
-	return skip;
+}
+
+static struct cgshared *
+cgi_findshared(CGI_IR *ir)
+{
+	int i;
+
+	for (i = 0; i < cgnshared; i++) {
+		if (cgshared[i].sh_node == ir)
+			return &cgshared[i];
+	}
+	return NULL;
+}
+
+/* If the table is full, the node is labeled again at its next use. */
+static void
+cgi_addshared(CGI_IR *ir, void *state)
+{
+	if (cgnshared == CG_MAXSHARED)
+		return;
+	cgshared[cgnshared].sh_node = ir;
+	cgshared[cgnshared].sh_state = state;
+	cgnshared++;
+}
+
+/*
+ * Resolve one shared node of insn. It has no shared nodes below it, so
+ * that moving it into a new instruction does not share anything between
+ * instructions. Copying costs the covers at all pattern leaves it is
+ * used as. Computing it into a register costs the cheapest of these
+ * covers, the assignment and a register use per leaf. If a pattern
+ * covers the node with its inner part, e.g. as an address operand, the
+ * node is always copied. Returns 1 if insn changed and must be labeled
+ * again.
+ */
+static int
+cgi_undag(CGI_CTX *ctx, CGI_IR *insn)
+{
+	int first, uses;
+	struct cguses cu;
+	struct ir_expr *reg, *x;
+	struct ir_insn *asg;
+	CGI_IR *n, *p = insn;
+
+	if ((n = cgi_firstshared(insn)) == NULL)
+		return 0;
+	cu.cu_node = n;
+	cu.cu_leaves = cu.cu_dupcost = 0;
+	cu.cu_mincost = INT_MAX;
+	cgi_plan(&p, cg_startnt, &cu);
+	uses = cgi_countuses(insn, n);
+
+	first = 1;
+	if (uses > cu.cu_leaves ||
+	    cu.cu_mincost + 1 + cu.cu_leaves >= cu.cu_dupcost) {
+		cgi_unshare(&p, n, NULL, &first);
+		return 1;
+	}
+
+	x = (struct ir_expr *)n;
+	reg = ir_newvreg(ctx->cc_fn, x->ie_type);
+	cgi_unshare(&p, n, (CGI_IR *)reg, &first);
+	n->i_refs = 0;
+	asg = ir_asg(reg, x);
+	ir_prepend_insn((struct ir_insn *)insn, asg);
+	ctx->cc_changes = 1;
+	return 1;
+}
+
+/* Returns the first shared node of ir in postorder. */
+static CGI_IR *
+cgi_firstshared(CGI_IR *ir)
+{
+	int i;
+	CGI_IR *n;
+
+	for (i = 0; i < ir_nkids[ir->i_op]; i++) {
+		if ((n = cgi_firstshared(CGI_IRCHILD(ir, i))) != NULL)
+			return n;
+	}
+	return CGI_SHARED(ir) ? ir : NULL;
+}
+
+/* How often n is reached from ir if all shared nodes were copied. */
+static int
+cgi_countuses(CGI_IR *ir, CGI_IR *n)
+{
+	int i, uses = 0;
+
+	if (ir == n)
+		return 1;
+	for (i = 0; i < ir_nkids[ir->i_op]; i++)
+		uses += cgi_countuses(CGI_IRCHILD(ir, i), n);
+	return uses;
+}
+
+/* Walk the patterns that cg_do_action would apply. */
+static void
+cgi_plan(CGI_IR **ir, int nt, struct cguses *cu)
+{
+	int cost, i, pattern;
+	short *nts;
+	CGI_IR **p;
+
+	pattern = CG_PATTERN(CGI_GETDATA(*ir), nt);
+	nts = cg_nts[cg_pattern_nts[pattern]];
+	for (i = 0; nts[i] != -1; i++) {
+		p = cgi_subtree(ir, pattern, i);
+		if (*p == cu->cu_node) {
+			cost = cgi_cover(p, nts[i]);
+			cu->cu_leaves++;
+			cu->cu_dupcost += cost;
+			if (cost < cu->cu_mincost)
+				cu->cu_mincost = cost;
+		}
+		cgi_plan(p, nts[i], cu);
+	}
+}
+
+static int
+cgi_cover(CGI_IR **ir, int nt)
+{
+	int cost, i, pattern;
+	short *nts;
+
+	pattern = CG_PATTERN(CGI_GETDATA(*ir), nt);
+	cost = cg_pattern_cost[pattern][cg_costmodel];
+	nts = cg_nts[cg_pattern_nts[pattern]];
+	for (i = 0; nts[i] != -1; i++)
+		cost += cgi_cover(cgi_subtree(ir, pattern, i), nts[i]);
+	return cost;
+}
+
+/*
+ * Let every pointer to n except the first one point to a copy of n, or
+ * let all of them point to a copy of reg if it is not NULL. Other shared
+ * nodes are entered only once. We note that by clearing their labels,
+ * which are stale afterwards anyway.
+ */
+static void
+cgi_unshare(CGI_IR **ir, CGI_IR *n, CGI_IR *reg, int *first)
+{
+	int i;
+	struct ir_expr *x;
+
+	if (*ir == n) {
+		if (reg != NULL)
+			x = ir_expr_copy((struct ir_expr *)reg);
+		else if (*first) {
+			*first = 0;
+			return;
+		} else {
+			x = ir_expr_copy((struct ir_expr *)n);
+			n->i_refs--;
+		}
+		x->i_refs = 1;
+		*ir = (CGI_IR *)x;
+		return;
+	}
+	if (CGI_SHARED(*ir)) {
+		if (CGI_DATA(*ir) == NULL)
+			return;
+		CGI_DATA(*ir) = NULL;
+	}
+	for (i = 0; i < ir_nkids[(*ir)->i_op]; i++)
+		cgi_unshare(CGI_IRCHILDP(*ir, i), n, reg, first);
 }
 
 void
@@ -185,10 +858,125 @@ cg_finish(void)
 int
 cg_addmatch(struct cg_data *cd, int nt, int p, int cost)
 {
-	if (cost < cd->cd_cost[nt]) {
-		cd->cd_cost[nt] = cost;
-		cd->cd_pattern[nt] = p;
+	int s = cd->cd_slot[nt];
+
+#ifdef CG_PROFILE
+	cgi_proftry(p, nt,
+	    !(cd->cd_valid & 1U << s) || cost < cd->cd_cost[s]);
+#endif
+	if (!(cd->cd_valid & 1U << s) || cost < cd->cd_cost[s]) {
+		cd->cd_valid |= 1U << s;
+		cd->cd_cost[s] = cost;
+		cd->cd_pattern[s] = p;
 		return 1;
 	}
 	return 0;
 }
+
+/*
+ * Write the profile counters to a dump file, one tab separated record
+ * per line, most used first. Nothing is written unless cgg generated
+ * the selector with -p.
+ */
+void
+cg_profile(void)
+{
+#ifdef CG_PROFILE
+	int i, j, n, *ids;
+	struct cgpair *pairs;
+	struct cgprof *cp;
+	FILE *fp;
+
+	fp = dump_open("CG", "profile", "w", 0);
+	ids = xmnalloc(CG_NPATTERNS, sizeof *ids);
+	for (i = 0; i < CG_NPATTERNS; i++)
+		ids[i] = i;
+	qsort(ids, CG_NPATTERNS, sizeof *ids, cgi_profcmp);
+	fprintf(fp, "# kind\tid\tuses\temits\ttries\twins\tname\n");
+	for (i = 0; i < CG_NPATTERNS; i++) {
+		cp = &cgprofpat[ids[i]];
+		fprintf(fp, "%s\t%d\t%lu\t%lu\t%lu\t%lu\t%s: %s\n",
+		    cg_pattern_chain[ids[i]] ? "chain" : "pattern", ids[i],
+		    cp->cp_uses, cp->cp_emits, cp->cp_tries, cp->cp_wins,
+		    cg_ntnames[cg_pattern_nt[ids[i]]],
+		    cg_pattern_names[ids[i]]);
+	}
+	free(ids);
+
+	/* Insertion sort, there are only a few nonterminals. */
+	ids = xmnalloc(CG_NTERMS, sizeof *ids);
+	for (i = 0; i < CG_NTERMS; i++) {
+		for (j = i; j > 0 && cgprofnt[ids[j - 1]].cp_uses <
+		    cgprofnt[i].cp_uses; j--)
+			ids[j] = ids[j - 1];
+		ids[j] = i;
+	}
+	for (i = 0; i < CG_NTERMS; i++) {
+		cp = &cgprofnt[ids[i]];
+		fprintf(fp, "nterm\t%d\t%lu\t%lu\t%lu\t%lu\t%s\n", ids[i],
+		    cp->cp_uses, cp->cp_emits, cp->cp_tries, cp->cp_wins,
+		    cg_ntnames[ids[i]]);
+	}
+	free(ids);
+
+	fprintf(fp, "# pair\tparent\tkid\tcount\n");
+	for (i = n = 0; i < CG_NPATTERNS; i++) {
+		for (j = 0; j < CG_NPATTERNS; j++)
+			n += cgprofpairs[i][j] != 0;
+	}
+	pairs = xmnalloc(n + 1, sizeof *pairs);
+	for (i = n = 0; i < CG_NPATTERNS; i++) {
+		for (j = 0; j < CG_NPATTERNS; j++) {
+			if (cgprofpairs[i][j] == 0)
+				continue;
+			pairs[n].cp_count = cgprofpairs[i][j];
+			pairs[n].cp_parent = i;
+			pairs[n++].cp_kid = j;
+		}
+	}
+	qsort(pairs, n, sizeof *pairs, cgi_paircmp);
+	for (i = 0; i < n; i++)
+		fprintf(fp, "pair\t%d\t%d\t%lu\n", pairs[i].cp_parent,
+		    pairs[i].cp_kid, pairs[i].cp_count);
+	free(pairs);
+	fclose(fp);
+#endif
+}
+
+#ifdef CG_PROFILE
+static void
+cgi_proftry(int p, int nt, int won)
+{
+	cgprofpat[p].cp_tries++;
+	cgprofnt[nt].cp_tries++;
+	if (won) {
+		cgprofpat[p].cp_wins++;
+		cgprofnt[nt].cp_wins++;
+	}
+}
+
+static int
+cgi_profcmp(const void *p, const void *q)
+{
+	const struct cgprof *a = &cgprofpat[*(const int *)p];
+	const struct cgprof *b = &cgprofpat[*(const int *)q];
+
+	if (a->cp_uses != b->cp_uses)
+		return a->cp_uses < b->cp_uses ? 1 : -1;
+	if (a->cp_tries != b->cp_tries)
+		return a->cp_tries < b->cp_tries ? 1 : -1;
+	return *(const int *)p - *(const int *)q;
+}
+
+static int
+cgi_paircmp(const void *p, const void *q)
+{
+	const struct cgpair *a = p, *b = q;
+
+	if (a->cp_count != b->cp_count)
+		return a->cp_count < b->cp_count ? 1 : -1;
+	if (a->cp_parent != b->cp_parent)
+		return a->cp_parent - b->cp_parent;
+	return a->cp_kid - b->cp_kid;
+}
+#endif
@@ -27,7 +27,24 @@ typedef struct {
 #define CGI_IROP(n)		((n)->i_op)
 #define CGI_DATA(n)		((n)->i_auxdata)
 #define CGI_GETDATA(n)		((struct cg_data *)(n)->i_auxdata)
+#define CGI_SHARED(n)		((n)->i_refs > 1)
 #define CGI_IREMIT(n, str)	ir_setemit(n, str)
+
+#define CGI_EMIT_END		IR_EMIT_END
+#define CGI_EMIT_LIT		IR_EMIT_LIT
+#define CGI_EMIT_NODE		IR_EMIT_NODE
+#define CGI_EMIT_SELF		IR_EMIT_SELF
+#define CGI_EMIT_TMP		IR_EMIT_TMP
+#define CGI_EMIT_MD		IR_EMIT_MD
+
+#define CGI_EMIT_FRAMEREG	IR_EMIT_FRAMEREG
+#define CGI_EMIT_PRIMREG	IR_EMIT_PRIMREG
+#define CGI_EMIT_SECREG		IR_EMIT_SECREG
+#define CGI_EMIT_OFF		IR_EMIT_OFF
+#define CGI_EMIT_UNSG		IR_EMIT_UNSG
+#define CGI_EMIT_WORD		IR_EMIT_WORD
+#define CGI_EMIT_HEX		IR_EMIT_HEX
+#define CGI_EMIT_SGN		IR_EMIT_SGN
 #define CGI_IRCHILD(n, ch)					\
 	((ch) == 0 ? (n)->i_l : ((ch) == 1 ? (n)->i_r : NULL))
 #define CGI_IRCHILDP(n, ch)						\
@@ -54,9 +71,20 @@ struct cg_ctx {
 struct cg_data;
 
 void cg_start(void);
+int cg_setcostmodel(const char *);
 void cg_match(CGI_IR *, struct cg_data *);
 void cg(CGI_IR *);
-int cg_action(CGI_CTX *, CGI_IR *);
+void cg_action(CGI_CTX *, CGI_IR *);
 void cg_finish(void);
+void cg_profile(void);
+void cg_load(const char *);
+
+/* Selector tables loaded at run time, see cgi_load.c. */
+extern int cgi_loaded;
+
+CGI_IR **cgi_loadsubtree(CGI_IR **, int, int);
+CGI_IR *cgi_loadaction(CGI_CTX *, CGI_IR *, CGI_IR *, int);
+int cgi_loadpredmask(CGI_IR *, u_int *);
+int cgi_loadchainpred(CGI_IR *, int);
 
 #endif /* COMP_CGI_H */
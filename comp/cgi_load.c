@@ -0,0 +1,550 @@
+/*
+ * Copyright (c) 2008 Stefan Kempf <sisnkemp@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Load a machine grammar at run time, for tuning costs and patterns
+ * without rebuilding the compiler. cgg -t translates the grammar into a
+ * table of normalized rules. These replace the tables of a selector
+ * that was generated with cgg -i, and the automaton in cgi.c labels the
+ * trees with them.
+ *
+ * Constraints and actions are C code, so the loaded grammar may only
+ * use those of the compiled one. They are found by their text. Costs,
+ * emit strings and patterns may change freely, as long as every
+ * nonterminal derived for an operator has a slot in struct cg_data.
+ */
+
+#include <sys/types.h>
+#include <sys/queue.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "comp/cgi.h"
+#include "cg.h"
+
+#include "comp/comp.h"
+#include "comp/ir.h"
+
+#ifdef CG_INTERP
+#define LD_MAXLEAVES	4	/* Like NTSMAX in cgg. */
+#define LD_MAXPREDS	32	/* Bits in a u_int. */
+
+int cgi_loaded;
+
+struct ldpattern {
+	char	**lp_paths;	/* Path to each leaf, "." for the root. */
+	int	lp_action;	/* Compiled pattern with the same action. */
+};
+
+static struct ldpattern *ldpatterns;
+static u_int *ldopmask;		/* Constraints of the rules by operator. */
+static int ldmaxop;
+static int ldpreds[LD_MAXPREDS];
+static short ldntmap[CG_NTERMS];
+static int ldnterms;
+static int ldnpatterns;
+
+static const char *ldfile;
+static char *ldnext;
+static int ldlineno;
+
+static struct {
+	char	*e_name;
+	int	e_val;
+} ldemit[] = {
+	{ "CGI_EMIT_END", CGI_EMIT_END },
+	{ "CGI_EMIT_LIT", CGI_EMIT_LIT },
+	{ "CGI_EMIT_NODE", CGI_EMIT_NODE },
+	{ "CGI_EMIT_SELF", CGI_EMIT_SELF },
+	{ "CGI_EMIT_TMP", CGI_EMIT_TMP },
+	{ "CGI_EMIT_MD", CGI_EMIT_MD },
+	{ "CGI_EMIT_FRAMEREG", CGI_EMIT_FRAMEREG },
+	{ "CGI_EMIT_PRIMREG", CGI_EMIT_PRIMREG },
+	{ "CGI_EMIT_SECREG", CGI_EMIT_SECREG },
+	{ "CGI_EMIT_OFF", CGI_EMIT_OFF },
+	{ "CGI_EMIT_UNSG", CGI_EMIT_UNSG },
+	{ "CGI_EMIT_WORD", CGI_EMIT_WORD },
+	{ "CGI_EMIT_HEX", CGI_EMIT_HEX },
+	{ "CGI_EMIT_SGN", CGI_EMIT_SGN },
+	{ NULL, 0 }
+};
+
+static char *ld_runcgg(const char *);
+static __dead void ld_error(const char *, ...);
+static char *ld_line(const char *);
+static char *ld_word(char **);
+static int ld_num(char **);
+static char *ld_text(char *);
+static int ld_nt(int);
+static void ld_pattern(int);
+static u_char *ld_emit(char *);
+static void ld_rules(int);
+static void ld_checkslots(void);
+
+void
+cg_load(const char *file)
+{
+	char *buf, *name, *s;
+	int i, j, n, nall;
+
+#ifdef CG_PROFILE
+	fatalx("cannot load %s: the profile needs the compiled grammar",
+	    file);
+#endif
+	ldfile = file;
+	ldnext = buf = ld_runcgg(file);
+	s = ld_line("cgg-table");
+	if (ld_num(&s) != 1)
+		ld_error("unknown table version");
+
+	s = ld_line("models");
+	n = ld_num(&s);
+	for (i = 0; i < n; i++) {
+		name = ld_word(&s);
+		if (cg_costmodels[i] == NULL ||
+		    strcmp(cg_costmodels[i], name) != 0)
+			ld_error("cost models differ from compiled grammar");
+	}
+	if (cg_costmodels[n] != NULL)
+		ld_error("cost models differ from compiled grammar");
+
+	s = ld_line("nterms");
+	ldnterms = ld_num(&s);
+	nall = ld_num(&s);
+	if (ldnterms > CG_NTERMS || nall - ldnterms > CG_NALLNTS - CG_NTERMS)
+		ld_error("too many nonterminals, rebuild the compiler");
+	for (i = 0; i < ldnterms; i++) {
+		s = ld_line("nterm");
+		name = ld_word(&s);
+		for (j = 0; j < CG_NTERMS; j++) {
+			if (strcmp(cg_ntnames[j], name) == 0)
+				break;
+		}
+		if (j == CG_NTERMS)
+			ld_error("nonterminal %s is not compiled in", name);
+		ldntmap[i] = j;
+	}
+
+	s = ld_line("preds");
+	if ((n = ld_num(&s)) > LD_MAXPREDS)
+		ld_error("too many constraints");
+	for (i = 0; i < n; i++) {
+		s = ld_text(ld_line("pred"));
+		for (j = 0; cg_predtexts[j] != NULL; j++) {
+			if (strcmp(cg_predtexts[j], s) == 0)
+				break;
+		}
+		if (cg_predtexts[j] == NULL)
+			ld_error("constraint %s is not compiled in", s);
+		ldpreds[i] = j;
+	}
+
+	s = ld_line("patterns");
+	ld_pattern(ld_num(&s));
+	s = ld_line("rules");
+	ld_rules(ld_num(&s));
+	ld_line("end");
+	free(buf);
+
+	ld_checkslots();
+	cg_startnt = ldntmap[0];
+	cgi_loaded = 1;
+}
+
+/* Run cgg -t on the grammar and return its output. */
+static char *
+ld_runcgg(const char *file)
+{
+	char *buf, *cgg;
+	int fd[2], status;
+	pid_t pid;
+	size_t len, size;
+	ssize_t n;
+
+	if ((cgg = getenv("CGG")) == NULL)
+		cgg = "cgg";
+	if (pipe(fd) == -1)
+		fatal("pipe");
+	if ((pid = fork()) == -1)
+		fatal("fork");
+	if (pid == 0) {
+		if (dup2(fd[1], STDOUT_FILENO) == -1)
+			_exit(3);
+		close(fd[0]);
+		close(fd[1]);
+		execlp(cgg, cgg, "-t", file, "-", (char *)NULL);
+		fprintf(stderr, "%s: %s\n", cgg, strerror(errno));
+		_exit(2);
+	}
+	close(fd[1]);
+
+	len = 0;
+	size = 16384;
+	buf = xmalloc(size);
+	for (;;) {
+		if (len == size - 1) {
+			size *= 2;
+			buf = xrealloc(buf, size);
+		}
+		if ((n = read(fd[0], buf + len, size - len - 1)) == -1) {
+			if (errno == EINTR)
+				continue;
+			fatal("read");
+		}
+		if (n == 0)
+			break;
+		len += n;
+	}
+	buf[len] = '\0';
+	close(fd[0]);
+
+	while (waitpid(pid, &status, 0) == -1) {
+		if (errno != EINTR)
+			fatal("waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		fatalx("%s could not translate %s", cgg, file);
+	return buf;
+}
+
+static __dead void
+ld_error(const char *fmt, ...)
+{
+	char buf[256];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof buf, fmt, ap);
+	va_end(ap);
+	fatalx("%s: table line %d: %s", ldfile, ldlineno, buf);
+}
+
+/* Returns the rest of the next line, which must start with kw. */
+static char *
+ld_line(const char *kw)
+{
+	char *s;
+	size_t len;
+
+	if (*ldnext == '\0')
+		ld_error("unexpected end of table");
+	ldlineno++;
+	s = ldnext;
+	if ((ldnext = strchr(s, '\n')) != NULL)
+		*ldnext++ = '\0';
+	else
+		ldnext = s + strlen(s);
+	len = strlen(kw);
+	if (strncmp(s, kw, len) != 0 || (s[len] != ' ' && s[len] != '\0'))
+		ld_error("%s expected", kw);
+	return s[len] == ' ' ? &s[len + 1] : &s[len];
+}
+
+static char *
+ld_word(char **sp)
+{
+	char *s = *sp, *w;
+
+	while (*s == ' ')
+		s++;
+	if (*s == '\0')
+		ld_error("missing field");
+	for (w = s; *s != ' ' && *s != '\0'; s++)
+		continue;
+	if (*s == ' ')
+		*s++ = '\0';
+	*sp = s;
+	return w;
+}
+
+static int
+ld_num(char **sp)
+{
+	char *e, *w;
+	long l;
+
+	w = ld_word(sp);
+	l = strtol(w, &e, 10);
+	if (*e != '\0' || l < SHRT_MIN || l > SHRT_MAX)
+		ld_error("bad number: %s", w);
+	return l;
+}
+
+/* Undo the escapes of cgg in place. */
+static char *
+ld_text(char *s)
+{
+	char *d, *t;
+
+	for (d = t = s; *s != '\0'; s++) {
+		if (*s != '\\') {
+			*d++ = *s;
+			continue;
+		}
+		switch (*++s) {
+		case 'n':
+			*d++ = '\n';
+			break;
+		case 't':
+			*d++ = '\t';
+			break;
+		case '\0':
+			ld_error("bad escape");
+		default:
+			*d++ = *s;
+		}
+	}
+	*d = '\0';
+	return t;
+}
+
+static int
+ld_nt(int nt)
+{
+	if (nt == -1)
+		return -1;
+	if (nt < 0 || nt >= ldnterms + CG_NALLNTS - CG_NTERMS)
+		ld_error("bad nonterminal: %d", nt);
+	return nt < ldnterms ? ldntmap[nt] : CG_NTERMS + nt - ldnterms;
+}
+
+static void
+ld_pattern(int n)
+{
+	char *paths[LD_MAXLEAVES], *s;
+	short nts[LD_MAXLEAVES + 1];
+	int i, j, nleaves;
+	struct ldpattern *lp;
+
+	ldnpatterns = n;
+	ldpatterns = xmnalloc(n, sizeof *ldpatterns);
+	cg_nts = xmnalloc(n, sizeof *cg_nts);
+	cg_pattern_nts = xmnalloc(n, sizeof *cg_pattern_nts);
+	cg_hasaction = xmnalloc(n, sizeof *cg_hasaction);
+	cg_emitstrs = xmnalloc(n, sizeof *cg_emitstrs);
+	cg_pattern_cost = xmnalloc(n, sizeof *cg_pattern_cost);
+
+	for (i = 0; i < n; i++) {
+		s = ld_line("pattern");
+		if (ld_num(&s) != i)
+			ld_error("patterns out of order");
+		for (j = 0; j < CG_NCOSTMODELS; j++)
+			cg_pattern_cost[i][j] = ld_num(&s);
+		for (nleaves = 0; *s != '\0'; nleaves++) {
+			if (nleaves == LD_MAXLEAVES)
+				ld_error("pattern has too many leaves");
+			paths[nleaves] = xstrdup(ld_word(&s));
+			nts[nleaves] = ld_nt(ld_num(&s));
+			if (nts[nleaves] >= CG_NTERMS)
+				ld_error("bad leaf");
+		}
+		nts[nleaves] = -1;
+
+		lp = &ldpatterns[i];
+		lp->lp_paths = xmnalloc(nleaves + 1, sizeof *lp->lp_paths);
+		memcpy(lp->lp_paths, paths, nleaves * sizeof *paths);
+		lp->lp_action = -1;
+		cg_nts[i] = xmnalloc(nleaves + 1, sizeof **cg_nts);
+		memcpy(cg_nts[i], nts, (nleaves + 1) * sizeof *nts);
+		cg_pattern_nts[i] = i;
+		cg_emitstrs[i] = NULL;
+		cg_hasaction[i] = 0;
+
+		if (strncmp(ldnext, "emit", 4) == 0)
+			cg_emitstrs[i] = ld_emit(ld_line("emit"));
+		if (strncmp(ldnext, "action", 6) != 0)
+			continue;
+		s = ld_text(ld_line("action"));
+		for (j = 0; j < CG_NPATTERNS; j++) {
+			if (cg_actiontexts[j] != NULL &&
+			    strcmp(cg_actiontexts[j], s) == 0)
+				break;
+		}
+		if (j == CG_NPATTERNS)
+			ld_error("action %s is not compiled in", s);
+		lp->lp_action = j;
+		cg_hasaction[i] = 1;
+	}
+}
+
+/* Translate emit bytecode, see print_emit in cgg. */
+static u_char *
+ld_emit(char *s)
+{
+	char *e, *w;
+	int i, len, val;
+	u_char *code;
+
+	code = xmalloc(strlen(s) / 2 + 1);
+	for (len = 0; *s != '\0'; len++) {
+		w = ld_word(&s);
+		if (*w >= '0' && *w <= '9') {
+			code[len] = ld_num(&w);
+			continue;
+		}
+		for (val = 0; w != NULL; w = e) {
+			if ((e = strchr(w, '|')) != NULL)
+				*e++ = '\0';
+			for (i = 0; ldemit[i].e_name != NULL; i++) {
+				if (strcmp(ldemit[i].e_name, w) == 0)
+					break;
+			}
+			if (ldemit[i].e_name == NULL)
+				ld_error("bad emit code: %s", w);
+			val |= ldemit[i].e_val;
+		}
+		code[len] = val;
+	}
+	return code;
+}
+
+static void
+ld_rules(int n)
+{
+	char *name, *s;
+	int i, j;
+	struct cg_rule *r;
+
+	for (i = 0; cg_opnames[i].co_name != NULL; i++) {
+		if (cg_opnames[i].co_op > ldmaxop)
+			ldmaxop = cg_opnames[i].co_op;
+	}
+	ldopmask = xcalloc(ldmaxop + 1, sizeof *ldopmask);
+
+	cg_rules = xmnalloc(n, sizeof *cg_rules);
+	cg_nrules = n;
+	for (r = cg_rules; r < &cg_rules[n]; r++) {
+		s = ld_line("rule");
+		r->cr_nt = ld_nt(ld_num(&s));
+		name = ld_word(&s);
+		r->cr_op = -1;
+		if (strcmp(name, "-") != 0) {
+			for (j = 0; cg_opnames[j].co_name != NULL; j++) {
+				if (strcmp(cg_opnames[j].co_name, name) == 0)
+					break;
+			}
+			if (cg_opnames[j].co_name == NULL)
+				ld_error("operator %s is not compiled in",
+				    name);
+			r->cr_op = cg_opnames[j].co_op;
+		}
+		r->cr_kids[0] = ld_nt(ld_num(&s));
+		r->cr_kids[1] = ld_nt(ld_num(&s));
+		r->cr_pattern = ld_num(&s);
+		if (r->cr_pattern < -1 || r->cr_pattern >= ldnpatterns)
+			ld_error("bad pattern: %d", r->cr_pattern);
+		r->cr_pred = ld_num(&s);
+		if (r->cr_pred < -1 || r->cr_pred >= LD_MAXPREDS)
+			ld_error("bad constraint: %d", r->cr_pred);
+		for (j = 0; j < CG_NCOSTMODELS; j++)
+			r->cr_cost[j] = ld_num(&s);
+		if (r->cr_op != -1 && r->cr_pred != -1)
+			ldopmask[r->cr_op] |= 1U << r->cr_pred;
+	}
+}
+
+/*
+ * The layout of struct cg_data for an operator is compiled in. Check
+ * that it has a slot for every nonterminal the loaded rules derive
+ * for the operator, directly or by chain rules.
+ */
+static void
+ld_checkslots(void)
+{
+	char derived[CG_NTERMS];
+	int changes, i, op;
+	uint8_t *slot;
+	struct cg_rule *r;
+
+	for (op = 0; op <= ldmaxop; op++) {
+		memset(derived, 0, sizeof derived);
+		for (r = cg_rules; r < &cg_rules[cg_nrules]; r++) {
+			if (r->cr_op == op && r->cr_nt < CG_NTERMS)
+				derived[r->cr_nt] = 1;
+		}
+		do {
+			changes = 0;
+			for (r = cg_rules; r < &cg_rules[cg_nrules]; r++) {
+				if (r->cr_op != -1 || r->cr_nt >= CG_NTERMS ||
+				    r->cr_kids[0] >= CG_NTERMS ||
+				    derived[r->cr_nt] || !derived[r->cr_kids[0]])
+					continue;
+				derived[r->cr_nt] = changes = 1;
+			}
+		} while (changes);
+
+		slot = cg_slotmap(op);
+		for (i = 0; i < CG_NTERMS; i++) {
+			if (derived[i] && slot[i] == CG_NSLOTS)
+				fatalx("%s: no slot for %s in operator %d, "
+				    "rebuild the compiler", ldfile,
+				    cg_ntnames[i], op);
+		}
+	}
+}
+
+CGI_IR **
+cgi_loadsubtree(CGI_IR **ir, int p, int n)
+{
+	char *path = ldpatterns[p].lp_paths[n];
+
+	if (*path == '.')
+		return ir;
+	for (; *path != '\0'; path++)
+		ir = CGI_IRCHILDP(*ir, *path - '0');
+	return ir;
+}
+
+CGI_IR *
+cgi_loadaction(CGI_CTX *ctx, CGI_IR *insn, CGI_IR *n, int p)
+{
+	return cg_actionemit(ctx, insn, n, ldpatterns[p].lp_action);
+}
+
+int
+cgi_loadpredmask(CGI_IR *n, u_int *mask)
+{
+	int i;
+	u_int m = 0, preds;
+
+	preds = CGI_IROP(n) <= ldmaxop ? ldopmask[CGI_IROP(n)] : 0;
+	for (i = 0; preds != 0; i++, preds >>= 1) {
+		if (preds & 1 && cg_pred(n, ldpreds[i]))
+			m |= 1U << i;
+	}
+	*mask = m;
+	return 0;
+}
+
+int
+cgi_loadchainpred(CGI_IR *n, int pred)
+{
+	return cg_pred(n, ldpreds[pred]);
+}
+#else
+void
+cg_load(const char *file)
+{
+	fatalx("cannot load %s: compiler was not built with cgg -i", file);
+}
+#endif
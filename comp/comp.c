@@ -14,6 +14,7 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <sys/types.h>
 #include <sys/queue.h>
 
 #include <ctype.h>
@@ -23,7 +24,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "comp/cgi.h"
 #include "comp/comp.h"
 #include "comp/ir.h"
 #include "comp/passes.h"
@@ -32,8 +35,10 @@
 
 struct srcpos cursp;
 char *infile = "<stdin>";
+FILE *emitfp;
 size_t xmallocd;
 
+int Cflag;
 int Iflag;
 static int Pflag;
 static int Sflag;
@@ -49,6 +54,7 @@ struct pass {
 
 static struct pass intrapasses[] = {
 	{ pass_deadfuncelim, "deadfuncelim" },
+	{ pass_callorder, "callorder", P_NODUMP },
 	{ pass_emit_header, "emit_header", P_NODUMP }
 };
 
@@ -69,11 +75,15 @@ static struct pass interpasses[] = {
 	{ pass_deadvarelim, "deadvarelim" },
 	{ pass_constfold, "constfold" },
 	{ pass_deadcodeelim, "deadcodeelim" },
+	{ pass_forwsubst, "forwsubst" },
+	{ pass_share, "share" },
 	{ pass_gencode, "gencode", P_SJMPSAFE },
+	{ pass_chordal, "chordal" },
 	{ pass_undo_ssa, "undo_ssa" },
 
 	{ pass_ralloc, "ralloc", P_SJMPSAFE },
 	{ pass_stackoff, "stackoff", P_SJMPSAFE },
+	{ pass_shrinkwrap, "shrinkwrap" },
 	{ pass_gencode, "gencode", P_SJMPSAFE },
 	{ pass_emit_func, "emit_func", P_NODUMP | P_SJMPSAFE }
 };
@@ -84,10 +94,23 @@ static size_t nintrapasses = sizeof intrapasses / sizeof *intrapasses;
 void
 compopt(int ch)
 {
+	char *model;
+
 	switch (ch) {
+	case 'C':
+		Cflag = 1;
+		break;
+	case 'G':
+		cg_load(optarg);
+		break;
 	case 'I':
 		Iflag = 1;
 		break;
+	case 'O':
+		model = strcmp(optarg, "s") == 0 ? "size" : optarg;
+		if (cg_setcostmodel(model) == -1)
+			fatalx("unknown cost model: %s", model);
+		break;
 	case 'P':
 		Pflag = 1;
 		break;
@@ -100,11 +123,41 @@ compopt(int ch)
 	}
 }
 
+static int dumpno = 1;
+static int nfuncs;
+
+/* Passes that work on one function at a time. */
+static void
+compile_func(struct ir_func *fn)
+{
+	size_t i;
+	FILE *fp;
+	struct passinfo pi;
+
+	irfunc = pi.p_fn = fn;
+	for (i = 0; i < ninterpasses; i++) {
+		if (fn->if_flags & IR_FUNC_SETJMP &&
+		    !(interpasses[i].p_flags & P_SJMPSAFE))
+			continue;
+		interpasses[i].p_fn(&pi);
+		if (Iflag && !(interpasses[i].p_flags & P_NODUMP)) {
+			fp = dump_open("IR", interpasses[i].p_name,
+			    nfuncs ? "a" : "w", dumpno + i);
+			if (nfuncs == 0)
+				ir_dump_globals(fp, irprog);
+			ir_dump_func(fp, fn);
+			fclose(fp);
+		}
+	}
+	ir_func_free(fn);
+	irfunc = NULL;
+	nfuncs++;
+}
+
 void
 compile(void)
 {
-	int dumpno = 1;
-	size_t i, j;
+	size_t i;
 	FILE *fp;
 	struct ir_func *fn;
 	struct passinfo pi;
@@ -129,37 +182,104 @@ compile(void)
 		}
 	}
 
-	pi.p_fn = NULL;
-
-	/* Passes that work on one function at a time. */
-	for (j = 0; !SIMPLEQ_EMPTY(&irprog->ip_funq); j++) {
+	while (!SIMPLEQ_EMPTY(&irprog->ip_funq)) {
 		fn = SIMPLEQ_FIRST(&irprog->ip_funq);
 		SIMPLEQ_REMOVE_HEAD(&irprog->ip_funq, if_link);
-		irfunc = pi.p_fn = fn;
-		for (i = 0; i < ninterpasses; i++) {
-			if (fn->if_flags & IR_FUNC_SETJMP &&
-			    !(interpasses[i].p_flags & P_SJMPSAFE))
-				continue;
-			interpasses[i].p_fn(&pi);
-			if (Iflag && !(interpasses[i].p_flags & P_NODUMP)) {
-				fp = dump_open("IR", interpasses[i].p_name,
-				    j ? "a" : "w", dumpno + i);
-				if (j == 0)
-					ir_dump_globals(fp, irprog);
-				ir_dump_func(fp, fn);
-				fclose(fp);
+		compile_func(fn);
+	}
+
+	pi.p_fn = NULL;
+	pass_emit_data(&pi);
+}
+
+/*
+ * Streaming compilation: the front end hands over each function as soon
+ * as it has been generated, and it is compiled and emitted right away.
+ * The whole-program passes do not run. Instead, functions that are
+ * neither global nor used so far are compiled into deferfp, and
+ * compile_finish() emits those that turned out to be used.
+ */
+struct deferred {
+	SIMPLEQ_ENTRY(deferred) d_link;
+	struct	ir_symbol *d_sym;
+	off_t	d_off;
+	off_t	d_len;
+};
+
+static SIMPLEQ_HEAD(, deferred) deferq = SIMPLEQ_HEAD_INITIALIZER(deferq);
+static FILE *deferfp;
+
+void
+compile_start(void)
+{
+	struct passinfo pi;
+
+	pi.p_fn = NULL;
+	pass_emit_header(&pi);
+}
+
+void
+compile_stream(struct ir_func *fn)
+{
+	struct deferred *d;
+
+	pass_deadfuncelim_func(fn);
+	if (fn->if_sym->is_flags & (IR_SYM_USED | IR_SYM_GLOBL)) {
+		compile_func(fn);
+		return;
+	}
+
+	if (deferfp == NULL && (deferfp = tmpfile()) == NULL)
+		fatal("tmpfile");
+	d = xmalloc(sizeof *d);
+	d->d_sym = fn->if_sym;
+	if ((d->d_off = ftello(deferfp)) == -1)
+		fatal("ftello");
+	emitfp = deferfp;
+	compile_func(fn);
+	emitfp = stdout;
+	if ((d->d_len = ftello(deferfp) - d->d_off) < 0)
+		fatal("ftello");
+	SIMPLEQ_INSERT_TAIL(&deferq, d, d_link);
+}
+
+void
+compile_finish(void)
+{
+	char buf[8192];
+	size_t n;
+	off_t left;
+	struct deferred *d;
+	struct passinfo pi;
+
+	pass_deadfuncelim_inits();
+	while ((d = SIMPLEQ_FIRST(&deferq)) != NULL) {
+		SIMPLEQ_REMOVE_HEAD(&deferq, d_link);
+		if (d->d_sym->is_flags & IR_SYM_USED) {
+			if (fseeko(deferfp, d->d_off, SEEK_SET) == -1)
+				fatal("fseeko");
+			for (left = d->d_len; left > 0; left -= n) {
+				n = left < (off_t)sizeof buf ? left : sizeof buf;
+				if (fread(buf, 1, n, deferfp) != n)
+					fatalx("compile_finish: short read");
+				EMITWRITE(buf, 1, n);
 			}
 		}
-		ir_func_free(fn);
+		free(d);
+	}
+	if (deferfp != NULL) {
+		fclose(deferfp);
+		deferfp = NULL;
 	}
 
-	irfunc = pi.p_fn = NULL;
+	pi.p_fn = NULL;
 	pass_emit_data(&pi);
 }
 
 void
 comp_init(void)
 {
+	emitfp = stdout;
 	ntinit(&names);
 	reginit();
 	targinit();
@@ -217,6 +337,7 @@ comp_exit(int s)
 		fprintf(stderr, "instructions: %zu\n", irstats.i_insns);
 		fprintf(stderr, "functions: %zu\n", irstats.i_funcs);
 		fprintf(stderr, "types: %zu\n", irstats.i_types);
+		cg_profile();
 	}
 	exit(s);
 }
@@ -269,7 +390,7 @@ emitf(const char *fmt, ...)
 	va_list ap;
 
 	va_start(ap, fmt);
-	vfprintf(stdout, fmt, ap);
+	vfprintf(emitfp, fmt, ap);
 	va_end(ap);
 }
 
@@ -527,6 +648,50 @@ bitvec_or(struct bitvec *dst, struct bitvec *src)
 		*p++ |= *q++;
 }
 
+void
+bitvec_andnot(struct bitvec *dst, struct bitvec *src)
+{
+	u_int *p, *q;
+	size_t i;
+
+	if (dst->b_nbit != src->b_nbit)
+		fatalx("bitvec_andnot");
+
+	p = dst->b_bits;
+	q = src->b_bits;
+	for (i = 0; i < dst->b_nelem; i++)
+		*p++ &= ~*q++;
+}
+
+/* Returns 1 if p and q have a common bit. */
+int
+bitvec_meet(struct bitvec *p, struct bitvec *q)
+{
+	size_t i;
+
+	if (p->b_nbit != q->b_nbit)
+		fatalx("bitvec_meet");
+
+	for (i = 0; i < p->b_nelem; i++) {
+		if (p->b_bits[i] & q->b_bits[i])
+			return 1;
+	}
+	return 0;
+}
+
+size_t
+bitvec_count(struct bitvec *bv)
+{
+	size_t i, n = 0;
+	u_int bits;
+
+	for (i = 0; i < bv->b_nelem; i++) {
+		for (bits = bv->b_bits[i]; bits != 0; bits &= bits - 1)
+			n++;
+	}
+	return n;
+}
+
 int
 bitvec_cmp(struct bitvec *p, struct bitvec *q)
 {
@@ -598,7 +763,7 @@ emitcstring(FILE *fp, char *str, size_t size)
 			if (isprint(str[i]))
 				fputc(str[i], fp);
 			else
-				fprintf(fp, "\\x%.2x", str[i] & 0xff);
+				fprintf(fp, "\\%.3o", str[i] & 0xff);
 		}
 	}
 	fputs("\"", fp);
@@ -42,14 +42,20 @@ BITVEC(regset, REG_NREGS);
 
 #include "targconf.h"
 
-#define COMPOPTS "IPS"
+#define COMPOPTS "CG:IO:PS"
 
+extern int Cflag;
 extern int Iflag;
 
+struct ir_func;
+
 void compopt(int);
 void comp_init(void);
 __dead void comp_exit(int);
 void compile(void);
+void compile_start(void);
+void compile_stream(struct ir_func *);
+void compile_finish(void);
 void targinit(void);
 
 void setinfile(char *);
@@ -62,11 +68,13 @@ FILE *dump_open(const char *, const char *, const char *, int);
 __dead void fatal(const char *, ...);
 __dead void fatalx(const char *, ...);
 
+extern FILE *emitfp;
+
 void emitf(const char *, ...);
 
-#define emits(str)			fputs(str, stdout)
-#define emitc(c)			putc(c, stdout)
-#define EMITWRITE(ptr, size, nmemb)	fwrite(ptr, size, nmemb, stdout)
+#define emits(str)			fputs(str, emitfp)
+#define emitc(c)			putc(c, emitfp)
+#define EMITWRITE(ptr, size, nmemb)	fwrite(ptr, size, nmemb, emitfp)
 
 void *xmalloc(size_t);
 void *xmnalloc(size_t, size_t);
@@ -87,33 +95,6 @@ extern struct srcpos cursp;
 	*(dst) = *(src);	\
 } while (0)
 
-struct ntent {
-	struct	ntent *n_next;
-	char	*n_name;
-};
-
-#define NTRIE_MAX	54
-#define NTRIE_LTAG	1
-#define NTRIE_RTAG	2
-
-struct ntrie {
-	struct	ntrie *n_llink;
-	struct	ntrie *n_rlink;
-	char	*n_key;
-	int	n_tag;
-	int	n_skip;
-};
-
-struct nametab {
-	struct	ntent *n_names;
-	struct	ntrie *n_tries[NTRIE_MAX];
-};
-
-extern struct nametab names;
-
-void ntinit(struct nametab *);
-char *ntenter(struct nametab *, const char *);
-
 int newid(void);
 
 extern struct ir_symbol *physregs[];
@@ -152,6 +133,31 @@ void *mem_alloc(struct memarea *, size_t);
 void *mem_mnalloc(struct memarea *, size_t, size_t);
 void *mem_calloc(struct memarea *, size_t, size_t);
 
+struct ntent {
+	char	*n_name;
+	size_t	n_len;
+	u_int	n_hash;
+};
+
+struct nametab {
+	struct	ntent *n_tab;
+	size_t	n_size;
+	size_t	n_used;
+	char	*n_strs;	/* Free space in the string arena. */
+	size_t	n_stravail;
+};
+
+extern struct nametab names;
+
+/* FNV-1a, so that a lexer can hash a name while it scans it. */
+#define NTHASH_INIT		2166136261U
+#define NTHASH_STEP(h, c)	(((h) ^ (u_char)(c)) * 16777619U)
+
+void ntinit(struct nametab *);
+u_int nthash(const char *, size_t);
+char *ntenter(struct nametab *, const char *);
+char *ntenterh(struct nametab *, const char *, size_t, u_int);
+
 extern size_t memallocd;
 extern size_t memfreed;
 extern size_t mempeakusage;
@@ -170,6 +176,9 @@ void bitvec_setall(struct bitvec *);
 void bitvec_not(struct bitvec *);
 void bitvec_and(struct bitvec *, struct bitvec *);
 void bitvec_or(struct bitvec *, struct bitvec *);
+void bitvec_andnot(struct bitvec *, struct bitvec *);
+int bitvec_meet(struct bitvec *, struct bitvec *);
+size_t bitvec_count(struct bitvec *);
 int bitvec_cmp(struct bitvec *, struct bitvec *);
 void bitvec_cpy(struct bitvec *, struct bitvec *);
 
@@ -184,6 +193,13 @@ void bitvec_cpy(struct bitvec *, struct bitvec *);
 #define BITVEC_SETALL(bv)	bitvec_setall((struct bitvec *)(bv))
 #define BITVEC_CPY(dst, src)						\
 	bitvec_cpy((struct bitvec *)(dst), (struct bitvec *)(src))
+#define BITVEC_OR(dst, src)						\
+	bitvec_or((struct bitvec *)(dst), (struct bitvec *)(src))
+#define BITVEC_ANDNOT(dst, src)						\
+	bitvec_andnot((struct bitvec *)(dst), (struct bitvec *)(src))
+#define BITVEC_MEET(p, q)						\
+	bitvec_meet((struct bitvec *)(p), (struct bitvec *)(q))
+#define BITVEC_COUNT(bv)	bitvec_count((struct bitvec *)(bv))
 
 struct regconstr {
 	int	*r_regs;
@@ -251,6 +267,7 @@ void cfa_bb_append(struct ir_func *, struct cfa_bb *, struct ir_insn *);
 void cfa_bb_delinsn(struct ir_func *, struct cfa_bb *, struct ir_insn *);
 void cfa_bb_prepend_insn(struct ir_insn *, struct ir_insn *);
 void cfa_bb_append_insn(struct ir_func *, struct ir_insn *, struct ir_insn *);
+void cfa_bb_resync(struct ir_func *);
 
 #define CFA_CFGSORT_ASC		1
 #define CFA_CFGSORT_DESC	-1
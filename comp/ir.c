@@ -160,6 +160,7 @@ iralloc(int op, size_t size)
 	ir->i_auxdata = NULL;
 	ir->i_op = op;
 	ir->i_flags = 0;
+	ir->i_refs = 0;
 	ir->i_emit = NULL;
 	ir->i_tmpregs = NULL;
 	ir->i_tmpregsyms = NULL;
@@ -172,7 +173,6 @@ insnalloc(int op, size_t size)
 	struct ir_insn *insn;
 
 	insn = iralloc(op, size);
-	insn->ii_cgskip = 0;
 	insn->ii_bb = NULL;
 	dfa_initdata(&insn->ii_dfadata);
 	irstats.i_insns++;
@@ -221,9 +221,9 @@ refexpr(struct ir_expr *x)
 {
 	if (x == NULL)
 		return NULL;
-	if (x->i_flags & IR_EXPR_INUSE)
+	if (x->i_refs > 0)
 		x = ir_expr_copy(x);
-	x->i_flags |= IR_EXPR_INUSE;
+	x->i_refs = 1;
 	return x;
 }
 
@@ -350,6 +350,7 @@ ir_func(struct ir_symbol *sym)
 	regset_init(&fn->if_usedregs);
 	fn->if_retlab = newid();
 	fn->if_cfadata = NULL;
+	fn->if_prologue = NULL;
 	fn->if_regid = REG_NREGS;
 	fn->if_flags = 0;
 	irfunc = fn;
@@ -879,6 +880,7 @@ ir_load(struct ir_expr *x, struct ir_type *type)
 struct ir_expr *
 ir_expr_copy(struct ir_expr *x)
 {
+	struct ir_expr *cp;
 	struct ir_symbol *sym;
 
 	if (x == NULL)
@@ -889,8 +891,11 @@ ir_expr_copy(struct ir_expr *x)
 		    ir_expr_copy(x->ie_r), x->ie_type);
 	if (x->i_op == IR_SOUREF)
 		return ir_souref(ir_expr_copy(x->ie_l), x->ie_sou, x->ie_elm);
-	if (IR_ISUNEXPR(x))
-		return ir_unary(x->i_op, ir_expr_copy(x->ie_l), x->ie_type);
+	if (IR_ISUNEXPR(x)) {
+		cp = ir_unary(x->i_op, ir_expr_copy(x->ie_l), x->ie_type);
+		cp->i_flags = x->i_flags;
+		return cp;
+	}
 
 	switch (x->i_op) {
 	case IR_ICON:
@@ -914,6 +919,17 @@ ir_expr_copy(struct ir_expr *x)
 	}
 }
 
+/*
+ * Let one more pointer point to x instead of copying it. Only the
+ * instruction selector can deal with shared expressions, see NOTES.
+ */
+struct ir_expr *
+ir_expr_share(struct ir_expr *x)
+{
+	x->i_refs++;
+	return x;
+}
+
 void
 ir_expr_replace(struct ir_expr **xp, struct ir_expr *newx)
 {
@@ -1050,6 +1066,79 @@ ir_symq_enq(struct ir_symq *sq, struct ir_symbol *sym)
 	SIMPLEQ_INSERT_TAIL(sq, sym, is_link);
 }
 
+/*
+ * Derived types that never change after construction are interned, so
+ * that structurally equal ones are the same object: pointers, qualified
+ * complete types and complete arrays of complete types. Qualified
+ * structs and unions are interned even while incomplete, so that
+ * ir_type_sou_finish can complete them too. Function types get their
+ * parameters and flags after construction, and incomplete arrays may be
+ * completed in place, so those are always allocated anew.
+ */
+#define TT_INITSIZE	1024
+
+static struct ir_type **typetab;
+static size_t typetabsize;
+static size_t typetabused;
+
+static size_t
+typehash(int op, struct ir_type *base, size_t dim)
+{
+	size_t h = (size_t)base;
+
+	h ^= h >> 7;
+	return (h * 31 + op) * 31 + dim;
+}
+
+static size_t
+typekey(struct ir_type *ty)
+{
+	return typehash(ty->it_op, ty->it_base,
+	    ty->it_op == IR_ARR ? ty->it_dim : 0);
+}
+
+static void
+typetabgrow(void)
+{
+	size_t i, j, mask, osize = typetabsize;
+	struct ir_type **otab = typetab;
+
+	typetabsize = osize == 0 ? TT_INITSIZE : osize * 2;
+	typetab = xcalloc(typetabsize, sizeof *typetab);
+	mask = typetabsize - 1;
+	for (i = 0; i < osize; i++) {
+		if (otab[i] == NULL)
+			continue;
+		for (j = typekey(otab[i]) & mask; typetab[j] != NULL;
+		    j = (j + 1) & mask)
+			continue;
+		typetab[j] = otab[i];
+	}
+	free(otab);
+}
+
+/*
+ * Returns the slot of the interned type op/base/dim. The slot is empty
+ * if there is no such type yet.
+ */
+static struct ir_type **
+typelookup(int op, struct ir_type *base, size_t dim)
+{
+	size_t i, mask;
+	struct ir_type *ty;
+
+	if (typetabused >= typetabsize / 2)
+		typetabgrow();
+	mask = typetabsize - 1;
+	for (i = typehash(op, base, dim) & mask;
+	    (ty = typetab[i]) != NULL; i = (i + 1) & mask) {
+		if (ty->it_op == op && ty->it_base == base &&
+		    (op != IR_ARR || ty->it_dim == dim))
+			return &typetab[i];
+	}
+	return &typetab[i];
+}
+
 static struct ir_type *
 typealloc(int op)
 {
@@ -1076,10 +1165,16 @@ ir_type_setflags(struct ir_type *ty, int flags)
 struct ir_type *
 ir_type_qual(struct ir_type *ty, int qual)
 {
-	struct ir_type *type;
+	struct ir_type *type, **slot = NULL;
 
 	if ((ty->it_op & qual) == qual || qual == 0)
 		return ty;
+	if (IR_ISCOMPLETE(ty) || ty->it_op == IR_STRUCT ||
+	    ty->it_op == IR_UNION) {
+		slot = typelookup(qual, ty, 0);
+		if (*slot != NULL)
+			return *slot;
+	}
 	type = typealloc(qual);
 	type->it_base = ty;
 	type->it_dim = ty->it_dim;
@@ -1087,27 +1182,41 @@ ir_type_qual(struct ir_type *ty, int qual)
 	type->it_align = ty->it_align;
 	if (ty->it_flags & IR_COMPLETE)
 		type->it_flags |= IR_COMPLETE;
+	if (slot != NULL) {
+		*slot = type;
+		typetabused++;
+	}
 	return type;
 }
 
 struct ir_type *
 ir_type_ptr(struct ir_type *ty)
 {
-	struct ir_type *type;
+	struct ir_type *type, **slot;
 
+	slot = typelookup(IR_PTR, ty, 0);
+	if (*slot != NULL)
+		return *slot;
 	type = typealloc(IR_PTR);
 	type->it_base = ty;
 	type->it_size = IR_PTR_SIZE;
 	type->it_align = IR_PTR_ALIGN;
 	type->it_flags |= IR_COMPLETE;
+	*slot = type;
+	typetabused++;
 	return type;
 }
 
 struct ir_type *
 ir_type_arr(struct ir_type *ty, size_t dim)
 {
-	struct ir_type *type;
+	struct ir_type *type, **slot = NULL;
 
+	if (dim != 0 && IR_ISCOMPLETE(ty)) {
+		slot = typelookup(IR_ARR, ty, dim);
+		if (*slot != NULL)
+			return *slot;
+	}
 	type = typealloc(IR_ARR);
 	type->it_base = ty;
 	if (dim == 0)
@@ -1118,6 +1227,10 @@ ir_type_arr(struct ir_type *ty, size_t dim)
 	}
 	type->it_align = ty->it_align;
 	type->it_dim = dim;
+	if (slot != NULL) {
+		*slot = type;
+		typetabused++;
+	}
 	return type;
 }
 
@@ -1164,8 +1277,9 @@ soufldalloc(struct ir_typelm *elm, size_t off, int flags)
 void
 ir_type_sou_finish(struct ir_type *ty, int flags)
 {
-	size_t align = 1, off = 0, size = 0;
-	struct ir_type *elmty;
+	static int quals[] = { IR_CONST, IR_VOLAT, IR_CONST | IR_VOLAT };
+	size_t i, align = 1, off = 0, size = 0;
+	struct ir_type *elmty, *qty;
 	struct ir_typelm *elm;
 
 	if (IR_ISQUAL(ty) || (!IR_ISUNION(ty) && !IR_ISSTRUCT(ty)))
@@ -1194,6 +1308,15 @@ ir_type_sou_finish(struct ir_type *ty, int flags)
 	ty->it_align = align;
 	ty->it_size = (size + align * 8 - 1) & ~(align * 8 - 1);
 	ty->it_size /= 8;
+
+	/* Qualified versions made while ty was incomplete. */
+	for (i = 0; i < sizeof quals / sizeof quals[0]; i++) {
+		if ((qty = *typelookup(quals[i], ty, 0)) == NULL)
+			continue;
+		qty->it_size = ty->it_size;
+		qty->it_align = ty->it_align;
+		qty->it_flags |= IR_COMPLETE;
+	}
 }
 
 struct ir_type *
@@ -1251,7 +1374,7 @@ ir_type_dequal(struct ir_type *ty)
 }
 
 void
-ir_setemit(struct ir *ir, char *str)
+ir_setemit(struct ir *ir, u_char *str)
 {
 #if 0
 	struct ir_insn *insn;
@@ -1265,107 +1388,92 @@ ir_setemit(struct ir *ir, char *str)
 	ir->i_emit = str;
 }
 
-#define EMIT_FRAMEREG	0x01
-#define EMIT_PRIMREG	0x02
-#define EMIT_SECREG	0x04
-#define EMIT_OFF	0x08
-#define EMIT_UNSG	0x10
-#define EMIT_WORD	0x20
-#define EMIT_HEX	0x40
-#define EMIT_SGN	0x80
-
 void
 ir_emit(struct ir *node, struct ir *ancestor)
 {
-	int fail, flags, n;
-	char *p, *q;
-	struct ir *ir = node;
-
-	for (p = node->i_emit, flags = 0; *p != '\0'; p++, flags = 0) {
-		for (q = p; *p != '@' && *p != '\0'; p++)
-			continue;
-		EMITWRITE(q, 1, p - q);
-		if (*p == '\0')
-			break;
+	int n, op;
+	u_char *p = node->i_emit;
+	struct ir *ir;
 
-		fail = 1;
-		if (p[1] == '@') {
-			emitc('@');
-			p++;
+	for (;;) {
+		if ((op = *p++) == IR_EMIT_END)
+			return;
+		if (op == IR_EMIT_LIT) {
+			n = *p++;
+			EMITWRITE(p, 1, n);
+			p += n;
 			continue;
 		}
-again:
-		switch (*++p) {
-		case 'A':
-			ir = ancestor;
-			fail = 0;
-			goto again;
-#if 0
-			ir_emit_self(ancestor, 0);
-			break;
-#endif
-		case 'L':
-		case 'R':
-			fail = 0;
-			if ((*p == 'L' && ir_nkids[ir->i_op] < 1) ||
-			    (*p == 'R' && ir_nkids[ir->i_op] < 2)) {
-				fatalx("couldn't get child %c, at %s[%zd]",
-				    *p, node->i_emit, p - node->i_emit);
-			} else if (*p == 'L')
+
+		ir = node;
+		for (n = *p++; n > 0; n--, p++) {
+			if (*p == 'A')
+				ir = ancestor;
+			else if (*p == 'L' && ir_nkids[ir->i_op] >= 1)
 				ir = ir->i_l;
-			else
+			else if (*p == 'R' && ir_nkids[ir->i_op] >= 2)
 				ir = ir->i_r;
-			goto again;
-		case 'D':
-			flags |= EMIT_SGN;
-			goto again;
-		case 'F':
-			flags |= EMIT_FRAMEREG;
-			goto again;
-		case 'O':
-			flags |= EMIT_OFF;
-			goto again;
-		case 'U':
-			flags |= EMIT_UNSG;
-			goto again;
-		case 'X':
-			flags |= EMIT_HEX;
-			goto again;
-		case 'W':
-			flags |= EMIT_WORD;
-			goto again;
-		case 'P':
-		case 'S':
-			flags |= *p == 'P' ? EMIT_PRIMREG : EMIT_SECREG;
-			goto again;
-		case 'T':
-			ir_emit_self((struct ir *)ir, flags);
+			else
+				fatalx("couldn't get child %c of 0x%x", *p,
+				    ir->i_op);
+		}
+
+		switch (op) {
+		case IR_EMIT_NODE:
+			if (ir != ancestor && ir->i_emit != NULL)
+				ir_emit(ir, ancestor);
+			else
+				ir_emit_self(ir, *p);
+			p++;
 			break;
-		case 'Y':
-			n = *++p - '0';
-			emits(ir->i_tmpregsyms[n]->is_name);
+		case IR_EMIT_SELF:
+			ir_emit_self(ir, *p++);
 			break;
-		case 'Z':
-			p = ir_emit_machdep(ir, p);
+		case IR_EMIT_TMP:
+			emits(ir->i_tmpregsyms[*p]->is_name);
+			p++;
+			break;
+		case IR_EMIT_MD:
+			if (ir_emit_machdep(ir, (char *)p) == (char *)p)
+				fatalx("unknown control chars: %c%c%c", p[0],
+				    p[1], p[2]);
+			p += 3;
 			break;
 		default:
-			if (fail) {
-#if 0
-				ir_dump_insn(stderr, node);
-#endif
-				fatalx("unknown control char: %c", *p);
-			}
-			p--;
-			if (ir != ancestor && ir->i_emit != NULL)
-				ir_emit(ir, ancestor);
-			else
-				ir_emit_self(ir, flags);
+			fatalx("ir_emit: bad opcode: %d", op);
 		}
-
-		ir = node;
 	}
 }
 
+static void
+emitunum(uintmax_t val, int base)
+{
+	char buf[sizeof val * 3], *p;
+
+	p = &buf[sizeof buf];
+	do {
+		*--p = "0123456789abcdef"[val % base];
+	} while ((val /= base) != 0);
+	EMITWRITE(p, 1, &buf[sizeof buf] - p);
+}
+
+static void
+emitnum(intmax_t val)
+{
+	if (val < 0) {
+		emitc('-');
+		emitunum(-(uintmax_t)val, 10);
+	} else
+		emitunum(val, 10);
+}
+
+static void
+emitlbl(int id)
+{
+	emits(".L");
+	emitnum(id);
+}
+
 void
 ir_emit_self(struct ir *ir, int flags)
 {
@@ -1382,42 +1490,45 @@ ir_emit_self(struct ir *ir, int flags)
 	case IR_BLE:
 	case IR_BGT:
 	case IR_BGE:
-		emitf(".L%d", b->ib_lbl->il_id);
+		emitlbl(b->ib_lbl->il_id);
 		break;
 	case IR_ICON:
 		if (IR_ISPTR(x->ie_type) || IR_ISUNSIGNED(x->ie_type) ||
-		    (flags & (EMIT_UNSG | EMIT_HEX))) {
+		    (flags & (IR_EMIT_UNSG | IR_EMIT_HEX))) {
 			mask = ~0;
-			if (flags & EMIT_WORD)
+			if (flags & IR_EMIT_WORD)
 				mask = 0xffff;
-			if (flags & EMIT_HEX)
-				emitf("0x%jx", x->ie_con.ic_ucon & mask);
-			else
-				emitf("%ju", x->ie_con.ic_ucon & mask);
-		} else if (IR_ISSIGNED(x->ie_type) || (flags & EMIT_SGN))
-			emitf("%jd", x->ie_con.ic_icon);
+			if (flags & IR_EMIT_HEX) {
+				emits("0x");
+				emitunum(x->ie_con.ic_ucon & mask, 16);
+			} else
+				emitunum(x->ie_con.ic_ucon & mask, 10);
+		} else if (IR_ISSIGNED(x->ie_type) || (flags & IR_EMIT_SGN))
+			emitnum(x->ie_con.ic_icon);
 		else
 			goto bad;
 		break;
 	case IR_REG:
 		sym = x->ie_sym;
-		if (flags & EMIT_PRIMREG) {
+		if (flags & IR_EMIT_PRIMREG) {
 			ir_emit_regpair(sym, 0);
 			break;
-		} else if (flags & EMIT_SECREG) {
+		} else if (flags & IR_EMIT_SECREG) {
 			ir_emit_regpair(sym, 1);
 			break;
 		}
 		if (sym->is_name != NULL)
 			emits(sym->is_name);
-		else
-			emitf("%%r_%d", sym->is_id);
+		else {
+			emits("%r_");
+			emitnum(sym->is_id);
+		}
 		break;
 	case IR_GVAR:
 	case IR_GADDR:
 		sym = x->ie_sym;
 		if (sym->is_op == IR_CSTRSYM)
-			emitf(".L%d", sym->is_id);
+			emitlbl(sym->is_id);
 		else
 			emits(sym->is_name);
 		break;
@@ -1425,11 +1536,11 @@ ir_emit_self(struct ir *ir, int flags)
 	case IR_PVAR:
 	case IR_LADDR:
 	case IR_PADDR:
-		if (flags & EMIT_FRAMEREG) {
+		if (flags & IR_EMIT_FRAMEREG) {
 			emits(physregs[TARG_FRAMEREG]->is_name);
 			break;
-		} else if (flags & EMIT_OFF) {
-			emitf("%zd", x->ie_sym->is_off);
+		} else if (flags & IR_EMIT_OFF) {
+			emitnum(x->ie_sym->is_off);
 			break;
 		}
 	default:
@@ -193,7 +193,7 @@ struct ir_phiarg {
 SIMPLEQ_HEAD(ir_phiargq, ir_phiarg);
 
 #define IR_HEADER				\
-	char	*i_emit;			\
+	u_char	*i_emit;			\
 	union {					\
 		void	*_auxdata;		\
 	} u;					\
@@ -221,7 +221,8 @@ SIMPLEQ_HEAD(ir_phiargq, ir_phiarg);
 	struct	tmpreg **i_tmpregs;		\
 	struct	ir_symbol **i_tmpregsyms;	\
 	short	i_op;				\
-	short	i_flags
+	short	i_flags;			\
+	short	i_refs
 
 #define i_auxdata	u._auxdata
 #define i_l		ul._l
@@ -250,7 +251,9 @@ SIMPLEQ_HEAD(ir_phiargq, ir_phiarg);
 #define ip_sym		ul._sym
 #define ip_args		um._phiargs
 
-#define IR_EXPR_INUSE	0x1
+/* Bits in i_flags. */
+#define IR_RET_NOFRAME	0x2	/* IR_RET: Leave without an epilogue. */
+#define IR_LOAD_VOLAT	0x4	/* IR_LOAD: Reads a volatile object. */
 
 struct ir {
 	IR_HEADER;
@@ -363,6 +366,7 @@ struct ir_func {
 	struct	memarea if_livevarmem;
 	struct	ir_symbol *if_sym;
 	struct	cfadata *if_cfadata;
+	struct	ir_insn *if_prologue;	/* Prologue goes after this label. */
 	size_t	if_framesz;
 	size_t	if_argareasz;
 	int	if_retlab;
@@ -378,6 +382,8 @@ struct ir_func {
 #define IR_FUNC_VARARGS		2
 #define IR_FUNC_SETJMP		4
 #define IR_FUNC_PROTSTACK	8
+#define IR_FUNC_NOFRAME		16
+#define IR_FUNC_CHORDAL		32
 
 extern struct ir_func *irfunc;
 
@@ -403,7 +409,7 @@ struct ir_expr {
 	TAILQ_ENTRY(ir_insn) ii_link;		\
 	struct	dfadata ii_dfadata;		\
 	struct	cfa_bb *ii_bb;			\
-	int8_t	ii_cgskip
+	TAILQ_ENTRY(ir_insn) ii_cglink
 
 struct ir_insn {
 	IR_INSN_HEADER;
@@ -452,6 +458,7 @@ struct ir_symbol {
 		struct	ir_symbol *_top;
 		struct	node *_node;
 		struct	ir_insn *_lbl;
+		struct	regset *_clobbers;
 	} u;
 	int	is_id;
 	short	is_flags;
@@ -461,6 +468,7 @@ struct ir_symbol {
 #define is_top	u._top
 #define is_node	u._node
 #define is_lbl	u._lbl
+#define is_clobbers	u._clobbers
 };
 
 struct ir_syminit {
@@ -536,6 +544,7 @@ int ir_cast_canskip(struct ir_expr *, struct ir_type *);
 struct ir_expr *ir_load(struct ir_expr *, struct ir_type *);
 
 struct ir_expr *ir_expr_copy(struct ir_expr *);
+struct ir_expr *ir_expr_share(struct ir_expr *);
 void ir_expr_replace(struct ir_expr **, struct ir_expr *);
 void ir_expr_free(struct ir_expr *);
 void ir_expr_thisfree(struct ir_expr *);
@@ -567,7 +576,29 @@ void ir_dump_func(FILE *, struct ir_func *);
 void ir_dump_insn(FILE *, struct ir_insn *);
 void ir_dump_symbol(FILE *, struct ir_symbol *);
 
-void ir_setemit(struct ir *, char *);
+/*
+ * cgg translates the emit strings of the machine grammar into this
+ * bytecode. Operands start with a path from the node to the operand:
+ * its length, followed by 'A' for the ancestor, 'L' for the left and
+ * 'R' for the right child.
+ */
+#define IR_EMIT_END	0
+#define IR_EMIT_LIT	1	/* Length, text. */
+#define IR_EMIT_NODE	2	/* Path, flags. Uses emit string of node. */
+#define IR_EMIT_SELF	3	/* Path, flags. */
+#define IR_EMIT_TMP	4	/* Path, number of temporary register. */
+#define IR_EMIT_MD	5	/* Path, 'Z' and two letters. */
+
+#define IR_EMIT_FRAMEREG	0x01
+#define IR_EMIT_PRIMREG		0x02
+#define IR_EMIT_SECREG		0x04
+#define IR_EMIT_OFF		0x08
+#define IR_EMIT_UNSG		0x10
+#define IR_EMIT_WORD		0x20
+#define IR_EMIT_HEX		0x40
+#define IR_EMIT_SGN		0x80
+
+void ir_setemit(struct ir *, u_char *);
 
 void ir_emit(struct ir *, struct ir *);
 char *ir_emit_machdep(struct ir *, char *);
@@ -15,152 +15,122 @@
  */
 
 /*
- * See the section about PATRICIA in Knuth vol. 3 for an explanation.
+ * Names are interned in an open-addressing hash table with linear
+ * probing. The strings live in an arena together with their lengths and
+ * hashes, so a probe compares hash and length before the bytes. Callers
+ * that already know the length and hash of a name, like the lexer, can
+ * enter it without a NUL-terminated copy.
  */
 
 #include <sys/types.h>
 #include <sys/queue.h>
 
-#include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "comp/comp.h"
 
-#define ISLEAF(t)	((t)->n_data != NULL)
-#define BOTHLEAVES(t)	((t)->n_l->n_data != NULL && (t)->n_r->n_data != NULL)
-#define LEFTLEAF(t)	((t)->n_l->n_data != NULL && (t)->n_r->n_data == NULL)
-#define RIGHTLEAF(t)	((t)->n_l->n_data == NULL && (t)->n_r->n_data != NULL)
+#define NT_INITSIZE	4096
+#define NT_STRBLOCK	65536
 
 struct nametab names;
 
-static char *insert(struct ntrie *, const char *);
-static struct ntrie *find(struct ntrie *, const char *, size_t,
-    struct ntrie **, size_t *);
-
 void
 ntinit(struct nametab *nt)
 {
-	int i;
-
 	if (nt == NULL)
 		fatalx("ntinit: nt == NULL");
-	nt->n_names = NULL;
-	for (i = 0; i < NTRIE_MAX; i++)
-		nt->n_tries[i] = NULL;
+	nt->n_size = NT_INITSIZE;
+	nt->n_used = 0;
+	nt->n_tab = xcalloc(nt->n_size, sizeof *nt->n_tab);
+	nt->n_strs = NULL;
+	nt->n_stravail = 0;
 }
 
-char *
-ntenter(struct nametab *nt, const char *name)
+u_int
+nthash(const char *name, size_t len)
 {
-	char *rv;
-	struct ntrie **rootp, *t;
+	u_int h = NTHASH_INIT;
 
-	if (nt == NULL)
-		fatalx("ntenter: nt == NULL");
-	if (name == NULL)
-		fatalx("ntenter: name == NULL");
-
-	if (*name == '_')
-		rootp = &nt->n_tries[0];
-	else if (*name >= 'a' && *name <= 'z')
-		rootp = &nt->n_tries[*name - 'a'];
-	else if (*name >= 'A' && *name <= 'Z')
-		rootp = &nt->n_tries[*name - 'A'];
-	else
-		rootp = &nt->n_tries[NTRIE_MAX - 1];
-
-	if (*rootp == NULL) {
-		t = xmalloc(sizeof *t);
-		t->n_key = strdup(name);
-		t->n_llink = t;
-		t->n_tag = NTRIE_LTAG;
-		*rootp = t;
-		return t->n_key;
-	} 
-	rv = insert(*rootp, name);
-	return rv;
+	while (len-- > 0)
+		h = NTHASH_STEP(h, *name++);
+	return h;
 }
 
+/*
+ * Strings are packed without alignment. Names that do not fit into
+ * the rest of the current block get a new block.
+ */
 static char *
-insert(struct ntrie *head, const char *name)
+stralloc(struct nametab *nt, size_t len)
 {
-	int diff, l, t;
-	size_t i, j, n;
-	struct ntrie *p, *q, *r;
-
-	n = strlen(name);
-	p = find(head, name, (n + 1) * 8, &q, &j);
-	for (i = 0; name[i] && p->n_key[i]; i++) {
-		if (name[i] != p->n_key[i])
-			break;
-	}
-	if (p->n_key[i] == '\0' && name[i] == '\0')
-		return p->n_key;
-	diff = name[i] ^ p->n_key[i];
-	for (l = i * 8; !(diff & 1); diff >>= 1)
-		l++;
-
-	p = find(head, name, l, &q, &j);
-	r = xmalloc(sizeof *r);
-	r->n_key = strdup(name);
-	if (q->n_llink == p) {
-		q->n_llink = r;
-		t = q->n_tag & NTRIE_LTAG;
-		q->n_tag &= ~NTRIE_LTAG;
-	} else {
-		q->n_rlink = r;
-		t = q->n_tag & NTRIE_RTAG;
-		q->n_tag &= ~NTRIE_RTAG;
-	}
-	
-	if (name[l >> 3] & (1 << (l & 7))) {
-		r->n_tag = NTRIE_RTAG | (t ? NTRIE_LTAG : 0);
-		r->n_rlink = r;
-		r->n_llink = p;
-	} else {
-		r->n_tag = NTRIE_LTAG | (t ? NTRIE_RTAG : 0);
-		r->n_llink = r;
-		r->n_rlink = p;
-	}
-	if (t)
-		r->n_skip = 1 + l - j;
-	else {
-		r->n_skip = 1 + l - j + p->n_skip;
-		p->n_skip = j - l - 1;
+	char *p;
+
+	if (len > nt->n_stravail) {
+		if (len > NT_STRBLOCK / 4)
+			return xmalloc(len);
+		nt->n_strs = xmalloc(NT_STRBLOCK);
+		nt->n_stravail = NT_STRBLOCK;
 	}
+	p = nt->n_strs;
+	nt->n_strs += len;
+	nt->n_stravail -= len;
+	return p;
+}
 
-	return r->n_key;
+static void
+grow(struct nametab *nt)
+{
+	size_t i, j, mask, osize = nt->n_size;
+	struct ntent *otab = nt->n_tab;
+
+	nt->n_size *= 2;
+	nt->n_tab = xcalloc(nt->n_size, sizeof *nt->n_tab);
+	mask = nt->n_size - 1;
+	for (i = 0; i < osize; i++) {
+		if (otab[i].n_name == NULL)
+			continue;
+		for (j = otab[i].n_hash & mask; nt->n_tab[j].n_name != NULL;
+		    j = (j + 1) & mask)
+			continue;
+		nt->n_tab[j] = otab[i];
+	}
+	free(otab);
 }
 
-static struct ntrie *
-find(struct ntrie *head, const char *name, size_t n, struct ntrie **qp,
-    size_t *jp)
+char *
+ntenterh(struct nametab *nt, const char *name, size_t len, u_int hash)
 {
-	int j = 0;
-	struct ntrie *p, *q;
-
-	*qp = q = p = head;
-	*jp = j;
-	p = q->n_llink;
-	if (q->n_tag & NTRIE_LTAG)
-		return p;
-	for (;;) {
-		j += p->n_skip;
-		if (j > n)
-			break;
-		q = p;
-		if (name[(j - 1) >> 3] & (1 << ((j - 1) & 7))) {
-			p = q->n_rlink;
-			if (q->n_tag & NTRIE_RTAG)
-				break;
-		} else {
-			p = q->n_llink;
-			if (q->n_tag & NTRIE_LTAG)
-				break;
-		}
+	size_t i, mask;
+	struct ntent *e;
+
+	if (nt->n_used >= nt->n_size / 2)
+		grow(nt);
+	mask = nt->n_size - 1;
+	for (i = hash & mask; (e = &nt->n_tab[i])->n_name != NULL;
+	    i = (i + 1) & mask) {
+		if (e->n_hash == hash && e->n_len == len &&
+		    memcmp(e->n_name, name, len) == 0)
+			return e->n_name;
 	}
+	e->n_name = stralloc(nt, len + 1);
+	memcpy(e->n_name, name, len);
+	e->n_name[len] = '\0';
+	e->n_len = len;
+	e->n_hash = hash;
+	nt->n_used++;
+	return e->n_name;
+}
 
-	*qp = q;
-	*jp = j;
-	return p;
+char *
+ntenter(struct nametab *nt, const char *name)
+{
+	size_t len;
+
+	if (nt == NULL)
+		fatalx("ntenter: nt == NULL");
+	if (name == NULL)
+		fatalx("ntenter: name == NULL");
+	len = strlen(name);
+	return ntenterh(nt, name, len, nthash(name, len));
 }
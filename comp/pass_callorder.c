@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2008 Stefan Kempf <sisnkemp@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Reorder the functions of the program, so that callees are compiled
+ * before their callers wherever the call graph allows it. The register
+ * allocator can then use the registers clobbered by an already compiled
+ * callee instead of assuming that all volatile registers are clobbered.
+ */
+
+#include <sys/types.h>
+#include <sys/queue.h>
+
+#include <stdlib.h>
+
+#include "comp/comp.h"
+#include "comp/ir.h"
+#include "comp/passes.h"
+
+static struct ir_func **funcs;
+static uint8_t *visited;
+static int *bysym;		/* Indices in funcs, sorted by symbol. */
+static int nfuncs;
+
+static int
+symcmp(const void *p, const void *q)
+{
+	struct ir_symbol *a = funcs[*(const int *)p]->if_sym;
+	struct ir_symbol *b = funcs[*(const int *)q]->if_sym;
+
+	return a < b ? -1 : a > b;
+}
+
+/*
+ * Return the index in funcs of the function defined by sym, or -1 if
+ * sym is not defined in this program.
+ */
+static int
+funcindex(struct ir_symbol *sym)
+{
+	int lo, hi, mid;
+	struct ir_symbol *msym;
+
+	lo = 0;
+	hi = nfuncs - 1;
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		msym = funcs[bysym[mid]]->if_sym;
+		if (msym == sym)
+			return bysym[mid];
+		if (msym < sym)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return -1;
+}
+
+static void
+visit(int i)
+{
+	int j;
+	struct ir_insn *insn;
+	struct ir_symbol *sym;
+
+	visited[i] = 1;
+	TAILQ_FOREACH(insn, &funcs[i]->if_iq, ii_link) {
+		if (insn->i_op != IR_CALL)
+			continue;
+		sym = insn->ic_fn;
+		if (sym->is_op != IR_FUNSYM)
+			continue;
+		if ((j = funcindex(sym)) == -1 || visited[j])
+			continue;
+		visit(j);
+	}
+	SIMPLEQ_INSERT_TAIL(&irprog->ip_funq, funcs[i], if_link);
+}
+
+void
+pass_callorder(struct passinfo *pi)
+{
+	int i;
+	struct ir_func *fn;
+
+	nfuncs = 0;
+	SIMPLEQ_FOREACH(fn, &irprog->ip_funq, if_link)
+		nfuncs++;
+	if (nfuncs < 2)
+		return;
+	funcs = xmnalloc(nfuncs, sizeof *funcs);
+	visited = xcalloc(nfuncs, sizeof *visited);
+	bysym = xmnalloc(nfuncs, sizeof *bysym);
+	i = 0;
+	while (!SIMPLEQ_EMPTY(&irprog->ip_funq)) {
+		fn = SIMPLEQ_FIRST(&irprog->ip_funq);
+		SIMPLEQ_REMOVE_HEAD(&irprog->ip_funq, if_link);
+		bysym[i] = i;
+		funcs[i++] = fn;
+	}
+	qsort(bysym, nfuncs, sizeof *bysym, symcmp);
+
+	for (i = 0; i < nfuncs; i++) {
+		if (!visited[i])
+			visit(i);
+	}
+	free(funcs);
+	free(visited);
+	free(bysym);
+}
@@ -0,0 +1,1233 @@
+/*
+ * Copyright (c) 2008 Stefan Kempf <sisnkemp@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Experimental register allocator for code in SSA form, enabled with -C.
+ * It is based on:
+ * Sebastian Hack and Gerhard Goos: Optimal Register Allocation for
+ * SSA-form Programs in Polynomial Time.
+ * and
+ * Florent Bouchez, Alain Darte and Fabrice Rastello: On the Complexity
+ * of Spill Everywhere under SSA Form.
+ *
+ * The interference graph of an SSA program is chordal. Its nodes can be
+ * colored in the order of their definitions along a preorder walk of
+ * the dominator tree, if the register pressure is low enough everywhere.
+ * So we first spill values everywhere at the points of maximum pressure,
+ * then color and finally try to give copy-related values the same
+ * register. Phi functions are replaced by parallel copies on the
+ * incoming edges.
+ *
+ * Functions with register constraints from the code generator, indirect
+ * calls or edges we cannot put copies on are left to pass_ralloc. This
+ * includes every function with temporary registers (i_tmpregs), which
+ * the code generator requests for most two-address code such as mul and
+ * sub on amd64 and for much of the powerpc code. So the allocator only
+ * runs on a small share of real functions.
+ */
+
+#include <sys/types.h>
+#include <sys/queue.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "comp/comp.h"
+#include "comp/ir.h"
+#include "comp/passes.h"
+
+#define ROUNDS_MAX	64
+#define NCLASSES	(sizeof regclasses / sizeof regclasses[0])
+
+static struct memarea mem;
+static struct ir_func *curfn;
+static size_t nregs;
+static int firsttmp;
+
+static int *color;		/* Assigned register. */
+static int *forced;		/* Register required by a call. */
+static int *pref;		/* Preferred register. */
+static int *rclass;
+static int *nuses;
+static int *span;		/* Number of points where a value is live. */
+static int *nforbid;
+static struct ir_insn **defs;
+static struct cfa_bb **defbb;
+static struct ir_symbol **mate;	/* Copy-related value. */
+static struct regset *forbid;	/* Registers a value must not overlap. */
+static struct bitvec *phirel;
+static struct bitvec **bbin, **bbout, **phidef;
+static struct ir_symq slotq;
+static struct regset occupied;
+
+static int notssa;
+static struct ir_insn *failinsn;
+static struct ir_symbol *failsym;
+
+struct pcopy {
+	int	p_dst;
+	int	p_src;
+	struct	ir_type *p_type;
+	struct	ir_symbol *p_mem;
+};
+
+static int
+isvreg(size_t id)
+{
+	return id >= REG_NREGS && id < nregs && curfn->if_regs[id] != NULL;
+}
+
+static int
+regconflict(int a, int b)
+{
+	return BITVEC_ISSET(&reg_confsets[a], b);
+}
+
+static int
+exprok(struct ir_expr *x)
+{
+	for (;;) {
+		if (x->i_tmpregs != NULL)
+			return 0;
+		if (IR_ISBINEXPR(x)) {
+			if (!exprok(x->ie_r))
+				return 0;
+			x = x->ie_l;
+		} else if (IR_ISUNEXPR(x))
+			x = x->ie_l;
+		else
+			return x->i_op != IR_REG || x->ie_regs == NULL;
+	}
+}
+
+/*
+ * Check if we can handle the function at all.
+ */
+static int
+funcok(struct ir_func *fn)
+{
+	int nsucc;
+	struct cfa_bb *bb, *p, *t;
+	struct cfa_bblink *bbl, *bbl2;
+	struct ir_expr *x;
+	struct ir_insn *insn, *last;
+
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (insn->i_tmpregs != NULL)
+			return 0;
+		if (insn->i_op == IR_B || insn->i_op == IR_LBL ||
+		    insn->i_op == IR_PHI)
+			continue;
+		if (IR_ISBRANCH(insn)) {
+			if (!exprok(insn->ib_l) || !exprok(insn->ib_r))
+				return 0;
+			continue;
+		}
+		switch (insn->i_op) {
+		case IR_ASG:
+		case IR_ST:
+			if (!exprok(insn->is_l) || !exprok(insn->is_r))
+				return 0;
+			break;
+		case IR_CALL:
+			if (insn->ic_fn->is_op == IR_REGSYM)
+				return 0;
+			if (insn->ic_ret != NULL && !exprok(insn->ic_ret))
+				return 0;
+			SIMPLEQ_FOREACH(x, &insn->ic_argq, ie_link) {
+				if (!exprok(x))
+					return 0;
+			}
+			break;
+		case IR_RET:
+			if (insn->ir_retexpr != NULL &&
+			    !exprok(insn->ir_retexpr))
+				return 0;
+			break;
+		}
+	}
+
+	/* Copies for phi functions must go on the incoming edges. */
+	SIMPLEQ_FOREACH(bb, &fn->if_cfadata->c_bbqh, cb_glolink) {
+		if (bb->cb_first == NULL)
+			continue;
+		insn = bb->cb_first;
+		if (insn->i_op == IR_LBL && insn != bb->cb_last)
+			insn = TAILQ_NEXT(insn, ii_link);
+		if (insn->i_op != IR_PHI)
+			continue;
+		SIMPLEQ_FOREACH(bbl, &bb->cb_preds, cb_link) {
+			p = bbl->cb_bb;
+			if (p->cb_first == NULL)
+				return 0;
+			nsucc = 0;
+			SIMPLEQ_FOREACH(bbl2, &p->cb_succs, cb_link)
+				nsucc++;
+			last = p->cb_last;
+			if (nsucc == 1) {
+				if (IR_ISBRANCH(last) && last->i_op != IR_B)
+					return 0;
+				continue;
+			}
+			if (nsucc != 2 || !IR_ISBRANCH(last) ||
+			    last->i_op == IR_B)
+				return 0;
+			t = ((struct ir_insn *)last->ib_lbl)->ii_bb;
+			if (t == bb && TAILQ_NEXT(last, ii_link) == bb->cb_first)
+				return 0;
+			if (t != bb &&
+			    TAILQ_NEXT(last, ii_link) != bb->cb_first)
+				return 0;
+			if (t == bb && bb->cb_first->i_op != IR_LBL)
+				return 0;
+		}
+	}
+	return 1;
+}
+
+static void
+expruses(struct ir_expr *x, struct bitvec *bv)
+{
+	for (;;) {
+		if (IR_ISBINEXPR(x)) {
+			expruses(x->ie_r, bv);
+			x = x->ie_l;
+		} else if (IR_ISUNEXPR(x))
+			x = x->ie_l;
+		else {
+			if (x->i_op == IR_REG)
+				bitvec_setbit(bv, x->ie_sym->is_id);
+			break;
+		}
+	}
+}
+
+static void
+insnuses(struct ir_insn *insn, struct bitvec *bv)
+{
+	struct ir_expr *x;
+
+	if (insn->i_op == IR_B || insn->i_op == IR_LBL ||
+	    insn->i_op == IR_PHI)
+		return;
+	if (IR_ISBRANCH(insn)) {
+		expruses(insn->ib_l, bv);
+		expruses(insn->ib_r, bv);
+		return;
+	}
+	switch (insn->i_op) {
+	case IR_ASG:
+		if (insn->is_l->i_op != IR_REG)
+			expruses(insn->is_l, bv);
+		expruses(insn->is_r, bv);
+		break;
+	case IR_ST:
+		expruses(insn->is_l, bv);
+		expruses(insn->is_r, bv);
+		break;
+	case IR_CALL:
+		if (insn->ic_ret != NULL && insn->ic_ret->i_op != IR_REG)
+			expruses(insn->ic_ret, bv);
+		SIMPLEQ_FOREACH(x, &insn->ic_argq, ie_link)
+			expruses(x, bv);
+		break;
+	case IR_RET:
+		if (insn->ir_retexpr != NULL)
+			expruses(insn->ir_retexpr, bv);
+		break;
+	}
+}
+
+static struct ir_symbol *
+insndef(struct ir_insn *insn)
+{
+	switch (insn->i_op) {
+	case IR_ASG:
+		if (insn->is_l->i_op == IR_REG)
+			return insn->is_l->ie_sym;
+		break;
+	case IR_CALL:
+		if (insn->ic_ret != NULL && insn->ic_ret->i_op == IR_REG)
+			return insn->ic_ret->ie_sym;
+		break;
+	case IR_PHI:
+		return insn->ip_sym;
+	}
+	return NULL;
+}
+
+static int
+isphi(struct ir_insn *insn)
+{
+	return insn->i_op == IR_PHI;
+}
+
+/*
+ * Live variables in SSA form. A phi function uses its arguments at the
+ * end of the corresponding predecessors and defines its result at the
+ * beginning of its block.
+ */
+static void
+liveness(struct ir_func *fn)
+{
+	int changes;
+	size_t i;
+	struct bitvec **def, **use, *live, *tmp, *uses;
+	struct cfa_bb *bb, *s;
+	struct cfa_bblink *bbl;
+	struct cfadata *cfa = fn->if_cfadata;
+	struct ir_insn *insn, *term;
+	struct ir_symbol *sym;
+	struct ir_phiarg *arg;
+
+	def = mem_mnalloc(&mem, cfa->c_nbb, sizeof *def);
+	use = mem_mnalloc(&mem, cfa->c_nbb, sizeof *use);
+	bbin = mem_mnalloc(&mem, cfa->c_nbb, sizeof *bbin);
+	bbout = mem_mnalloc(&mem, cfa->c_nbb, sizeof *bbout);
+	phidef = mem_mnalloc(&mem, cfa->c_nbb, sizeof *phidef);
+	uses = bitvec_alloc(&mem, nregs);
+	SIMPLEQ_FOREACH(bb, &cfa->c_bbqh, cb_glolink) {
+		def[bb->cb_id] = bitvec_alloc(&mem, nregs);
+		use[bb->cb_id] = bitvec_alloc(&mem, nregs);
+		bbin[bb->cb_id] = bitvec_alloc(&mem, nregs);
+		bbout[bb->cb_id] = bitvec_alloc(&mem, nregs);
+		phidef[bb->cb_id] = bitvec_alloc(&mem, nregs);
+		if (bb->cb_first == NULL)
+			continue;
+		term = TAILQ_NEXT(bb->cb_last, ii_link);
+		for (insn = bb->cb_first; insn != term;
+		    insn = TAILQ_NEXT(insn, ii_link)) {
+			insn->ii_bb = bb;
+			sym = insndef(insn);
+			if (isphi(insn)) {
+				bitvec_setbit(phidef[bb->cb_id], sym->is_id);
+				SIMPLEQ_FOREACH(arg, &insn->ip_args, ip_link)
+					bitvec_setbit(phirel,
+					    arg->ip_arg->is_id);
+				bitvec_setbit(phirel, sym->is_id);
+			} else {
+				bitvec_clearall(uses);
+				insnuses(insn, uses);
+				for (i = bitvec_firstset(uses); i < nregs;
+				    i = bitvec_nextset(uses, i)) {
+					if (!bitvec_isset(def[bb->cb_id], i))
+						bitvec_setbit(use[bb->cb_id],
+						    i);
+					nuses[i]++;
+				}
+				if (sym != NULL)
+					bitvec_setbit(def[bb->cb_id],
+					    sym->is_id);
+			}
+			if (sym != NULL && sym->is_id >= REG_NREGS) {
+				if (defs[sym->is_id] != NULL)
+					notssa = 1;
+				defs[sym->is_id] = insn;
+				defbb[sym->is_id] = bb;
+			}
+		}
+	}
+
+	tmp = bitvec_alloc(&mem, nregs);
+	live = bitvec_alloc(&mem, nregs);
+	do {
+		changes = 0;
+		SIMPLEQ_FOREACH(bb, &cfa->c_bbqh, cb_glolink) {
+			bitvec_clearall(live);
+			SIMPLEQ_FOREACH(bbl, &bb->cb_succs, cb_link) {
+				s = bbl->cb_bb;
+				bitvec_cpy(tmp, phidef[s->cb_id]);
+				bitvec_not(tmp);
+				bitvec_and(tmp, bbin[s->cb_id]);
+				bitvec_or(live, tmp);
+				if (s->cb_first == NULL)
+					continue;
+				term = TAILQ_NEXT(s->cb_last, ii_link);
+				for (insn = s->cb_first; insn != term;
+				    insn = TAILQ_NEXT(insn, ii_link)) {
+					if (!isphi(insn))
+						continue;
+					SIMPLEQ_FOREACH(arg, &insn->ip_args,
+					    ip_link) {
+						if (arg->ip_bb == bb)
+							bitvec_setbit(live,
+							    arg->ip_arg->is_id);
+					}
+				}
+			}
+			bitvec_cpy(bbout[bb->cb_id], live);
+			bitvec_cpy(tmp, def[bb->cb_id]);
+			bitvec_not(tmp);
+			bitvec_and(live, tmp);
+			bitvec_or(live, use[bb->cb_id]);
+			bitvec_or(live, phidef[bb->cb_id]);
+			if (bitvec_cmp(live, bbin[bb->cb_id])) {
+				bitvec_cpy(bbin[bb->cb_id], live);
+				changes = 1;
+			}
+		}
+	} while (changes);
+
+	/* Live variables after each instruction. */
+	SIMPLEQ_FOREACH(bb, &cfa->c_bbqh, cb_glolink) {
+		if (bb->cb_first == NULL)
+			continue;
+		bitvec_cpy(live, bbout[bb->cb_id]);
+		term = TAILQ_PREV(bb->cb_first, ir_insnq, ii_link);
+		for (insn = bb->cb_last; insn != term;
+		    insn = TAILQ_PREV(insn, ir_insnq, ii_link)) {
+			if (isphi(insn) || insn->i_op == IR_LBL)
+				continue;
+			insn->ii_dfadata.d_liveout = bitvec_alloc(&mem, nregs);
+			bitvec_cpy(insn->ii_dfadata.d_liveout, live);
+			if ((sym = insndef(insn)) != NULL)
+				bitvec_clearbit(live, sym->is_id);
+			insnuses(insn, live);
+		}
+		for (insn = bb->cb_first;
+		    isphi(insn) || insn->i_op == IR_LBL;
+		    insn = TAILQ_NEXT(insn, ii_link)) {
+			insn->ii_dfadata.d_liveout = bbin[bb->cb_id];
+			if (insn == bb->cb_last)
+				break;
+		}
+		term = TAILQ_NEXT(bb->cb_last, ii_link);
+		for (insn = bb->cb_first; insn != term;
+		    insn = TAILQ_NEXT(insn, ii_link)) {
+			tmp = insn->ii_dfadata.d_liveout;
+			for (i = bitvec_firstset(tmp); i < nregs;
+			    i = bitvec_nextset(tmp, i))
+				span[i]++;
+		}
+	}
+}
+
+static void
+clearlive(struct ir_func *fn)
+{
+	struct ir_insn *insn;
+
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		insn->ii_dfadata.d_livein = NULL;
+		insn->ii_dfadata.d_liveout = NULL;
+	}
+}
+
+static void
+addforbid(struct bitvec *live, struct regset *rs, int reg,
+    struct ir_symbol *except)
+{
+	size_t i;
+
+	for (i = bitvec_firstset(live); i < nregs;
+	    i = bitvec_nextset(live, i)) {
+		if (!isvreg(i) || (except != NULL && except->is_id == i))
+			continue;
+		if (rs != NULL)
+			bitvec_or((struct bitvec *)&forbid[i],
+			    (struct bitvec *)rs);
+		else
+			regset_addreg(&forbid[i], reg);
+	}
+}
+
+/*
+ * Gather everything we need to know about the values in the function.
+ */
+static void
+analyze(struct ir_func *fn)
+{
+	int c, r;
+	size_t i;
+	struct ir_param *parms;
+	struct ir_insn *insn;
+	struct ir_symbol *sym;
+	struct regset *clobbers;
+
+	clearlive(fn);
+	mem_area_free(&mem);
+	mem_area_init(&mem);
+	ir_func_linearize_regs(fn);
+	nregs = fn->if_regid;
+	color = mem_mnalloc(&mem, nregs, sizeof *color);
+	forced = mem_mnalloc(&mem, nregs, sizeof *forced);
+	pref = mem_mnalloc(&mem, nregs, sizeof *pref);
+	rclass = mem_mnalloc(&mem, nregs, sizeof *rclass);
+	nuses = mem_calloc(&mem, nregs, sizeof *nuses);
+	span = mem_calloc(&mem, nregs, sizeof *span);
+	nforbid = mem_calloc(&mem, nregs, sizeof *nforbid);
+	defs = mem_calloc(&mem, nregs, sizeof *defs);
+	defbb = mem_calloc(&mem, nregs, sizeof *defbb);
+	mate = mem_calloc(&mem, nregs, sizeof *mate);
+	forbid = mem_mnalloc(&mem, nregs, sizeof *forbid);
+	phirel = bitvec_alloc(&mem, nregs);
+	notssa = 0;
+	for (i = 0; i < nregs; i++) {
+		color[i] = i < REG_NREGS ? (int)i : -1;
+		forced[i] = pref[i] = -1;
+		if (i < REG_NREGS)
+			rclass[i] = ir_symbol_rclass(physregs[i]);
+		else if (fn->if_regs[i] != NULL)
+			rclass[i] = ir_symbol_rclass(fn->if_regs[i]);
+		else
+			rclass[i] = -1;
+		regset_init(&forbid[i]);
+	}
+
+	liveness(fn);
+
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		switch (insn->i_op) {
+		case IR_ASG:
+			if (insn->is_l->i_op != IR_REG)
+				break;
+			sym = insn->is_l->ie_sym;
+			if (sym->is_id < REG_NREGS) {
+				addforbid(insn->ii_dfadata.d_liveout, NULL,
+				    sym->is_id, NULL);
+				break;
+			}
+			if (insn->is_r->i_op == IR_REG &&
+			    isvreg(insn->is_r->ie_sym->is_id)) {
+				mate[sym->is_id] = insn->is_r->ie_sym;
+				if (mate[insn->is_r->ie_sym->is_id] == NULL)
+					mate[insn->is_r->ie_sym->is_id] = sym;
+			}
+			break;
+		case IR_PHI:
+			sym = insn->ip_sym;
+			if (!SIMPLEQ_EMPTY(&insn->ip_args))
+				mate[sym->is_id] =
+				    SIMPLEQ_FIRST(&insn->ip_args)->ip_arg;
+			break;
+		case IR_CALL:
+			clobbers = &reg_volat;
+			if (insn->ic_fn->is_op == IR_FUNSYM &&
+			    insn->ic_fn->is_clobbers != NULL)
+				clobbers = insn->ic_fn->is_clobbers;
+			addforbid(insn->ii_dfadata.d_liveout, clobbers, 0,
+			    insndef(insn));
+			parms = ir_parlocs_call(insn);
+			for (i = 0; parms[i].ip_argsym != NULL; i++) {
+				if (parms[i].ip_reg == -1 ||
+				    !isvreg(parms[i].ip_argsym->is_id))
+					continue;
+				r = parms[i].ip_argsym->is_id;
+				if (forced[r] != -1 &&
+				    forced[r] != parms[i].ip_reg)
+					forced[r] = -2;
+				else
+					forced[r] = parms[i].ip_reg;
+			}
+			free(parms);
+			break;
+		case IR_RET:
+			if (insn->ir_retexpr == NULL ||
+			    insn->ir_retexpr->i_op != IR_REG)
+				break;
+			sym = insn->ir_retexpr->ie_sym;
+			if (isvreg(sym->is_id))
+				pref[sym->is_id] =
+				    pass_ralloc_retreg(sym->is_type);
+			break;
+		}
+	}
+
+	/* Phi arguments like to share the register of the result. */
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		struct ir_phiarg *arg;
+
+		if (!isphi(insn))
+			continue;
+		SIMPLEQ_FOREACH(arg, &insn->ip_args, ip_link) {
+			if (isvreg(arg->ip_arg->is_id) &&
+			    mate[arg->ip_arg->is_id] == NULL)
+				mate[arg->ip_arg->is_id] = insn->ip_sym;
+		}
+	}
+
+	/*
+	 * Keep the registers that call arguments need free while they
+	 * are being computed.
+	 */
+	for (i = REG_NREGS; i < nregs; i++) {
+		if (forced[i] < 0 || defs[i] == NULL)
+			continue;
+		addforbid(defs[i]->ii_dfadata.d_liveout, NULL, forced[i],
+		    fn->if_regs[i]);
+	}
+
+	for (i = REG_NREGS; i < nregs; i++) {
+		if ((c = rclass[i]) == -1)
+			continue;
+		for (r = BITVEC_FIRSTSET(&regclasses[c]); r < REG_NREGS;
+		    r = BITVEC_NEXTSET(&regclasses[c], r)) {
+			if (BITVEC_MEET(&reg_confsets[r], &forbid[i]))
+				nforbid[i]++;
+		}
+	}
+}
+
+static int
+spillable(size_t id)
+{
+	return isvreg(id) && id < firsttmp && defs[id] != NULL &&
+	    !isphi(defs[id]) && forced[id] == -1 &&
+	    !bitvec_isset(phirel, id);
+}
+
+/*
+ * Pick the value to spill at a point where the given values are live.
+ * We prefer values that are live long and used rarely.
+ */
+static struct ir_symbol *
+spillcand(struct bitvec *live, struct ir_symbol *def)
+{
+	size_t best = 0, i;
+
+	if (def != NULL && spillable(def->is_id))
+		best = def->is_id;
+	for (i = bitvec_firstset(live); i < nregs;
+	    i = bitvec_nextset(live, i)) {
+		if (!spillable(i))
+			continue;
+		if (best == 0 ||
+		    (uintmax_t)span[i] * (nuses[best] + 1) >
+		    (uintmax_t)span[best] * (nuses[i] + 1))
+			best = i;
+	}
+	return best == 0 ? NULL : curfn->if_regs[best];
+}
+
+/*
+ * Find the point where the register pressure exceeds the number of
+ * available registers most and return a value to spill there.
+ */
+static struct ir_symbol *
+maxpressure(struct ir_func *fn)
+{
+	int c, excess, maxexcess = 0, sum[NCLASSES];
+	size_t i;
+	struct bitvec *live;
+	struct ir_insn *insn, *maxinsn = NULL;
+	struct ir_symbol *def;
+
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if ((live = insn->ii_dfadata.d_liveout) == NULL)
+			continue;
+		def = insndef(insn);
+		memset(sum, 0, sizeof sum);
+		for (i = bitvec_firstset(live); i < nregs;
+		    i = bitvec_nextset(live, i)) {
+			if (rclass[i] == -1)
+				continue;
+			for (c = 0; c < NCLASSES; c++)
+				sum[c] += reg_qbc[c][rclass[i]];
+		}
+		if (def != NULL && !bitvec_isset(live, def->is_id) &&
+		    rclass[def->is_id] != -1) {
+			for (c = 0; c < NCLASSES; c++)
+				sum[c] += reg_qbc[c][rclass[def->is_id]];
+		}
+		for (i = bitvec_firstset(live); i < nregs;
+		    i = bitvec_nextset(live, i)) {
+			if (!isvreg(i))
+				continue;
+			c = rclass[i];
+			excess = sum[c] - reg_qbc[c][c] + nforbid[i] -
+			    reg_plimit[c] + 1;
+			if (excess > maxexcess) {
+				maxexcess = excess;
+				maxinsn = insn;
+			}
+		}
+	}
+	if (maxinsn == NULL)
+		return NULL;
+	return spillcand(maxinsn->ii_dfadata.d_liveout, insndef(maxinsn));
+}
+
+static void
+renameuse(struct ir_expr *x, struct ir_symbol *from, struct ir_symbol *to)
+{
+	for (;;) {
+		if (IR_ISBINEXPR(x)) {
+			renameuse(x->ie_r, from, to);
+			x = x->ie_l;
+		} else if (IR_ISUNEXPR(x))
+			x = x->ie_l;
+		else {
+			if (x->i_op == IR_REG && x->ie_sym == from)
+				x->ie_sym = to;
+			break;
+		}
+	}
+}
+
+/*
+ * Spill sym everywhere: store it after its definition and load it into
+ * a new value before every use.
+ */
+static void
+spill(struct ir_func *fn, struct ir_symbol *sym)
+{
+	struct bitvec *uses;
+	struct ir_expr *x;
+	struct ir_insn *insn;
+	struct ir_symbol *slot, *tmp;
+
+	slot = ir_symbol(IR_REGSYM, NULL, sym->is_size, sym->is_align,
+	    sym->is_type);
+	ir_symbol_setflags(slot, IR_SYM_USED);
+	ir_symq_enq(&slotq, slot);
+
+	uses = bitvec_alloc(NULL, fn->if_regid);
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		bitvec_clearall(uses);
+		insnuses(insn, uses);
+		if (!bitvec_isset(uses, sym->is_id))
+			continue;
+		tmp = ir_vregsym(fn, sym->is_type);
+		cfa_bb_prepend_insn(insn,
+		    ir_asg(ir_virtreg(tmp), ir_var(IR_LVAR, slot)));
+		if (IR_ISBRANCH(insn)) {
+			renameuse(insn->ib_l, sym, tmp);
+			renameuse(insn->ib_r, sym, tmp);
+			continue;
+		}
+		switch (insn->i_op) {
+		case IR_ASG:
+			if (insn->is_l->i_op != IR_REG)
+				renameuse(insn->is_l, sym, tmp);
+			renameuse(insn->is_r, sym, tmp);
+			break;
+		case IR_ST:
+			renameuse(insn->is_l, sym, tmp);
+			renameuse(insn->is_r, sym, tmp);
+			break;
+		case IR_CALL:
+			if (insn->ic_ret != NULL &&
+			    insn->ic_ret->i_op != IR_REG)
+				renameuse(insn->ic_ret, sym, tmp);
+			SIMPLEQ_FOREACH(x, &insn->ic_argq, ie_link)
+				renameuse(x, sym, tmp);
+			break;
+		case IR_RET:
+			renameuse(insn->ir_retexpr, sym, tmp);
+			break;
+		}
+	}
+	free(uses);
+
+	cfa_bb_append_insn(fn, defs[sym->is_id],
+	    ir_asg(ir_var(IR_LVAR, slot), ir_virtreg(sym)));
+}
+
+static int
+colorok(size_t id, int c)
+{
+	if (!BITVEC_ISSET(&regclasses[rclass[id]], c) ||
+	    BITVEC_ISSET(&occupied, c))
+		return 0;
+	return !BITVEC_MEET(&reg_confsets[c], &forbid[id]);
+}
+
+static void
+setoccupied(struct bitvec *live, size_t except)
+{
+	int c;
+	size_t i;
+
+	BITVEC_CLEARALL(&occupied);
+	for (i = bitvec_firstset(live); i < nregs;
+	    i = bitvec_nextset(live, i)) {
+		if (i == except || (c = color[i]) == -1)
+			continue;
+		BITVEC_OR(&occupied, &reg_confsets[c]);
+	}
+}
+
+/*
+ * Choose a register for sym. Besides the registers of the values that
+ * are live with sym, we have to avoid the ones in its forbidden set.
+ */
+static int
+pickcolor(struct ir_symbol *sym, struct bitvec *live)
+{
+	int c, vol;
+	size_t id = sym->is_id;
+
+	setoccupied(live, id);
+	if (forced[id] != -1)
+		return forced[id] >= 0 && colorok(id, forced[id]) ?
+		    forced[id] : -1;
+	if (pref[id] != -1 && colorok(id, pref[id]))
+		return pref[id];
+	if (mate[id] != NULL && (c = color[mate[id]->is_id]) != -1 &&
+	    colorok(id, c))
+		return c;
+
+	/* Values not live across calls should use volatile registers. */
+	for (vol = 1; vol >= 0; vol--) {
+		for (c = BITVEC_FIRSTSET(&regclasses[rclass[id]]);
+		    c < REG_NREGS;
+		    c = BITVEC_NEXTSET(&regclasses[rclass[id]], c)) {
+			if (BITVEC_ISSET(&reg_volat, c) == vol &&
+			    colorok(id, c))
+				return c;
+		}
+	}
+	return -1;
+}
+
+static int
+colorsym(struct ir_insn *insn, struct ir_symbol *sym, struct bitvec *live)
+{
+	if ((color[sym->is_id] = pickcolor(sym, live)) != -1)
+		return 1;
+	failinsn = insn;
+	failsym = sym;
+	return 0;
+}
+
+/*
+ * Color the values in the order of their definitions in a preorder walk
+ * of the dominator tree.
+ */
+static int
+colorbb(struct cfa_bb *bb)
+{
+	size_t i;
+	struct bitvec *in;
+	struct cfa_bblink *bbl;
+	struct ir_insn *insn, *term;
+	struct ir_symbol *sym;
+
+	if (bb->cb_first != NULL) {
+		/* Values that are used without a definition. */
+		in = bbin[bb->cb_id];
+		for (i = bitvec_firstset(in); i < nregs;
+		    i = bitvec_nextset(in, i)) {
+			if (!isvreg(i) || color[i] != -1 ||
+			    defbb[i] == bb)
+				continue;
+			if (!colorsym(bb->cb_first, curfn->if_regs[i], in))
+				return 0;
+		}
+
+		term = TAILQ_NEXT(bb->cb_last, ii_link);
+		for (insn = bb->cb_first; insn != term;
+		    insn = TAILQ_NEXT(insn, ii_link)) {
+			if ((sym = insndef(insn)) == NULL ||
+			    !isvreg(sym->is_id))
+				continue;
+			if (!colorsym(insn, sym, insn->ii_dfadata.d_liveout))
+				return 0;
+		}
+	}
+	SIMPLEQ_FOREACH(bbl, &bb->cb_idomkids, cb_link) {
+		if (!colorbb(bbl->cb_bb))
+			return 0;
+	}
+	return 1;
+}
+
+static int
+recolorok(size_t id, int c)
+{
+	struct ir_insn *insn;
+	struct cfa_bb *bb;
+
+	if (forced[id] != -1)
+		return 0;
+	BITVEC_CLEARALL(&occupied);
+	if (!colorok(id, c))
+		return 0;
+	TAILQ_FOREACH(insn, &curfn->if_iq, ii_link) {
+		if (insn->ii_dfadata.d_liveout == NULL)
+			continue;
+		if (insn != defs[id] &&
+		    !bitvec_isset(insn->ii_dfadata.d_liveout, id))
+			continue;
+		setoccupied(insn->ii_dfadata.d_liveout, id);
+		if (BITVEC_ISSET(&occupied, c))
+			return 0;
+	}
+	SIMPLEQ_FOREACH(bb, &curfn->if_cfadata->c_bbqh, cb_glolink) {
+		if (!bitvec_isset(bbin[bb->cb_id], id))
+			continue;
+		setoccupied(bbin[bb->cb_id], id);
+		if (BITVEC_ISSET(&occupied, c))
+			return 0;
+	}
+	return 1;
+}
+
+static void
+trycoalesce(struct ir_symbol *a, struct ir_symbol *b)
+{
+	size_t ida = a->is_id, idb = b->is_id;
+
+	if (!isvreg(ida) || !isvreg(idb) || color[ida] == color[idb])
+		return;
+	if (recolorok(ida, color[idb]))
+		color[ida] = color[idb];
+	else if (recolorok(idb, color[ida]))
+		color[idb] = color[ida];
+}
+
+/*
+ * Try to give copy-related values the same register after coloring.
+ */
+static void
+coalesce(struct ir_func *fn)
+{
+	struct ir_insn *insn;
+	struct ir_phiarg *arg;
+
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (insn->i_op == IR_ASG && insn->is_l->i_op == IR_REG &&
+		    insn->is_r->i_op == IR_REG)
+			trycoalesce(insn->is_l->ie_sym, insn->is_r->ie_sym);
+		else if (isphi(insn)) {
+			SIMPLEQ_FOREACH(arg, &insn->ip_args, ip_link)
+				trycoalesce(insn->ip_sym, arg->ip_arg);
+		}
+	}
+}
+
+/*
+ * Order the parallel copy pc so that no copy overwrites the source of a
+ * later one. A cycle is broken by saving a register in a stack slot.
+ * If emit is set, the copies are inserted with putinsn. Returns 0 if the
+ * registers of a cycle only partially overlap.
+ */
+static int
+seqcopies(struct pcopy *pc, int n, int emit,
+    void (*putinsn)(struct ir_insn *))
+{
+	int blocked, done = 0, i, j, r;
+	struct ir_symbol *slot;
+	struct ir_expr *src;
+	struct pcopy *p;
+
+	for (i = 0; i < n; i++) {
+		if (pc[i].p_dst == pc[i].p_src) {
+			pc[i].p_dst = -1;
+			done++;
+		}
+	}
+	while (done < n) {
+		for (i = 0; i < n; i++) {
+			if (pc[i].p_dst == -1)
+				continue;
+			blocked = 0;
+			for (j = 0; j < n && !blocked; j++) {
+				if (j != i && pc[j].p_dst != -1 &&
+				    pc[j].p_mem == NULL &&
+				    regconflict(pc[i].p_dst, pc[j].p_src))
+					blocked = 1;
+			}
+			if (blocked)
+				continue;
+			p = &pc[i];
+			if (emit) {
+				if (p->p_mem != NULL)
+					src = ir_var(IR_LVAR, p->p_mem);
+				else
+					src = ir_physreg(physregs[p->p_src],
+					    p->p_type);
+				putinsn(ir_asg(ir_physreg(physregs[p->p_dst],
+				    p->p_type), src));
+			}
+			p->p_dst = -1;
+			done++;
+			break;
+		}
+		if (i < n)
+			continue;
+
+		/* Every copy is blocked, so there is a cycle. */
+		for (i = 0; pc[i].p_dst == -1; i++)
+			continue;
+		r = pc[i].p_dst;
+		slot = NULL;
+		for (j = 0; j < n; j++) {
+			if (j == i || pc[j].p_dst == -1 ||
+			    pc[j].p_mem != NULL ||
+			    !regconflict(r, pc[j].p_src))
+				continue;
+			if (pc[j].p_src != r)
+				return 0;
+			if (emit && slot == NULL) {
+				slot = ir_symbol(IR_REGSYM, NULL,
+				    pc[j].p_type->it_size,
+				    pc[j].p_type->it_align, pc[j].p_type);
+				ir_symbol_setflags(slot, IR_SYM_USED);
+				ir_symq_enq(&slotq, slot);
+				putinsn(ir_asg(ir_var(IR_LVAR, slot),
+				    ir_physreg(physregs[r], pc[j].p_type)));
+			}
+			pc[j].p_mem = emit ? slot : (struct ir_symbol *)pc;
+		}
+	}
+	return 1;
+}
+
+static struct ir_insn *edgepos;
+static struct cfa_bb *edgebb;
+
+static void
+putappend(struct ir_insn *insn)
+{
+	cfa_bb_append(curfn, edgebb, insn);
+}
+
+static void
+putbefore(struct ir_insn *insn)
+{
+	ir_prepend_insn(edgepos, insn);
+}
+
+static void
+puttail(struct ir_insn *insn)
+{
+	TAILQ_INSERT_TAIL(&curfn->if_iq, insn, ii_link);
+}
+
+/*
+ * Replace the phi functions of bb by copies on the incoming edges.
+ */
+static int
+dophis(struct cfa_bb *bb, int emit)
+{
+	int n, nphi = 0, nsucc;
+	struct cfa_bblink *bbl, *bbl2;
+	struct ir_insn *insn, *last, *lbl, *term;
+	struct ir_phiarg *arg;
+	struct pcopy *pc;
+	struct cfa_bb *p;
+	void (*put)(struct ir_insn *);
+
+	if (bb->cb_first == NULL)
+		return 1;
+	term = TAILQ_NEXT(bb->cb_last, ii_link);
+	for (insn = bb->cb_first; insn != term; insn = TAILQ_NEXT(insn, ii_link))
+		nphi += isphi(insn);
+	if (nphi == 0)
+		return 1;
+	pc = xcalloc(nphi, sizeof *pc);
+	SIMPLEQ_FOREACH(bbl, &bb->cb_preds, cb_link) {
+		p = bbl->cb_bb;
+		n = 0;
+		for (insn = bb->cb_first; insn != term;
+		    insn = TAILQ_NEXT(insn, ii_link)) {
+			if (!isphi(insn))
+				continue;
+			SIMPLEQ_FOREACH(arg, &insn->ip_args, ip_link) {
+				if (arg->ip_bb != p)
+					continue;
+				pc[n].p_dst = color[insn->ip_sym->is_id];
+				pc[n].p_src = color[arg->ip_arg->is_id];
+				pc[n].p_type = insn->ip_sym->is_type;
+				pc[n].p_mem = NULL;
+				if (pc[n].p_dst < 0 || pc[n].p_src < 0)
+					fatalx("dophis: uncolored value");
+				n++;
+				break;
+			}
+		}
+
+		put = putappend;
+		edgebb = p;
+		nsucc = 0;
+		SIMPLEQ_FOREACH(bbl2, &p->cb_succs, cb_link)
+			nsucc++;
+		last = p->cb_last;
+		if (nsucc == 2 && TAILQ_NEXT(last, ii_link) == bb->cb_first) {
+			put = putbefore;
+			edgepos = bb->cb_first;
+		} else if (nsucc == 2) {
+			put = puttail;
+			if (emit) {
+				lbl = ir_lbl();
+				puttail(lbl);
+				last->ib_lbl = (struct ir_lbl *)lbl;
+			}
+		}
+		if (!seqcopies(pc, n, emit, put)) {
+			free(pc);
+			return 0;
+		}
+		if (emit && put == puttail)
+			puttail(ir_b(bb->cb_first));
+	}
+	free(pc);
+
+	if (emit) {
+		for (insn = bb->cb_first; insn != term; insn = last) {
+			last = TAILQ_NEXT(insn, ii_link);
+			if (isphi(insn))
+				ir_delete_insn(curfn, insn);
+		}
+	}
+	return 1;
+}
+
+static void
+physexpr(struct ir_expr *x)
+{
+	for (;;) {
+		if (IR_ISBINEXPR(x)) {
+			physexpr(x->ie_r);
+			x = x->ie_l;
+		} else if (IR_ISUNEXPR(x))
+			x = x->ie_l;
+		else {
+			if (x->i_op == IR_REG && isvreg(x->ie_sym->is_id)) {
+				regset_addreg(&curfn->if_usedregs,
+				    color[x->ie_sym->is_id]);
+				x->ie_sym = physregs[color[x->ie_sym->is_id]];
+			}
+			break;
+		}
+	}
+}
+
+static void
+rewrite(struct ir_func *fn)
+{
+	struct ir_expr *x;
+	struct ir_insn *insn;
+	struct ir_symbol *sym;
+	struct cfa_bb *bb;
+
+	SIMPLEQ_FOREACH(bb, &fn->if_cfadata->c_bbqh, cb_glolink)
+		dophis(bb, 1);
+
+	BITVEC_CLEARALL(&fn->if_usedregs);
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (insn->i_op == IR_B || insn->i_op == IR_LBL)
+			continue;
+		if (IR_ISBRANCH(insn)) {
+			physexpr(insn->ib_l);
+			physexpr(insn->ib_r);
+			continue;
+		}
+		switch (insn->i_op) {
+		case IR_ASG:
+		case IR_ST:
+			physexpr(insn->is_l);
+			physexpr(insn->is_r);
+			break;
+		case IR_CALL:
+			if (insn->ic_ret != NULL)
+				physexpr(insn->ic_ret);
+			SIMPLEQ_FOREACH(x, &insn->ic_argq, ie_link)
+				physexpr(x);
+			break;
+		case IR_RET:
+			if (insn->ir_retexpr != NULL)
+				physexpr(insn->ir_retexpr);
+			break;
+		}
+	}
+
+	while (!SIMPLEQ_EMPTY(&fn->if_regq)) {
+		sym = SIMPLEQ_FIRST(&fn->if_regq);
+		SIMPLEQ_REMOVE_HEAD(&fn->if_regq, is_link);
+		ir_symbol_free(sym);
+	}
+	while (!SIMPLEQ_EMPTY(&slotq)) {
+		sym = SIMPLEQ_FIRST(&slotq);
+		SIMPLEQ_REMOVE_HEAD(&slotq, is_link);
+		ir_func_addreg(fn, sym);
+	}
+	fn->if_flags |= IR_FUNC_CHORDAL;
+	cfa_buildcfg(fn);
+}
+
+/*
+ * Leave the function to pass_ralloc. Spill slots we already created
+ * become ordinary local variables.
+ */
+static void
+giveup(struct ir_func *fn)
+{
+	struct ir_symbol *sym;
+
+	while (!SIMPLEQ_EMPTY(&slotq)) {
+		sym = SIMPLEQ_FIRST(&slotq);
+		SIMPLEQ_REMOVE_HEAD(&slotq, is_link);
+		ir_func_addvar(fn, sym);
+	}
+}
+
+void
+pass_chordal(struct passinfo *pi)
+{
+	int colored, nrounds;
+	struct ir_func *fn = pi->p_fn;
+	struct cfa_bb *bb;
+	struct ir_symbol *sym;
+
+	if (!Cflag)
+		return;
+
+	/* pass_gencode inserted instructions without updating the CFG. */
+	cfa_bb_resync(fn);
+	if (!funcok(fn))
+		return;
+
+	curfn = fn;
+	firsttmp = fn->if_regid;
+	ir_symq_init(&slotq);
+	regset_init(&occupied);
+	mem_area_init(&mem);
+	for (nrounds = 0; nrounds < ROUNDS_MAX; nrounds++) {
+		analyze(fn);
+		if (notssa)
+			break;
+		if ((sym = maxpressure(fn)) != NULL) {
+			spill(fn, sym);
+			continue;
+		}
+		colored = colorbb(fn->if_cfadata->c_entry);
+		if (colored) {
+			coalesce(fn);
+			SIMPLEQ_FOREACH(bb, &fn->if_cfadata->c_bbqh,
+			    cb_glolink) {
+				if (!dophis(bb, 0))
+					break;
+			}
+			if (bb == NULL) {
+				rewrite(fn);
+				clearlive(fn);
+				mem_area_free(&mem);
+				return;
+			}
+			break;
+		}
+		if ((sym = spillcand(failinsn->ii_dfadata.d_liveout,
+		    failsym)) == NULL)
+			break;
+		spill(fn, sym);
+	}
+	giveup(fn);
+	clearlive(fn);
+	mem_area_free(&mem);
+}
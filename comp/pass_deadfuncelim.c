@@ -49,55 +49,69 @@ deadfuncelim_doinit(struct ir_init *init)
 	}
 }
 
+/* Mark the symbols that fn uses. */
 void
-pass_deadfuncelim(struct passinfo *pi)
+pass_deadfuncelim_func(struct ir_func *fn)
 {
 	struct ir_expr *x;
-	struct ir_func *fn, *next, *prev;
-	struct ir_symbol *sym;
-	struct ir_init *init;
 	struct ir_insn *insn;
 
-	SIMPLEQ_FOREACH(fn, &irprog->ip_funq, if_link)
-		fn->if_sym->is_flags &= ~IR_SYM_USED;
+	irfunc = fn;
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (insn->i_op == IR_LBL || insn->i_op == IR_B)
+			continue;
+		if (IR_ISBRANCH(insn)) {
+			deadfuncelim_doexpr(insn->ib_l);
+			deadfuncelim_doexpr(insn->ib_r);
+			continue;
+		}
+		switch (insn->i_op) {
+		case IR_ASG:
+		case IR_ST:
+			deadfuncelim_doexpr(insn->is_l);
+			deadfuncelim_doexpr(insn->is_r);
+			break;
+		case IR_CALL:
+			if (insn->ic_ret != NULL)
+				deadfuncelim_doexpr(insn->ic_ret);
+			ir_symbol_setflags(insn->ic_fn, IR_SYM_USED);
+			SIMPLEQ_FOREACH(x, &insn->ic_argq, ie_link)
+				deadfuncelim_doexpr(x);
+			break;
+		case IR_RET:
+			if (insn->ir_retexpr != NULL)
+				deadfuncelim_doexpr(insn->ir_retexpr);
+			break;
+		default:
+			fatalx("pass_deadfuncelim: bad op: 0x%x",
+			    insn->i_op);
+		}
+	}
+}
+
+/* Mark the symbols that the initializers of the program use. */
+void
+pass_deadfuncelim_inits(void)
+{
+	struct ir_init *init;
+
 	SIMPLEQ_FOREACH(init, &irprog->ip_roinitq, ii_link)
 		deadfuncelim_doinit(init);
 	SIMPLEQ_FOREACH(init, &irprog->ip_initq, ii_link)
 		deadfuncelim_doinit(init);
+}
 
-	SIMPLEQ_FOREACH(fn, &irprog->ip_funq, if_link) {
-		irfunc = fn;
-		TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
-			if (insn->i_op == IR_LBL || insn->i_op == IR_B)
-				continue;
-			if (IR_ISBRANCH(insn)) {
-				deadfuncelim_doexpr(insn->ib_l);
-				deadfuncelim_doexpr(insn->ib_r);
-				continue;
-			}
-			switch (insn->i_op) {
-			case IR_ASG:
-			case IR_ST:
-				deadfuncelim_doexpr(insn->is_l);
-				deadfuncelim_doexpr(insn->is_r);
-				break;
-			case IR_CALL:
-				if (insn->ic_ret != NULL)
-					deadfuncelim_doexpr(insn->ic_ret);
-				ir_symbol_setflags(insn->ic_fn, IR_SYM_USED);
-				SIMPLEQ_FOREACH(x, &insn->ic_argq, ie_link)
-					deadfuncelim_doexpr(x);
-				break;
-			case IR_RET:
-				if (insn->ir_retexpr != NULL)
-					deadfuncelim_doexpr(insn->ir_retexpr);
-				break;
-			default:
-				fatalx("pass_deadfuncelim: bad op: 0x%x",
-				    insn->i_op);
-			}
-		}
-	}
+void
+pass_deadfuncelim(struct passinfo *pi)
+{
+	struct ir_func *fn, *next, *prev;
+	struct ir_symbol *sym;
+
+	SIMPLEQ_FOREACH(fn, &irprog->ip_funq, if_link)
+		fn->if_sym->is_flags &= ~IR_SYM_USED;
+	pass_deadfuncelim_inits();
+	SIMPLEQ_FOREACH(fn, &irprog->ip_funq, if_link)
+		pass_deadfuncelim_func(fn);
 
 	prev = NULL;
 	for (fn = SIMPLEQ_FIRST(&irprog->ip_funq); fn != NULL;
@@ -63,9 +63,11 @@ pass_emit_func(struct passinfo *pi)
 		emitf("\t.globl\t%s\n", fn->if_sym->is_name);
 	emitf("\t.type\t%s, @function\n", fn->if_sym->is_name);
 	emitf("%s:\n", fn->if_sym->is_name);
-	pass_emit_prologue(fn);
+	if (fn->if_prologue == NULL && !(fn->if_flags & IR_FUNC_NOFRAME))
+		pass_emit_prologue(fn);
 	emit_func(fn);
-	pass_emit_epilogue(fn);
+	if (!(fn->if_flags & IR_FUNC_NOFRAME))
+		pass_emit_epilogue(fn);
 	emitf("\t.size\t%s, .-%s\n",
 	    fn->if_sym->is_name, fn->if_sym->is_name);
 }
@@ -107,7 +109,7 @@ pass_emit_data(struct passinfo *pi)
 	SIMPLEQ_FOREACH(sym, &irprog->ip_cstrq, is_link) {
 		emit_align(IR_PTR_ALIGN);
 		emitf(".L%d:\t.asciz ", sym->is_id);
-		emitcstring(stdout, sym->is_name, sym->is_size);
+		emitcstring(emitfp, sym->is_name, sym->is_size);
 		emits("\n");
 	}
 
@@ -333,7 +335,7 @@ emit_init(struct ir_init *init)
 				emits("\t.asciz ");
 				len = elm->ii_len;
 			}
-			emitcstring(stdout, elm->ii_cstr, len);
+			emitcstring(emitfp, elm->ii_cstr, len);
 			lastoff += elm->ii_len * 8;
 			emits("\n");
 			continue;
@@ -375,6 +377,8 @@ emit_func(struct ir_func *fn)
 		case IR_LBL:
 			lbl = (struct ir_lbl *)insn;
 			emitf(".L%d:\n", lbl->il_id);
+			if (insn == fn->if_prologue)
+				pass_emit_prologue(fn);
 			break;
 		case IR_ASG:
 			l = insn->is_l;
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2008 Stefan Kempf <sisnkemp@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Forward substitution. If a virtual register is assigned once and used
+ * once later in the same basic block, the assignment is removed and its
+ * expression replaces the use. The instruction selector then sees larger
+ * trees and can use memory operands and addressing modes. Expressions
+ * that read memory or may trap are not moved across stores or calls.
+ */
+
+#include <sys/types.h>
+#include <sys/queue.h>
+
+#include <stdlib.h>
+
+#include "comp/comp.h"
+#include "comp/ir.h"
+#include "comp/passes.h"
+
+struct fsreg {
+	struct	ir_insn *f_def;
+	struct	ir_insn *f_use;
+	struct	ir_expr **f_usep;
+	int	f_ndefs;
+	int	f_nuses;
+};
+
+#define FS_MEM	1	/* Reads memory or may trap. */
+#define FS_BAD	2	/* Must not be moved at all. */
+
+static struct fsreg *regs;
+
+/* xp is NULL if the use cannot be replaced by an expression. */
+static void
+fs_use(struct ir_insn *insn, struct ir_symbol *sym, struct ir_expr **xp)
+{
+	regs[sym->is_id].f_nuses++;
+	regs[sym->is_id].f_use = insn;
+	regs[sym->is_id].f_usep = xp;
+}
+
+static void
+fs_uses(struct ir_insn *insn, struct ir_expr **xp)
+{
+	struct ir_expr *x = *xp;
+
+	if (IR_ISBINEXPR(x)) {
+		fs_uses(insn, &x->ie_l);
+		fs_uses(insn, &x->ie_r);
+	} else if (IR_ISUNEXPR(x))
+		fs_uses(insn, &x->ie_l);
+	else if (x->i_op == IR_REG) {
+		if (insn->i_op == IR_CALL || insn->i_op == IR_RET)
+			xp = NULL;
+		fs_use(insn, x->ie_sym, xp);
+	}
+}
+
+static void
+fs_def(struct ir_insn *insn, struct ir_symbol *sym)
+{
+	regs[sym->is_id].f_ndefs++;
+	regs[sym->is_id].f_def = insn;
+}
+
+/* The uses of registers in x now belong to insn. */
+static void
+fs_move(struct ir_expr *x, struct ir_insn *insn)
+{
+	for (;;) {
+		if (IR_ISBINEXPR(x)) {
+			fs_move(x->ie_r, insn);
+			x = x->ie_l;
+		} else if (IR_ISUNEXPR(x))
+			x = x->ie_l;
+		else {
+			if (x->i_op == IR_REG)
+				regs[x->ie_sym->is_id].f_use = insn;
+			break;
+		}
+	}
+}
+
+static int
+fs_class(struct ir_expr *x)
+{
+	int class = 0;
+
+	if (IR_ISVOLAT(x->ie_type))
+		return FS_BAD;
+	switch (x->i_op) {
+	case IR_REG:
+		if (x->ie_sym->is_id < REG_NREGS)
+			return FS_BAD;
+		return 0;
+	case IR_GVAR:
+	case IR_PVAR:
+	case IR_LVAR:
+		if (x->ie_sym->is_flags & IR_SYM_VOLAT)
+			return FS_BAD;
+		return FS_MEM;
+	case IR_LOAD:
+		if (x->i_flags & IR_LOAD_VOLAT)
+			return FS_BAD;
+		/* FALLTHROUGH */
+	case IR_DIV:
+	case IR_MOD:
+		class = FS_MEM;
+		break;
+	}
+	if (IR_ISBINEXPR(x))
+		class |= fs_class(x->ie_l) | fs_class(x->ie_r);
+	else if (IR_ISUNEXPR(x))
+		class |= fs_class(x->ie_l);
+	return class;
+}
+
+/* Returns 1 if insn assigns to a register that x reads. */
+static int
+fs_clobbers(struct ir_insn *insn, struct ir_expr *x)
+{
+	struct ir_expr *l;
+
+	if (insn->i_op == IR_ASG)
+		l = insn->is_l;
+	else if (insn->i_op == IR_CALL)
+		l = insn->ic_ret;
+	else
+		return 0;
+	if (l == NULL || l->i_op != IR_REG)
+		return 0;
+	for (;;) {
+		if (IR_ISBINEXPR(x)) {
+			if (fs_clobbers(insn, x->ie_r))
+				return 1;
+			x = x->ie_l;
+		} else if (IR_ISUNEXPR(x))
+			x = x->ie_l;
+		else
+			return x->i_op == IR_REG && x->ie_sym == l->ie_sym;
+	}
+}
+
+static int
+fs_canmove(struct ir_insn *def, struct ir_insn *use, int class)
+{
+	struct ir_insn *insn;
+	struct ir_expr *x = def->is_r;
+
+	for (insn = TAILQ_NEXT(def, ii_link); insn != use;
+	    insn = TAILQ_NEXT(insn, ii_link)) {
+		if (insn == NULL || insn->i_op == IR_LBL ||
+		    IR_ISBRANCH(insn) || insn->i_op == IR_RET)
+			return 0;
+		if (fs_clobbers(insn, x))
+			return 0;
+		if (!(class & FS_MEM))
+			continue;
+		if (insn->i_op == IR_ST || insn->i_op == IR_CALL)
+			return 0;
+		if (insn->i_op == IR_ASG && insn->is_l->i_op != IR_REG)
+			return 0;
+	}
+	return 1;
+}
+
+static void
+fs_subst(struct ir_func *fn, struct ir_insn *def)
+{
+	struct ir_expr *l = def->is_l, *x = def->is_r;
+	struct ir_insn *use;
+	struct fsreg *f;
+	int class;
+
+	if (l->i_op != IR_REG || l->ie_sym->is_id < REG_NREGS)
+		return;
+	f = &regs[l->ie_sym->is_id];
+	if (f->f_ndefs != 1 || f->f_nuses != 1)
+		return;
+	use = f->f_use;
+	if (f->f_usep == NULL || use->ii_bb != def->ii_bb)
+		return;
+	if (!ir_type_equal(l->ie_type, x->ie_type))
+		return;
+	if ((class = fs_class(x)) & FS_BAD)
+		return;
+	if (!fs_canmove(def, use, class))
+		return;
+
+	fs_move(x, use);
+	ir_expr_free(*f->f_usep);
+	*f->f_usep = x;
+	f->f_nuses = 0;
+	cfa_bb_delinsn(fn, def->ii_bb, def);
+}
+
+void
+pass_forwsubst(struct passinfo *pi)
+{
+	int i;
+	struct ir_expr *x;
+	struct ir_func *fn = pi->p_fn;
+	struct ir_insn *insn, *ninsn;
+	struct ir_phiarg *arg;
+
+	ir_func_linearize_regs(fn);
+	regs = xmnalloc(fn->if_regid, sizeof *regs);
+	for (i = 0; i < fn->if_regid; i++) {
+		regs[i].f_def = regs[i].f_use = NULL;
+		regs[i].f_usep = NULL;
+		regs[i].f_ndefs = regs[i].f_nuses = 0;
+	}
+
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (insn->i_op == IR_LBL || insn->i_op == IR_B)
+			continue;
+		if (IR_ISBRANCH(insn)) {
+			fs_uses(insn, &insn->ib_l);
+			fs_uses(insn, &insn->ib_r);
+			continue;
+		}
+		switch (insn->i_op) {
+		case IR_ASG:
+			if (insn->is_l->i_op == IR_REG)
+				fs_def(insn, insn->is_l->ie_sym);
+			fs_uses(insn, &insn->is_r);
+			break;
+		case IR_ST:
+			fs_uses(insn, &insn->is_l);
+			fs_uses(insn, &insn->is_r);
+			break;
+		case IR_CALL:
+			SIMPLEQ_FOREACH(x, &insn->ic_argq, ie_link)
+				fs_uses(insn, &x);
+			if (insn->ic_fn->is_op == IR_REGSYM)
+				fs_use(insn, insn->ic_fn, NULL);
+			if (insn->ic_ret != NULL &&
+			    insn->ic_ret->i_op == IR_REG)
+				fs_def(insn, insn->ic_ret->ie_sym);
+			break;
+		case IR_RET:
+			if (insn->ir_retexpr != NULL)
+				fs_uses(insn, &insn->ir_retexpr);
+			break;
+		case IR_PHI:
+			fs_def(insn, insn->ip_sym);
+			SIMPLEQ_FOREACH(arg, &insn->ip_args, ip_link)
+				fs_use(insn, arg->ip_arg, NULL);
+			break;
+		default:
+			fatalx("pass_forwsubst: bad op: 0x%x", insn->i_op);
+		}
+	}
+
+	for (insn = TAILQ_FIRST(&fn->if_iq); insn != NULL; insn = ninsn) {
+		ninsn = TAILQ_NEXT(insn, ii_link);
+		if (insn->i_op == IR_ASG)
+			fs_subst(fn, insn);
+	}
+	free(regs);
+}
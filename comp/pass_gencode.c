@@ -24,39 +24,124 @@
 #include "comp/ir.h"
 #include "comp/passes.h"
 
+#ifdef GENCODE_CHECK
+static u_char **emitv;
+static size_t nemit, maxemit;
+
+static void
+saveemits(struct ir *ir)
+{
+	int i;
+
+	if (nemit == maxemit) {
+		maxemit = maxemit == 0 ? 64 : maxemit * 2;
+		emitv = xrealloc(emitv, maxemit * sizeof *emitv);
+	}
+	emitv[nemit++] = ir->i_emit;
+	for (i = 0; i < ir_nkids[ir->i_op]; i++)
+		saveemits(i == 0 ? ir->i_l : ir->i_r);
+}
+
+static int
+sameemits(struct ir *ir)
+{
+	int i;
+
+	if (emitv[nemit++] != ir->i_emit)
+		return 0;
+	for (i = 0; i < ir_nkids[ir->i_op]; i++) {
+		if (!sameemits(i == 0 ? ir->i_l : ir->i_r))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Select every instruction once more, like the full rescan that the
+ * worklist replaces did, and check that no action rewrites anything and
+ * every node keeps its emit string.
+ */
+static void
+rescan(CGI_CTX *ctx)
+{
+	struct ir_insn *insn;
+
+	TAILQ_FOREACH(insn, &ctx->cc_fn->if_iq, ii_link) {
+		if (insn->i_op == IR_CALL || insn->i_op == IR_RET ||
+		    insn->i_op == IR_LBL || insn->i_op == IR_PHI)
+			continue;
+		nemit = 0;
+		saveemits((struct ir *)insn);
+		ctx->cc_changes = 0;
+		cg((struct ir *)insn);
+		cg_action(ctx, (struct ir *)insn);
+		cgi_recycle();
+		nemit = 0;
+		if (ctx->cc_changes || !sameemits((struct ir *)insn)) {
+			ir_dump_insn(stderr, insn);
+			fatalx("pass_gencode: rescan differs in %s",
+			    ctx->cc_fn->if_sym->is_name);
+		}
+	}
+}
+#endif
+
+/*
+ * Actions may rewrite the instruction they belong to and insert new
+ * instructions in front of it. Only these instructions are selected
+ * again, in the order in which they appear in the function. The others
+ * would get the same patterns again.
+ */
 void
 pass_gencode(struct passinfo *pi)
 {
-	int i;
+	int round;
 	struct ir_func *fn = pi->p_fn;
-	struct ir_insn *insn;
+	struct ir_insn *insn, *last, *p, *prev;
+	struct ir_insnq work;
 	CGI_CTX ctx;
 
 	cg_start();
 	ctx.cc_fn = fn;
-	i = 0;
+	TAILQ_INIT(&work);
 
 	ir_func_setflags(fn, IR_FUNC_LEAF);
-	do {
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (insn->i_op == IR_CALL) {
+			fn->if_flags &= ~IR_FUNC_LEAF;
+			continue;
+		}
+		if (insn->i_op == IR_RET || insn->i_op == IR_LBL ||
+		    insn->i_op == IR_PHI)
+			continue;
+		TAILQ_INSERT_TAIL(&work, insn, ii_cglink);
+	}
+
+	round = 0;
+	last = TAILQ_LAST(&work, ir_insnq);
+	while ((insn = TAILQ_FIRST(&work)) != NULL) {
+		TAILQ_REMOVE(&work, insn, ii_cglink);
+		prev = TAILQ_PREV(insn, ir_insnq, ii_link);
 		ctx.cc_changes = 0;
-		TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
-			if (insn->i_op == IR_CALL) {
-				fn->if_flags &= ~IR_FUNC_LEAF;
-				continue;
-			}
-			if (insn->i_op == IR_RET || insn->i_op == IR_LBL ||
-			    insn->i_op == IR_PHI)
-				continue;
-			if (i && insn->ii_cgskip)
-				continue;
-
-			cg((struct ir *)insn);
-			insn->ii_cgskip = cg_action(&ctx, (struct ir *)insn);
-			cgi_recycle();
+		cg((struct ir *)insn);
+		cg_action(&ctx, (struct ir *)insn);
+		cgi_recycle();
+		if (ctx.cc_changes) {
+			p = prev == NULL ? TAILQ_FIRST(&fn->if_iq) :
+			    TAILQ_NEXT(prev, ii_link);
+			for (; p != insn; p = TAILQ_NEXT(p, ii_link))
+				TAILQ_INSERT_TAIL(&work, p, ii_cglink);
+			TAILQ_INSERT_TAIL(&work, insn, ii_cglink);
 		}
-		if (i++ > 8)
+		if (insn != last)
+			continue;
+		if (++round > 8 && !TAILQ_EMPTY(&work))
 			fatalx("pass_gencode still not done after 8 "
 			    "iterations in %s", fn->if_sym->is_name);
-	} while (ctx.cc_changes);
+		last = TAILQ_LAST(&work, ir_insnq);
+	}
+#ifdef GENCODE_CHECK
+	rescan(&ctx);
+#endif
 	cg_finish();
 }
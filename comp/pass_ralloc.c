@@ -117,6 +117,7 @@ struct node {
 	SLIST_HEAD(, movelink) n_moves;
 	struct	ir_symbol *n_sym;
 	struct	node *n_alias;
+	struct	regset n_forbid;	/* Blocked by precolored neighbors. */
 	int	n_color;
 	int	n_degree;
 	int	n_consround;
@@ -127,6 +128,7 @@ struct node {
 
 #define N_SPILLNODE	1
 #define N_COALNODE	2
+#define N_CALLCROSS	4	/* Live across a call. */
 
 #define ADDNODEWL(wl, n) do {				\
 	TAILQ_INSERT_TAIL(&nodelists[(wl)], n, n_link);	\
@@ -370,10 +372,13 @@ pass_ralloc_addedge(struct ir_func *fn, size_t i, size_t j)
 
 	if (u->n_wl != NL_PRECOLORED && v->n_wl != NL_PRECOLORED)
 		getadjelems(elems, 2);
-	else if (u->n_wl != NL_PRECOLORED)
+	else if (u->n_wl != NL_PRECOLORED) {
 		getadjelems(&elems[0], 1);
-	else
+		BITVEC_OR(&u->n_forbid, &reg_confsets[v->n_color]);
+	} else {
 		getadjelems(&elems[1], 1);
+		BITVEC_OR(&v->n_forbid, &reg_confsets[u->n_color]);
+	}
 	if (u->n_wl != NL_PRECOLORED)
 		addtolist(u, v, &adjlists[i - REG_NREGS], elems[0]);
 	if (v->n_wl != NL_PRECOLORED)
@@ -473,12 +478,41 @@ addtmp(struct ir *ir, struct bitvec *live)
 	}
 }
 
+/*
+ * The temporaries of an expression may be written before its operands
+ * are read for the last time, so they must not share their registers.
+ */
+static void
+addtmp_uses(struct ir *ir, struct ir_expr *x)
+{
+	int i;
+
+	for (;;) {
+		if (IR_ISBINEXPR(x)) {
+			addtmp_uses(ir, x->ie_r);
+			x = x->ie_l;
+		} else if (IR_ISUNEXPR(x))
+			x = x->ie_l;
+		else {
+			if (x->i_op != IR_REG)
+				break;
+			for (i = 0; ir->i_tmpregs[i] != NULL; i++)
+				pass_ralloc_addedge(curfn,
+				    ir->i_tmpregsyms[i]->is_id,
+				    x->ie_sym->is_id);
+			break;
+		}
+	}
+}
+
 static void
 addtmp_expr(struct ir_expr *x, struct bitvec *live)
 {
 	for (;;) {
-		if (x->i_tmpregs != NULL)
+		if (x->i_tmpregs != NULL) {
 			addtmp((struct ir *)x, live);
+			addtmp_uses((struct ir *)x, x);
+		}
 		if (IR_ISBINEXPR(x)) {
 			addtmp_expr(x->ie_r, live);
 			x = x->ie_l;
@@ -497,6 +531,7 @@ build(struct ir_func *fn)
 	struct bitvec *live;
 	struct ir_insn *insn;
 	struct ir_symbol *sym;
+	struct regset *clobbers;
 
 	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
 		live = insn->ii_dfadata.d_liveout;
@@ -557,12 +592,18 @@ build(struct ir_func *fn)
 
 			/*
 			 * Variables that are live across the call should not
-			 * be assigned to volatile registers, but make sure
-			 * that the register used as the return value does not
-			 * interfere with the physical return register.
+			 * be assigned to volatile registers the callee
+			 * clobbers, but make sure that the register used as
+			 * the return value does not interfere with the
+			 * physical return register.
 			 */
+			clobbers = &reg_volat;
+			if (insn->ic_fn->is_op == IR_FUNSYM &&
+			    insn->ic_fn->is_clobbers != NULL)
+				clobbers = insn->ic_fn->is_clobbers;
 			for (i = 0; i < nvreg; i++) {
-				if (vregs[i] != retreg)
+				if (vregs[i] != retreg &&
+				    BITVEC_ISSET(clobbers, vregs[i]))
 					interfere(fn, vregs[i], live);
 			}
 			if (retreg != REG_NREGS) {
@@ -570,6 +611,19 @@ build(struct ir_func *fn)
 				    insn->ic_ret->ie_sym->is_id);
 				interfere(fn, retreg, live);
 			}
+
+			/*
+			 * Only calls that may clobber every volatile register
+			 * make callee-saved registers the better choice.
+			 */
+			if (clobbers != &reg_volat)
+				break;
+			for (i = bitvec_firstset(live); i < live->b_nbit;
+			    i = bitvec_nextset(live, i)) {
+				if (i >= REG_NREGS)
+					fn->if_regs[i]->is_node->n_flags |=
+					    N_CALLCROSS;
+			}
 			break;
 		case IR_RET:
 			if (insn->ir_retexpr == NULL)
@@ -608,7 +662,7 @@ mkworklist(void)
 
 	while (!TAILQ_EMPTY(&initial)) {
 		DEQNODEWL(NL_INITIAL, n);
-		if (n->n_degree >= reg_pb[n->n_rclass])
+		if (n->n_degree >= reg_plimit[n->n_rclass])
 			ADDNODEWL(NL_SPILLWL, n);
 		else if (move_related(n))
 			ADDNODEWL(NL_FREEZEWL, n);
@@ -668,9 +722,10 @@ decrement_degree(struct node *m, struct node *n)
 	int odeg = m->n_degree;
 
 	m->n_degree -= reg_qbc[m->n_rclass][n->n_rclass];
-	if (odeg >= reg_pb[m->n_rclass] && m->n_degree < reg_pb[m->n_rclass]) {
+	if (odeg >= reg_plimit[m->n_rclass] &&
+	    m->n_degree < reg_plimit[m->n_rclass]) {
 #if 0
-	if (odeg > m->n_degree && odeg == reg_pb[m->n_rclass]) {
+	if (odeg > m->n_degree && odeg == reg_plimit[m->n_rclass]) {
 #endif
 		enable_moves(m);
 		if (m->n_wl != NL_SPILLWL)
@@ -708,7 +763,7 @@ static void
 addworklist(struct node *u)
 {
 	if (u->n_wl != NL_PRECOLORED &&
-	    u->n_degree < reg_pb[u->n_rclass] && !move_related(u)) {
+	    u->n_degree < reg_plimit[u->n_rclass] && !move_related(u)) {
 		if (u->n_wl != NL_FREEZEWL)
 			fatalx("addworklist %d is on %d",
 			    u->n_sym->is_id, u->n_wl);
@@ -728,30 +783,34 @@ ok(struct node *u, struct node *v)
 		if (t->n_wl == NL_SELSTACK || t->n_wl == NL_COALNODES)
 			continue;
 		if (t->n_wl == NL_PRECOLORED ||
-		    t->n_degree < reg_pb[t->n_rclass] ||
-		    AMGET(adjmatrix, t->n_sym->is_id, u->n_sym->is_id))
+		    t->n_degree < reg_plimit[t->n_rclass] ||
+		    BITVEC_ISSET(&t->n_forbid, u->n_color))
 			continue;
 		return 0;
 	}
 	return 1;
 }
 
+/*
+ * Add the registers that the significant neighbors of n block for u to k.
+ * Precolored neighbors are already accounted for in the forbidden sets.
+ */
 static int
-doconservative(struct node *u, struct node *n)
+doconservative(struct node *u, struct node *n, int k)
 {
-	int k = 0;
 	struct adjelem *edge;
 	struct node *t;
 
 	SLIST_FOREACH(edge, &adjlists[n->n_sym->is_id - REG_NREGS], a_link) {
 		t = edge->a_node;
-		if (t->n_wl == NL_SELSTACK || t->n_wl == NL_COALNODES)
+		if (t->n_wl == NL_SELSTACK || t->n_wl == NL_COALNODES ||
+		    t->n_wl == NL_PRECOLORED)
 			continue;
 		if (t->n_consround == nconsround)
 			continue;
-		if (t->n_degree >= reg_pb[t->n_rclass]) {
+		if (t->n_degree >= reg_plimit[t->n_rclass]) {
 			k += reg_qbc[u->n_rclass][t->n_rclass];
-			if (k >= reg_pb[u->n_rclass])
+			if (k >= reg_plimit[u->n_rclass])
 				return -1;
 		}
 		t->n_consround = nconsround;
@@ -762,15 +821,21 @@ doconservative(struct node *u, struct node *n)
 static int
 conservative(struct node *u, struct node *v)
 {
-	int k1, k2;
+	int k;
+	struct regset blocked;
 
 	nconsround++;
-	k1 = doconservative(u, u);
-	if (k1 == -1 || k1 >= reg_pb[u->n_rclass])
+	regset_init(&blocked);
+	BITVEC_CPY(&blocked, &u->n_forbid);
+	BITVEC_OR(&blocked, &v->n_forbid);
+	bitvec_and((struct bitvec *)&blocked,
+	    (struct bitvec *)&regclasses[u->n_rclass]);
+	k = BITVEC_COUNT(&blocked);
+	if (k >= reg_plimit[u->n_rclass])
 		return 0;
-	if ((k2 = doconservative(u, v)) == -1)
+	if ((k = doconservative(u, u, k)) == -1)
 		return 0;
-	return k1 + k2 < reg_pb[u->n_rclass];
+	return doconservative(u, v, k) != -1;
 }
 
 static void
@@ -792,6 +857,7 @@ combine(struct node *u, struct node *v)
 		TAILQ_REMOVE(&spillwl, v, n_link);
 	ADDNODEWL(NL_COALNODES, v);
 	v->n_alias = u;
+	u->n_flags |= v->n_flags & N_CALLCROSS;
 	if (Iflag)
 		fprintf(dumpfp, "new alias of v=%d: u=%d\n",
 		    v->n_sym->is_id, u->n_sym->is_id);
@@ -831,7 +897,7 @@ cont:
 		t->n_degree = odeg;
 		/* decrement_degree(t, v); */
 	}
-	if (u->n_wl == NL_FREEZEWL && u->n_degree >= reg_pb[u->n_rclass]) {
+	if (u->n_wl == NL_FREEZEWL && u->n_degree >= reg_plimit[u->n_rclass]) {
 		DELNODEWL(NL_FREEZEWL, u);
 		ADDNODEWL(NL_SPILLWL, u);
 	}
@@ -926,7 +992,7 @@ freeze_moves(struct node *u)
 		ADDMOVEWL(ML_FROZEN, m);
 		if (v->n_wl != NL_FREEZEWL)
 			continue;
-		if (v->n_degree < reg_pb[v->n_rclass] && !move_related(v)) {
+		if (v->n_degree < reg_plimit[v->n_rclass] && !move_related(v)) {
 			TAILQ_REMOVE(&freezewl, v, n_link);
 			ADDNODEWL(NL_SIMPLIFYWL, v);
 		}
@@ -968,15 +1034,51 @@ select_spill(void)
 		printworklists("select_spill");
 }
 
+/*
+ * Choose one of the free colors for n. Values that are live across a
+ * call prefer callee-saved registers, the others prefer volatile ones.
+ * Among the callee-saved registers, those that are already saved are
+ * cheapest.
+ */
+static int
+pickcolor(struct node *n, struct regset *colors, struct regset *used)
+{
+	int best = -1, bestcost = 0, c, cost, tier, besttier = 0;
+	short *order;
+
+	if (n->n_flags & N_CALLCROSS)
+		order = reg_callorder[n->n_rclass];
+	else
+		order = reg_order[n->n_rclass];
+	for (; (c = *order) != -1; order++) {
+		if (!BITVEC_ISSET(colors, c))
+			continue;
+		tier = BITVEC_ISSET(&reg_volat, c) ==
+		    !!(n->n_flags & N_CALLCROSS);
+		cost = reg_cost[c];
+		if (!BITVEC_ISSET(&reg_volat, c) &&
+		    BITVEC_MEET(used, &reg_confsets[c]))
+			cost = 0;
+		if (best == -1 || tier < besttier ||
+		    (tier == besttier && cost < bestcost)) {
+			best = c;
+			besttier = tier;
+			bestcost = cost;
+		}
+	}
+	return best;
+}
+
 static void
 assign_colors(void)
 {
-	int c, i;
+	int c;
 	struct adjelem *edge;
 	struct node *n, *w;
-	struct regset colors;
+	struct regset colors, used;
 
 	regset_init(&colors);
+	regset_init(&used);
 	while (!TAILQ_EMPTY(&select_stack)) {
 		DEQNODEWL(NL_SELSTACK, n);
 		BITVEC_CPY(&colors, &regclasses[n->n_rclass]);
@@ -986,24 +1088,19 @@ assign_colors(void)
 			if (w->n_wl != NL_COLOREDNODES &&
 			    w->n_wl != NL_PRECOLORED)
 				continue;
-
-			c = w->n_color;
-			for (i = 0; reg_conflicts[c][i] != -1; i++)
-				BITVEC_CLEARBIT(&colors, reg_conflicts[c][i]);
+			BITVEC_ANDNOT(&colors, &reg_confsets[w->n_color]);
 		}
-		if ((c = BITVEC_FIRSTSET(&colors)) == colors.b_nbit) {
+		if ((c = pickcolor(n, &colors, &used)) == -1) {
 			ADDNODEWL(NL_SPILLEDNODES, n);
 			if (n->n_sym->is_flags & IR_SYM_RATMP)
 				fatalx("assign_colors: no color for tmp sym");
 		} else {
-			/*
-			 * TODO: Use a volatile register as color if possible.
-			 */
 			if (n->n_color != -1 &&
 			    BITVEC_ISSET(&colors, n->n_color))
 				c = n->n_color;
 			ADDNODEWL(NL_COLOREDNODES, n);
 			n->n_color = c;
+			BITVEC_OR(&used, &reg_confsets[c]);
 		}
 	}
 	TAILQ_FOREACH(n, &coalesced_nodes, n_link) {
@@ -1143,6 +1240,154 @@ getphysreg(struct ir_symbol *sym)
 	return physregs[n->n_color];
 }
 
+/*
+ * Spill slots are the spilled REGSYMs themselves. They are only
+ * referenced by the loads and stores that rewrite_program() inserts, so
+ * their live ranges can be computed like those of registers. Slots of
+ * the same size and alignment whose live ranges do not overlap are
+ * merged, which makes the stack frame smaller.
+ */
+static int
+slotref(struct ir_expr *x, int *slotno)
+{
+	if (x->i_op != IR_LVAR || x->ie_sym->is_op != IR_REGSYM)
+		return -1;
+	return slotno[x->ie_sym->is_id];
+}
+
+static void
+colorslots(void)
+{
+	int changes, i, j, nslots, s, *slotno;
+	struct bitvec **conflicts, **def, **in, *live, **out, **use;
+	struct cfa_bb *bb;
+	struct cfa_bblink *bbl;
+	struct cfadata *cfa = curfn->if_cfadata;
+	struct ir_insn *insn, *term;
+	struct ir_symbol *sym, **slots;
+
+	slotno = mem_mnalloc(&mem, curfn->if_regid, sizeof *slotno);
+	for (i = 0; i < curfn->if_regid; i++)
+		slotno[i] = -1;
+	nslots = 0;
+	SIMPLEQ_FOREACH(sym, &curfn->if_regq, is_link) {
+		if (sym->is_flags & IR_SYM_USED)
+			slotno[sym->is_id] = nslots++;
+	}
+	if (nslots < 2)
+		return;
+	slots = mem_mnalloc(&mem, nslots, sizeof *slots);
+	SIMPLEQ_FOREACH(sym, &curfn->if_regq, is_link) {
+		if (sym->is_flags & IR_SYM_USED)
+			slots[slotno[sym->is_id]] = sym;
+	}
+
+	/* Local uses and definitions of slots. */
+	def = mem_mnalloc(&mem, cfa->c_nbb, sizeof *def);
+	use = mem_mnalloc(&mem, cfa->c_nbb, sizeof *use);
+	in = mem_mnalloc(&mem, cfa->c_nbb, sizeof *in);
+	out = mem_mnalloc(&mem, cfa->c_nbb, sizeof *out);
+	SIMPLEQ_FOREACH(bb, &cfa->c_bbqh, cb_glolink) {
+		def[bb->cb_id] = bitvec_alloc(&mem, nslots);
+		use[bb->cb_id] = bitvec_alloc(&mem, nslots);
+		in[bb->cb_id] = bitvec_alloc(&mem, nslots);
+		out[bb->cb_id] = bitvec_alloc(&mem, nslots);
+		if (bb->cb_first == NULL)
+			continue;
+		term = TAILQ_PREV(bb->cb_first, ir_insnq, ii_link);
+		for (insn = bb->cb_last; insn != term;
+		    insn = TAILQ_PREV(insn, ir_insnq, ii_link)) {
+			if (insn->i_op != IR_ASG)
+				continue;
+			if ((s = slotref(insn->is_l, slotno)) != -1) {
+				bitvec_setbit(def[bb->cb_id], s);
+				bitvec_clearbit(use[bb->cb_id], s);
+			} else if ((s = slotref(insn->is_r, slotno)) != -1)
+				bitvec_setbit(use[bb->cb_id], s);
+		}
+	}
+
+	/* Slots live at the end of each basic block. */
+	live = bitvec_alloc(&mem, nslots);
+	cfa_cfgsort(curfn, CFA_CFGSORT_DESC);
+	do {
+		changes = 0;
+		SIMPLEQ_FOREACH(bb, &cfa->c_bbqh, cb_glolink) {
+			SIMPLEQ_FOREACH(bbl, &bb->cb_succs, cb_link)
+				bitvec_or(out[bb->cb_id], in[bbl->cb_bb->cb_id]);
+			bitvec_cpy(live, def[bb->cb_id]);
+			bitvec_not(live);
+			bitvec_and(live, out[bb->cb_id]);
+			bitvec_or(live, use[bb->cb_id]);
+			if (bitvec_cmp(live, in[bb->cb_id])) {
+				bitvec_cpy(in[bb->cb_id], live);
+				changes = 1;
+			}
+		}
+	} while (changes);
+
+	/* A store into a slot conflicts with all other live slots. */
+	conflicts = mem_mnalloc(&mem, nslots, sizeof *conflicts);
+	for (i = 0; i < nslots; i++)
+		conflicts[i] = bitvec_alloc(&mem, nslots);
+	SIMPLEQ_FOREACH(bb, &cfa->c_bbqh, cb_glolink) {
+		if (bb->cb_first == NULL)
+			continue;
+		bitvec_cpy(live, out[bb->cb_id]);
+		term = TAILQ_PREV(bb->cb_first, ir_insnq, ii_link);
+		for (insn = bb->cb_last; insn != term;
+		    insn = TAILQ_PREV(insn, ir_insnq, ii_link)) {
+			if (insn->i_op != IR_ASG)
+				continue;
+			if ((s = slotref(insn->is_l, slotno)) != -1) {
+				bitvec_clearbit(live, s);
+				for (i = bitvec_firstset(live); i < nslots;
+				    i = bitvec_nextset(live, i)) {
+					bitvec_setbit(conflicts[s], i);
+					bitvec_setbit(conflicts[i], s);
+				}
+			} else if ((s = slotref(insn->is_r, slotno)) != -1)
+				bitvec_setbit(live, s);
+		}
+	}
+
+	/*
+	 * Greedily merge each slot into the first earlier slot of the same
+	 * shape that conflicts with none of the slots already merged into
+	 * it. conflicts[] of a representative accumulates those of its
+	 * members.
+	 */
+	for (i = 0; i < nslots; i++) {
+		for (j = 0; j < i; j++) {
+			if (slots[j] == NULL ||
+			    slots[j]->is_size != slots[i]->is_size ||
+			    slots[j]->is_align != slots[i]->is_align ||
+			    bitvec_isset(conflicts[j], i))
+				continue;
+			bitvec_or(conflicts[j], conflicts[i]);
+			for (s = bitvec_firstset(conflicts[i]); s < nslots;
+			    s = bitvec_nextset(conflicts[i], s))
+				bitvec_setbit(conflicts[s], j);
+			if (Iflag)
+				fprintf(dumpfp, "slot %d shares %d\n",
+				    slots[i]->is_id, slots[j]->is_id);
+			slotno[slots[i]->is_id] = j;
+			slots[i]->is_flags &= ~IR_SYM_USED;
+			slots[i] = NULL;
+			break;
+		}
+	}
+
+	TAILQ_FOREACH(insn, &curfn->if_iq, ii_link) {
+		if (insn->i_op != IR_ASG)
+			continue;
+		if ((s = slotref(insn->is_l, slotno)) != -1)
+			insn->is_l->ie_sym = slots[s];
+		else if ((s = slotref(insn->is_r, slotno)) != -1)
+			insn->is_r->ie_sym = slots[s];
+	}
+}
+
 static void
 insert_tmp(struct ir *ir)
 {
@@ -1213,6 +1458,7 @@ insert_regs(void)
 	}
 
 	/* Remove regs that are not used for spilling. */
+	colorslots();
 	prev = NULL;
 	for (sym = SIMPLEQ_FIRST(&curfn->if_regq); sym != NULL; sym = next) {
 		next = SIMPLEQ_NEXT(sym, is_link);
@@ -1252,6 +1498,417 @@ delcoalesced(void)
 #endif
 }
 
+/*
+ * Remember which volatile registers a call to the function clobbers.
+ * These are the registers the function uses itself, the ones that its
+ * callees clobber and the ones the target code uses behind our back.
+ */
+static void
+setclobbers(struct ir_func *fn)
+{
+	size_t i;
+	struct ir_insn *insn;
+	struct regset *callee, *rs;
+
+	rs = xmalloc(sizeof *rs);
+	regset_init(rs);
+	BITVEC_CPY(rs, &fn->if_usedregs);
+	pass_ralloc_clobbers(fn, rs);
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (insn->i_op != IR_CALL)
+			continue;
+		if (insn->ic_fn->is_op == IR_FUNSYM &&
+		    insn->ic_fn->is_clobbers != NULL)
+			callee = insn->ic_fn->is_clobbers;
+		else
+			callee = &reg_volat;
+		bitvec_or((struct bitvec *)rs, (struct bitvec *)callee);
+	}
+	for (i = BITVEC_FIRSTSET(rs); i < REG_NREGS;
+	    i = BITVEC_NEXTSET(rs, i))
+		BITVEC_OR(rs, &reg_confsets[i]);
+	bitvec_and((struct bitvec *)rs, (struct bitvec *)&reg_volat);
+	fn->if_sym->is_clobbers = rs;
+}
+
+static int
+dominates(struct cfa_bb *d, struct cfa_bb *bb)
+{
+	for (; bb != NULL; bb = bb->cb_immdom) {
+		if (bb == d)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Mark the blocks of the natural loop with header h.
+ */
+static void
+loopbody(struct cfadata *cfa, struct cfa_bb *h, uint8_t *inloop)
+{
+	int sp = 0;
+	struct cfa_bb *bb, **stack;
+	struct cfa_bblink *bbl;
+
+	stack = xcalloc(cfa->c_nbb, sizeof *stack);
+	memset(inloop, 0, cfa->c_nbb);
+	inloop[h->cb_id] = 1;
+	SIMPLEQ_FOREACH(bbl, &h->cb_preds, cb_link) {
+		if (!dominates(h, bbl->cb_bb) || inloop[bbl->cb_bb->cb_id])
+			continue;
+		inloop[bbl->cb_bb->cb_id] = 1;
+		stack[sp++] = bbl->cb_bb;
+	}
+	while (sp > 0) {
+		bb = stack[--sp];
+		SIMPLEQ_FOREACH(bbl, &bb->cb_preds, cb_link) {
+			if (inloop[bbl->cb_bb->cb_id])
+				continue;
+			inloop[bbl->cb_bb->cb_id] = 1;
+			stack[sp++] = bbl->cb_bb;
+		}
+	}
+	free(stack);
+}
+
+static void
+markregs(struct ir_expr *x, struct bitvec *bv)
+{
+	for (;;) {
+		if (IR_ISBINEXPR(x)) {
+			markregs(x->ie_r, bv);
+			x = x->ie_l;
+		} else if (IR_ISUNEXPR(x))
+			x = x->ie_l;
+		else {
+			if (x->i_op == IR_REG)
+				bitvec_setbit(bv, x->ie_sym->is_id);
+			break;
+		}
+	}
+}
+
+static void
+renameregs(struct ir_expr *x, struct ir_symbol **map, size_t nmap)
+{
+	for (;;) {
+		if (IR_ISBINEXPR(x)) {
+			renameregs(x->ie_r, map, nmap);
+			x = x->ie_l;
+		} else if (IR_ISUNEXPR(x))
+			x = x->ie_l;
+		else {
+			if (x->i_op == IR_REG && x->ie_sym->is_id < nmap &&
+			    map[x->ie_sym->is_id] != NULL)
+				x->ie_sym = map[x->ie_sym->is_id];
+			break;
+		}
+	}
+}
+
+/*
+ * Find the registers that are live across a call somewhere in the
+ * function, but are only read inside the call-free loop with header h.
+ */
+static struct bitvec *
+loopregs(struct ir_func *fn, struct cfa_bb *h, uint8_t *inloop,
+    struct bitvec *cross)
+{
+	size_t nreg;
+	struct bitvec *def, *use;
+	struct ir_insn *hlbl, *insn;
+
+	if ((hlbl = h->cb_first) == NULL || hlbl->i_op != IR_LBL ||
+	    hlbl->ii_dfadata.d_livein == NULL)
+		return NULL;
+	nreg = fn->if_regid;
+	def = bitvec_alloc(NULL, nreg);
+	use = bitvec_alloc(NULL, nreg);
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (!inloop[insn->ii_bb->cb_id])
+			continue;
+		if (insn->i_op == IR_CALL) {
+			free(def);
+			free(use);
+			return NULL;
+		}
+		if (insn->i_op == IR_B || insn->i_op == IR_LBL)
+			continue;
+		if (IR_ISBRANCH(insn)) {
+			markregs(insn->ib_l, use);
+			markregs(insn->ib_r, use);
+		} else if (insn->i_op == IR_ASG || insn->i_op == IR_ST) {
+			if (insn->i_op == IR_ASG && insn->is_l->i_op == IR_REG)
+				bitvec_setbit(def, insn->is_l->ie_sym->is_id);
+			else
+				markregs(insn->is_l, use);
+			markregs(insn->is_r, use);
+		} else if (insn->i_op == IR_RET && insn->ir_retexpr != NULL)
+			markregs(insn->ir_retexpr, use);
+	}
+	bitvec_andnot(use, def);
+	bitvec_and(use, cross);
+	bitvec_and(use, hlbl->ii_dfadata.d_livein);
+	free(def);
+	return use;
+}
+
+/*
+ * Give the loop with header h its own copy of the registers in split,
+ * which is set in a new preheader. Because the copy does not live
+ * across a call, it can be kept in a volatile register while the
+ * original may end up spilled. If splitting was not needed, coalescing
+ * removes the copy again.
+ */
+static void
+splitloop(struct ir_func *fn, struct cfa_bb *h, uint8_t *inloop,
+    struct bitvec *split)
+{
+	int nsplit = 0;
+	size_t i, nreg;
+	struct ir_insn *hlbl, *insn, *pre, *prev;
+	struct ir_symbol **map;
+
+	hlbl = h->cb_first;
+	nreg = split->b_nbit;
+	map = xcalloc(nreg, sizeof *map);
+	for (i = bitvec_firstset(split); i < nreg;
+	    i = bitvec_nextset(split, i)) {
+		if (i < REG_NREGS || fn->if_regs[i]->is_flags & IR_SYM_RATMP)
+			continue;
+		map[i] = newnode(fn->if_regs[i]);
+		nsplit++;
+		if (Iflag)
+			fprintf(dumpfp, "split %zu into %d at .L%d\n", i,
+			    map[i]->is_id, ((struct ir_lbl *)hlbl)->il_id);
+	}
+	if (nsplit == 0) {
+		free(map);
+		return;
+	}
+
+	/*
+	 * Redirect the loop entries to the preheader. Instructions added
+	 * by earlier splits have no block and never branch to h.
+	 */
+	pre = ir_lbl();
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (!IR_ISBRANCH(insn) || insn->ii_bb == NULL ||
+		    inloop[insn->ii_bb->cb_id])
+			continue;
+		if (insn->ib_lbl == (struct ir_lbl *)hlbl)
+			insn->ib_lbl = (struct ir_lbl *)pre;
+	}
+
+	/* Do not fall through from inside the loop into the preheader. */
+	prev = TAILQ_PREV(hlbl, ir_insnq, ii_link);
+	if (prev != NULL && prev->ii_bb != NULL &&
+	    inloop[prev->ii_bb->cb_id] &&
+	    prev->i_op != IR_B && prev->i_op != IR_RET)
+		ir_prepend_insn(hlbl, ir_b(hlbl));
+	ir_prepend_insn(hlbl, pre);
+	for (i = 0; i < nreg; i++) {
+		if (map[i] != NULL)
+			ir_prepend_insn(hlbl, ir_asg(ir_virtreg(map[i]),
+			    ir_virtreg(fn->if_regs[i])));
+	}
+
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (insn->ii_bb == NULL || !inloop[insn->ii_bb->cb_id] ||
+		    insn->i_op == IR_B || insn->i_op == IR_LBL)
+			continue;
+		if (IR_ISBRANCH(insn)) {
+			renameregs(insn->ib_l, map, nreg);
+			renameregs(insn->ib_r, map, nreg);
+		} else if (insn->i_op == IR_ASG || insn->i_op == IR_ST) {
+			renameregs(insn->is_l, map, nreg);
+			renameregs(insn->is_r, map, nreg);
+		} else if (insn->i_op == IR_RET && insn->ir_retexpr != NULL)
+			renameregs(insn->ir_retexpr, map, nreg);
+	}
+	free(map);
+}
+
+/*
+ * Split the ranges of the registers in hot at the calls they live
+ * across outside of all loops. The value is copied into a new register
+ * before such a call and back right after it, so only the copy needs a
+ * nonvolatile register or a stack slot and the rest of the range,
+ * including the loop, can use a volatile register. If splitting was not
+ * needed, coalescing removes the copies again.
+ */
+static void
+splitcalls(struct ir_func *fn, uint8_t *anyloop, struct bitvec *hot)
+{
+	size_t i, nreg;
+	struct bitvec *live;
+	struct ir_insn *insn, *next;
+	struct ir_symbol *sym;
+
+	nreg = hot->b_nbit;
+	live = bitvec_alloc(NULL, nreg);
+	for (insn = TAILQ_FIRST(&fn->if_iq); insn != NULL; insn = next) {
+		next = TAILQ_NEXT(insn, ii_link);
+		if (insn->i_op != IR_CALL || anyloop[insn->ii_bb->cb_id] ||
+		    insn->ii_dfadata.d_liveout == NULL)
+			continue;
+		bitvec_cpy(live, insn->ii_dfadata.d_liveout);
+		bitvec_and(live, insn->ii_dfadata.d_livein);
+		bitvec_and(live, hot);
+		if (insn->ic_ret != NULL && insn->ic_ret->i_op == IR_REG)
+			bitvec_clearbit(live, insn->ic_ret->ie_sym->is_id);
+		for (i = bitvec_firstset(live); i < nreg;
+		    i = bitvec_nextset(live, i)) {
+			if (i < REG_NREGS ||
+			    fn->if_regs[i]->is_flags & IR_SYM_RATMP)
+				continue;
+			sym = newnode(fn->if_regs[i]);
+			ir_prepend_insn(insn, ir_asg(ir_virtreg(sym),
+			    ir_virtreg(fn->if_regs[i])));
+			ir_append_insn(fn, insn,
+			    ir_asg(ir_virtreg(fn->if_regs[i]),
+			    ir_virtreg(sym)));
+			if (Iflag)
+				fprintf(dumpfp, "split %zu into %d around "
+				    "call\n", i, sym->is_id);
+		}
+	}
+	free(live);
+}
+
+/*
+ * Split live ranges at calls and loop boundaries, so that values in
+ * loops do not pay for calls outside of the loop. All splits are
+ * decided on one liveness analysis and then carried out together; the
+ * caller rebuilds the CFG afterwards.
+ */
+static void
+splitranges(struct ir_func *fn)
+{
+	int i, j, nloops;
+	size_t k, nreg;
+	uint8_t *anyloop, **body;
+	struct bitvec *any, *cross, *hot, *tmp, **split;
+	struct cfadata *cfa;
+	struct cfa_bb *bb, **head;
+	struct cfa_bblink *bbl;
+	struct ir_expr *x;
+	struct ir_insn *insn;
+
+	cfa_buildcfg(fn);
+	cfa_calcdom(fn);
+	dfa_livevar(fn);
+	cfa = fn->if_cfadata;
+	nreg = fn->if_regid;
+
+	/*
+	 * Registers that are live across any call, and those that stay
+	 * live across a call after splitting at the calls outside of
+	 * loops: calls in loops and the results of calls.
+	 */
+	any = bitvec_alloc(NULL, nreg);
+	cross = bitvec_alloc(NULL, nreg);
+	tmp = bitvec_alloc(NULL, nreg);
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (insn->i_op != IR_CALL || insn->ii_dfadata.d_liveout == NULL)
+			continue;
+		bitvec_cpy(tmp, insn->ii_dfadata.d_liveout);
+		bitvec_and(tmp, insn->ii_dfadata.d_livein);
+		bitvec_or(any, tmp);
+	}
+	if (bitvec_firstset(any) == nreg)
+		goto out;
+
+	head = xcalloc(cfa->c_nbb, sizeof *head);
+	body = xcalloc(cfa->c_nbb, sizeof *body);
+	anyloop = xcalloc(cfa->c_nbb, 1);
+	nloops = 0;
+	SIMPLEQ_FOREACH(bb, &cfa->c_bbqh, cb_glolink) {
+		SIMPLEQ_FOREACH(bbl, &bb->cb_preds, cb_link) {
+			if (dominates(bb, bbl->cb_bb))
+				break;
+		}
+		if (bbl == NULL)
+			continue;
+		head[nloops] = bb;
+		body[nloops] = xmalloc(cfa->c_nbb);
+		loopbody(cfa, bb, body[nloops]);
+		for (k = 0; k < (size_t)cfa->c_nbb; k++)
+			anyloop[k] |= body[nloops][k];
+		nloops++;
+	}
+
+	/* Registers read in any loop. */
+	hot = bitvec_alloc(NULL, nreg);
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (!anyloop[insn->ii_bb->cb_id])
+			continue;
+		if (IR_ISBRANCH(insn) && insn->i_op != IR_B) {
+			markregs(insn->ib_l, hot);
+			markregs(insn->ib_r, hot);
+		} else if (insn->i_op == IR_ASG || insn->i_op == IR_ST) {
+			if (insn->i_op != IR_ASG || insn->is_l->i_op != IR_REG)
+				markregs(insn->is_l, hot);
+			markregs(insn->is_r, hot);
+		} else if (insn->i_op == IR_CALL) {
+			SIMPLEQ_FOREACH(x, &insn->ic_argq, ie_link)
+				markregs(x, hot);
+		} else if (insn->i_op == IR_RET && insn->ir_retexpr != NULL)
+			markregs(insn->ir_retexpr, hot);
+	}
+
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (insn->i_op != IR_CALL || insn->ii_dfadata.d_liveout == NULL)
+			continue;
+		if (anyloop[insn->ii_bb->cb_id]) {
+			bitvec_cpy(tmp, insn->ii_dfadata.d_liveout);
+			bitvec_and(tmp, insn->ii_dfadata.d_livein);
+			bitvec_or(cross, tmp);
+		} else if (insn->ic_ret != NULL &&
+		    insn->ic_ret->i_op == IR_REG) {
+			k = insn->ic_ret->ie_sym->is_id;
+			if (bitvec_isset(insn->ii_dfadata.d_liveout, k) &&
+			    bitvec_isset(insn->ii_dfadata.d_livein, k))
+				bitvec_setbit(cross, k);
+		}
+	}
+
+	/*
+	 * Decide on all splits before changing the code. The copy for an
+	 * enclosing loop already serves the loops nested in it.
+	 */
+	split = xcalloc(nloops, sizeof *split);
+	for (i = 0; i < nloops; i++)
+		split[i] = loopregs(fn, head[i], body[i], cross);
+	for (i = 0; i < nloops; i++) {
+		for (j = 0; j < nloops && split[i] != NULL; j++) {
+			if (j != i && split[j] != NULL &&
+			    body[j][head[i]->cb_id])
+				bitvec_andnot(split[i], split[j]);
+		}
+	}
+
+	for (i = 0; i < nloops; i++) {
+		if (split[i] != NULL) {
+			splitloop(fn, head[i], body[i], split[i]);
+			free(split[i]);
+		}
+		free(body[i]);
+	}
+	splitcalls(fn, anyloop, hot);
+
+	free(split);
+	free(hot);
+	free(anyloop);
+	free(body);
+	free(head);
+out:
+	free(tmp);
+	free(cross);
+	free(any);
+}
+
 static void
 alloctmp(struct ir *ir)
 {
@@ -1301,6 +1958,12 @@ pass_ralloc(struct passinfo *pi)
 
 	static int dumpno;
 
+	/* Registers were already assigned by pass_chordal. */
+	if (fn->if_flags & IR_FUNC_CHORDAL) {
+		setclobbers(fn);
+		return;
+	}
+
 	if (nvreg == -1) {
 		for (i = 0, j = BITVEC_FIRSTSET(&reg_volat);
 		    j < reg_volat.b_nbit;
@@ -1398,6 +2061,8 @@ pass_ralloc(struct passinfo *pi)
 	if (Iflag)
 		dumpfp = dump_open("RA", fn->if_sym->is_name, "w", dumpno++);
 
+	if (!(fn->if_flags & IR_FUNC_SETJMP))
+		splitranges(fn);
 	cfa_buildcfg(fn);
 	for (nrounds = 1; nrounds <= ROUNDS_MAX; nrounds++) {
 		freemoves = allmoves;
@@ -1438,6 +2103,8 @@ pass_ralloc(struct passinfo *pi)
 			n->n_alias = NULL;
 			n->n_color = -1;
 			n->n_degree = 0;
+			n->n_flags &= ~N_CALLCROSS;
+			regset_init(&n->n_forbid);
 		}
 #if PRECOLOR_CALLARGS
 		TAILQ_FOREACH(n, &precolored, n_link) {
@@ -1479,6 +2146,7 @@ pass_ralloc(struct passinfo *pi)
 		assign_colors();
 		if (TAILQ_EMPTY(&spilled_nodes)) {
 			insert_regs();
+			setclobbers(fn);
 			mem_area_free(&mem);
 			free(adjmatrix);
 			free(adjlists);
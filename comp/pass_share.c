@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2008 Stefan Kempf <sisnkemp@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Let equal subexpressions of an instruction share one node, so that the
+ * instruction selector sees a DAG. It decides whether to compute such an
+ * expression once or to copy it into each of its uses. Nothing in an
+ * expression has side effects or changes memory, so equal expressions
+ * of one instruction have equal values. Leaves are not worth sharing,
+ * and expressions that read volatile objects must be evaluated as often
+ * as they are written.
+ */
+
+#include <sys/types.h>
+#include <sys/queue.h>
+
+#include "comp/comp.h"
+#include "comp/ir.h"
+#include "comp/passes.h"
+
+#define SHARE_MAX	64
+
+static struct ir_expr *exprs[SHARE_MAX];
+static int nexprs;
+
+static int
+equal(struct ir_expr *a, struct ir_expr *b)
+{
+	if (a == b)
+		return 1;
+	if (a->i_op != b->i_op || !ir_type_equal(a->ie_type, b->ie_type))
+		return 0;
+	if (IR_ISBINEXPR(a))
+		return equal(a->ie_l, b->ie_l) && equal(a->ie_r, b->ie_r);
+	if (a->i_op == IR_SOUREF && (a->ie_sou != b->ie_sou ||
+	    a->ie_elm != b->ie_elm))
+		return 0;
+	if (IR_ISUNEXPR(a))
+		return equal(a->ie_l, b->ie_l);
+
+	switch (a->i_op) {
+	case IR_ICON:
+		return a->ie_con.ic_icon == b->ie_con.ic_icon;
+	case IR_FCON:
+		return a->ie_con.ic_fcon == b->ie_con.ic_fcon;
+	default:
+		return a->ie_sym == b->ie_sym;
+	}
+}
+
+/* Returns 1 if x reads a volatile variable or loads a volatile object. */
+static int
+isvolat(struct ir_expr *x)
+{
+	for (;;) {
+		if (IR_ISVOLAT(x->ie_type) ||
+		    (x->i_op == IR_LOAD && (x->i_flags & IR_LOAD_VOLAT)))
+			return 1;
+		if (IR_ISBINEXPR(x)) {
+			if (isvolat(x->ie_r))
+				return 1;
+			x = x->ie_l;
+		} else if (IR_ISUNEXPR(x))
+			x = x->ie_l;
+		else
+			break;
+	}
+	switch (x->i_op) {
+	case IR_GVAR:
+	case IR_PVAR:
+	case IR_LVAR:
+		return (x->ie_sym->is_flags & IR_SYM_VOLAT) != 0;
+	}
+	return 0;
+}
+
+static void
+share(struct ir_expr **xp)
+{
+	int i;
+	struct ir_expr *x = *xp;
+
+	if (IR_ISLEAFEXPR(x) || isvolat(x))
+		return;
+	for (i = 0; i < nexprs; i++) {
+		if (equal(exprs[i], x)) {
+			if (exprs[i] != x)
+				ir_expr_free(x);
+			*xp = ir_expr_share(exprs[i]);
+			return;
+		}
+	}
+	if (IR_ISBINEXPR(x)) {
+		share(&x->ie_l);
+		share(&x->ie_r);
+	} else
+		share(&x->ie_l);
+	if (nexprs < SHARE_MAX)
+		exprs[nexprs++] = x;
+}
+
+void
+pass_share(struct passinfo *pi)
+{
+	struct ir_func *fn = pi->p_fn;
+	struct ir_insn *insn;
+
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		nexprs = 0;
+		if (insn->i_op != IR_B && IR_ISBRANCH(insn)) {
+			share(&insn->ib_l);
+			share(&insn->ib_r);
+		} else if (insn->i_op == IR_ASG)
+			share(&insn->is_r);
+		else if (insn->i_op == IR_ST) {
+			share(&insn->is_l);
+			share(&insn->is_r);
+		}
+	}
+}
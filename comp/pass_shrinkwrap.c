@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2008 Stefan Kempf <sisnkemp@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Whole-frame shrink-wrapping: Move the prologue from the function
+ * entry to the nearest basic block that dominates all blocks which need
+ * the stack frame, i.e. that call functions, access stack slots or use
+ * nonvolatile registers. Returns that are not dominated by this block
+ * leave the function without touching the frame.
+ *
+ * The prologue sets up the frame and saves all nonvolatile registers
+ * at once, so it moves as a unit; saves are not placed per register.
+ * The block where the prologue goes must not be part of a loop and
+ * every return reachable from it must be dominated by it. Otherwise,
+ * the prologue stays at the function entry.
+ */
+
+#include <sys/types.h>
+#include <sys/queue.h>
+
+#include <stdlib.h>
+
+#include "comp/comp.h"
+#include "comp/ir.h"
+#include "comp/passes.h"
+
+static int needframe_expr(struct ir_expr *);
+static int needframe(struct ir_insn *);
+static int dominates(struct cfa_bb *, struct cfa_bb *);
+static struct cfa_bb *commondom(struct cfa_bb *, struct cfa_bb *);
+static int reach(struct cfa_bb *, struct cfa_bb *, uint8_t *);
+
+static int
+nonvolreg(struct ir_symbol *sym)
+{
+	return sym->is_id < REG_NREGS && BITVEC_ISSET(&reg_nonvolat, sym->is_id);
+}
+
+static int
+needframe_tmp(struct ir *ir)
+{
+	int i;
+
+	if (ir->i_tmpregs == NULL)
+		return 0;
+	for (i = 0; ir->i_tmpregs[i] != NULL; i++) {
+		if (nonvolreg(ir->i_tmpregsyms[i]))
+			return 1;
+	}
+	return 0;
+}
+
+static int
+needframe_expr(struct ir_expr *x)
+{
+	for (;;) {
+		if (needframe_tmp((struct ir *)x))
+			return 1;
+		if (IR_ISBINEXPR(x)) {
+			if (needframe_expr(x->ie_r))
+				return 1;
+			x = x->ie_l;
+		} else if (IR_ISUNEXPR(x))
+			x = x->ie_l;
+		else {
+			switch (x->i_op) {
+			case IR_PVAR:
+			case IR_LVAR:
+			case IR_PADDR:
+			case IR_LADDR:
+				return 1;
+			case IR_REG:
+				return nonvolreg(x->ie_sym);
+			}
+			return 0;
+		}
+	}
+}
+
+static int
+needframe(struct ir_insn *insn)
+{
+	if (needframe_tmp((struct ir *)insn))
+		return 1;
+	if (IR_ISBRANCH(insn)) {
+		if (insn->i_op == IR_B)
+			return 0;
+		return needframe_expr(insn->ib_l) || needframe_expr(insn->ib_r);
+	}
+	switch (insn->i_op) {
+	case IR_ASG:
+	case IR_ST:
+		return needframe_expr(insn->is_l) || needframe_expr(insn->is_r);
+	case IR_CALL:
+		return 1;
+	case IR_RET:
+		if (insn->ir_retexpr != NULL)
+			return needframe_expr(insn->ir_retexpr);
+		return 0;
+	case IR_LBL:
+		return 0;
+	default:
+		fatalx("needframe: bad op: 0x%x", insn->i_op);
+	}
+}
+
+static int
+dominates(struct cfa_bb *d, struct cfa_bb *bb)
+{
+	for (; bb != NULL; bb = bb->cb_immdom) {
+		if (bb == d)
+			return 1;
+	}
+	return 0;
+}
+
+static struct cfa_bb *
+commondom(struct cfa_bb *a, struct cfa_bb *b)
+{
+	for (; a != NULL; a = a->cb_immdom) {
+		if (dominates(a, b))
+			return a;
+	}
+	fatalx("commondom");
+}
+
+/*
+ * Mark all blocks reachable from bb. Returns 1 if target is among
+ * them.
+ */
+static int
+reach(struct cfa_bb *bb, struct cfa_bb *target, uint8_t *seen)
+{
+	int found = 0;
+	struct cfa_bblink *bbl;
+
+	SIMPLEQ_FOREACH(bbl, &bb->cb_succs, cb_link) {
+		if (bbl->cb_bb == target)
+			found = 1;
+		if (seen[bbl->cb_bb->cb_id])
+			continue;
+		seen[bbl->cb_bb->cb_id] = 1;
+		found |= reach(bbl->cb_bb, target, seen);
+	}
+	return found;
+}
+
+void
+pass_shrinkwrap(struct passinfo *pi)
+{
+	uint8_t *seen;
+	struct ir_func *fn = pi->p_fn;
+	struct cfadata *cfa;
+	struct cfa_bb *bb, *d, *first;
+	struct ir_insn *insn, *lbl;
+
+	fn->if_prologue = NULL;
+	fn->if_flags &= ~IR_FUNC_NOFRAME;
+	if (fn->if_flags & IR_FUNC_VARARGS || !pass_shrinkwrap_machdep(fn))
+		return;
+	cfa_buildcfg(fn);
+	if ((insn = TAILQ_LAST(&fn->if_iq, ir_insnq)) == NULL ||
+	    insn->i_op != IR_RET)
+		return;
+	cfa_calcdom(fn);
+	cfa = fn->if_cfadata;
+	first = SIMPLEQ_FIRST(&cfa->c_entry->cb_succs)->cb_bb;
+
+	d = NULL;
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (!needframe(insn))
+			continue;
+		bb = insn->ii_bb;
+		d = d == NULL ? bb : commondom(d, bb);
+		if (d == first)
+			return;
+	}
+
+	if (d == NULL) {
+		TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+			if (insn->i_op == IR_RET)
+				insn->i_flags |= IR_RET_NOFRAME;
+		}
+		fn->if_flags |= IR_FUNC_NOFRAME;
+		return;
+	}
+
+	seen = xcalloc(cfa->c_nbb, sizeof *seen);
+	if (reach(d, d, seen)) {
+		free(seen);
+		return;
+	}
+	seen[d->cb_id] = 1;
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (insn->i_op != IR_RET || dominates(d, insn->ii_bb))
+			continue;
+		if (seen[insn->ii_bb->cb_id]) {
+			free(seen);
+			return;
+		}
+	}
+	free(seen);
+
+	TAILQ_FOREACH(insn, &fn->if_iq, ii_link) {
+		if (insn->i_op == IR_RET && !dominates(d, insn->ii_bb))
+			insn->i_flags |= IR_RET_NOFRAME;
+	}
+	if (d->cb_first->i_op == IR_LBL)
+		fn->if_prologue = d->cb_first;
+	else {
+		lbl = ir_lbl();
+		cfa_bb_prepend_insn(d->cb_first, lbl);
+		fn->if_prologue = lbl;
+	}
+}
@@ -29,6 +29,12 @@ struct passinfo {
 };
 
 void pass_deadfuncelim(struct passinfo *);
+void pass_deadfuncelim_func(struct ir_func *);
+void pass_deadfuncelim_inits(void);
+
+void pass_callorder(struct passinfo *);
+
+void pass_chordal(struct passinfo *);
 
 void pass_jmpopt(struct passinfo *);
 
@@ -55,6 +61,9 @@ ssize_t pass_stackoff_par(struct ir_func *, ssize_t, int);
 
 void pass_deadcodeelim(struct passinfo *);
 
+void pass_shrinkwrap(struct passinfo *);
+int pass_shrinkwrap_machdep(struct ir_func *);
+
 void pass_gencode(struct passinfo *);
 
 void pass_ssa(struct passinfo *);
@@ -66,11 +75,16 @@ void pass_deadvarelim(struct passinfo *);
 
 void pass_constfold(struct passinfo *);
 
+void pass_forwsubst(struct passinfo *);
+
+void pass_share(struct passinfo *);
+
 void pass_ralloc(struct passinfo *);
 void pass_ralloc_precolor(struct ir_symbol *, int);
 void pass_ralloc_addedge(struct ir_func *, size_t, size_t);
 void pass_ralloc_callargs(struct ir_func *, struct ir_insn *);
 int pass_ralloc_retreg(struct ir_type *);
+void pass_ralloc_clobbers(struct ir_func *, struct regset *);
 
 void pass_emit_header(struct passinfo *);
 void pass_emit_func(struct passinfo *);
@@ -33,7 +33,7 @@ tyspecalloc(int op)
 {
 	struct ast_tyspec *ts;
 
-	ts = mem_alloc(&frontmem, sizeof *ts);
+	ts = mem_alloc(astmem, sizeof *ts);
 	SPCPY(&ts->at_sp, &cursp);
 	ts->at_tdname = NULL;
 	ts->at_sou = NULL;
@@ -88,7 +88,7 @@ ast_souspec(char *ident, int haselms)
 {
 	struct ast_souspec *sou;
 
-	sou = mem_alloc(&frontmem, sizeof *sou);
+	sou = mem_alloc(astmem, sizeof *sou);
 	SIMPLEQ_INIT(&sou->as_ents);
 	SPCPY(&sou->as_sp, &cursp);
 	sou->as_name = ident;
@@ -105,7 +105,7 @@ ast_souent(struct ast_declspecs *ds, struct ast_decla *decla,
 {
 	struct ast_souent *ent;
 
-	ent = mem_alloc(&frontmem, sizeof *ent);
+	ent = mem_alloc(astmem, sizeof *ent);
 	ent->as_ds = ds;
 	ent->as_decla = decla;
 	ent->as_fieldexpr = x;
@@ -125,7 +125,7 @@ ast_enumspec(char *ident, int haselms)
 {
 	struct ast_enumspec *enu;
 
-	enu = mem_alloc(&frontmem, sizeof *enu);
+	enu = mem_alloc(astmem, sizeof *enu);
 	SIMPLEQ_INIT(&enu->aen_ents);
 	SPCPY(&enu->aen_sp, &cursp);
 	enu->aen_ident = ident;
@@ -146,7 +146,7 @@ ast_enument(struct srcpos *sp, char *ident, struct ast_expr *x)
 {
 	struct ast_enument *ent;
 
-	ent = mem_alloc(&frontmem, sizeof *ent);
+	ent = mem_alloc(astmem, sizeof *ent);
 	SPCPY(&ent->aen_sp, sp);
 	ent->aen_ident = ident;
 	ent->aen_expr = x;
@@ -158,7 +158,7 @@ ast_declspecs(void)
 {
 	struct ast_declspecs *ds;
 
-	ds = mem_alloc(&frontmem, sizeof *ds);
+	ds = mem_alloc(astmem, sizeof *ds);
 	SIMPLEQ_INIT(&ds->ad_tyspec);
 	SPCPY(&ds->ad_sp, &cursp);
 	ds->ad_sclass = ds->ad_tyqual = ds->ad_fnspec = 0;
@@ -199,7 +199,7 @@ declaalloc(int op, struct srcpos *sp)
 {
 	struct ast_decla *decla;
 
-	decla = mem_alloc(&frontmem, sizeof *decla);
+	decla = mem_alloc(astmem, sizeof *decla);
 	SPCPY(&decla->ad_sp, sp);
 	decla->ad_decla = NULL;
 	decla->ad_ident = NULL;
@@ -267,7 +267,7 @@ ast_designation(void)
 {
 	struct ast_designation *designation;
 
-	designation = mem_alloc(&frontmem, sizeof *designation);
+	designation = mem_alloc(astmem, sizeof *designation);
 	SIMPLEQ_INIT(designation);
 	return designation;
 }
@@ -286,7 +286,7 @@ designatoralloc(int op, struct ast_expr *x, char *ident, struct srcpos *sp)
 {
 	struct ast_designator *d;
 
-	d = mem_alloc(&frontmem, sizeof *d);
+	d = mem_alloc(astmem, sizeof *d);
 	SPCPY(&d->ad_sp, sp);
 	d->ad_ident = ident;
 	d->ad_expr = x;
@@ -311,7 +311,7 @@ initalloc(int op, struct ast_expr *x, struct srcpos *sp, size_t elems)
 {
 	struct ast_init *init;
 
-	init = mem_alloc(&frontmem, sizeof *init);
+	init = mem_alloc(astmem, sizeof *init);
 	SIMPLEQ_INIT(&init->ai_inits);
 	SPCPY(&init->ai_sp, sp);
 	init->ai_desig = NULL;
@@ -370,7 +370,7 @@ ast_decl(struct ast_declspecs *ds)
 {
 	struct ast_decl *decl;
 
-	decl = mem_alloc(&frontmem, sizeof *decl);
+	decl = mem_alloc(astmem, sizeof *decl);
 	SIMPLEQ_INIT(&decl->ad_declas);
 	SPCPY(&decl->ad_sp, &cursp);
 	decl->ad_ds = ds;
@@ -406,7 +406,7 @@ ast_list(int op)
 {
 	struct ast_list *list;
 
-	list = mem_alloc(&frontmem, sizeof *list);
+	list = mem_alloc(astmem, sizeof *list);
 	declheadinit(&list->al_decls);
 	TAILQ_INIT(&list->al_exprs);
 	SPCPY(&list->al_sp, &cursp);
@@ -440,7 +440,7 @@ stmtalloc(int op, struct srcpos *sp)
 {
 	struct ast_stmt *s;
 
-	s = mem_alloc(&frontmem, sizeof *s);
+	s = mem_alloc(astmem, sizeof *s);
 	SIMPLEQ_INIT(&s->as_stmts);
 	SIMPLEQ_INIT(&s->as_cases);
 	SPCPY(&s->as_sp, sp);
@@ -637,7 +637,7 @@ ast_case(struct ast_stmt *swtch, struct ast_stmt *castmt, struct ast_expr *x)
 		}
 	}
 
-	cas = mem_alloc(&frontmem, sizeof *cas);
+	cas = mem_alloc(astmem, sizeof *cas);
 	cas->ac_con = con;
 	cas->ac_stmt = castmt;
 	SIMPLEQ_INSERT_TAIL(&swtch->as_cases, cas, ac_link);
@@ -648,7 +648,7 @@ expralloc(int op, struct srcpos *sp)
 {
 	struct ast_expr *x;
 
-	x = mem_alloc(&frontmem, sizeof *x);
+	x = mem_alloc(astmem, sizeof *x);
 	SPCPY(&x->ae_sp, sp);
 	x->ae_l = x->ae_m = x ->ae_r = NULL;
 	x->ae_type = NULL;
@@ -718,23 +718,14 @@ ast_expr_strlit(void)
 }
 
 void
-ast_expr_strlit_append(struct ast_expr *x, char *strlit)
-{
-	char *buf;
-	size_t newlen;
-
-	/*
-	 * Note that strlen() will count the terminating ", so
-	 * we don't need to add + 1, since we won't save the ".
-	 */
-	newlen = strlen(&strlit[1]) + x->ae_strlen;
-	buf = xrealloc(x->ae_str, newlen);
-	if (x->ae_str == NULL)
-		*buf = '\0';
-	x->ae_str = buf;
-	strlcat(x->ae_str, &strlit[1], newlen);
-	x->ae_str[newlen - 1] = 0;
-	x->ae_strlen = newlen - 1;
+ast_expr_strlit_append(struct ast_expr *x, char *strlit, size_t len)
+{
+	/* Skip the quotes. */
+	len -= 2;
+	x->ae_str = xrealloc(x->ae_str, x->ae_strlen + len + 1);
+	memcpy(&x->ae_str[x->ae_strlen], &strlit[1], len);
+	x->ae_strlen += len;
+	x->ae_str[x->ae_strlen] = '\0';
 }
 
 void
@@ -69,6 +69,8 @@ static struct ir_symbol *indcall_gencode(struct ir_func *, struct ir_insnq *,
     struct ast_expr *);
 static struct ir_expr *builtin_gencode(struct ir_func *, struct ir_insnq *,
     struct ast_expr *, int);
+static struct ir_expr *load_gencode(struct ir_expr *, struct ir_type *, int);
+static int regneed(struct ast_expr *, int *);
 static struct ir_expr *call_gencode(struct ir_func *, struct ir_insnq *,
     struct ast_expr *, int);
 static struct ir_expr *souref_gencode(struct ir_func *, struct ir_insnq *,
@@ -102,6 +104,8 @@ static struct ir_expr *asg_gencode(struct ir_func *, struct ir_insnq *,
 static struct ir_expr *comma_gencode(struct ir_func *, struct ir_insnq *,
     struct ast_expr *, int);
 
+static int streaming;
+
 /* XXX */
 static struct ir_symbol *souretparm;
 static struct ir_symbol *souretvar;
@@ -117,6 +121,18 @@ ast_gencode(void)
 		decl_gencode(NULL, NULL, decl);
 }
 
+/*
+ * Generate code for one external declaration right after it has been
+ * checked. Whether a static function will be used is not known yet, so
+ * all functions are generated and the back end drops the unused ones.
+ */
+void
+ast_gencode_decl(struct ast_decl *decl)
+{
+	streaming = 1;
+	decl_gencode(NULL, NULL, decl);
+}
+
 static void
 chaininit(struct ast_init *init, struct initq *initq)
 {
@@ -269,6 +285,25 @@ uniquename(char *p)
 	return rv;
 }
 
+/*
+ * Function declarations get their IR symbol right away, the
+ * definition uses it later.
+ */
+void
+ast_gencode_funsym(struct symbol *sym)
+{
+	struct ir_type *ty;
+
+	ty = ir_type_dequal(sym->s_type);
+	ty = ir_type_dequal(ty->it_base);
+
+	/* XXX: Fix when struct assignments are fixed */
+	if (IR_ISSOU(ty))
+		ty = &ir_void;
+
+	sym->s_irsym = ir_symbol(IR_FUNSYM, sym->s_ident, 0, 0, ty);
+}
+
 static void
 decl_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_decl *decl)
 {
@@ -287,20 +322,20 @@ decl_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_decl *decl)
 		sym = decla->ad_sym;
 		if (IR_ISFUNTY(sym->s_type) &&
 		    !(sym->s_type->it_flags & IR_FUNDEF)) {
-			ty = ir_type_dequal(sym->s_type);
-			ty = ir_type_dequal(ty->it_base);
-
-			/* XXX: Fix when struct assignments are fixed */
-			if (IR_ISSOU(ty))
-				ty = &ir_void;
-
-			sym->s_irsym = ir_symbol(IR_FUNSYM, sym->s_ident,
-			    0, 0, ty);
+			ast_gencode_funsym(sym);
 			continue;
 		}
 		ty = ir_type_dequal(sym->s_type);
 		if (!(sym->s_flags & (SYM_DEF | SYM_TENTDEF)))
 			continue;
+
+		/*
+		 * Emitted by an earlier declaration of the same object, or
+		 * by the one with the initializer.
+		 */
+		if (sym->s_scope == 0 && decla->ad_init == NULL &&
+		    (sym->s_irsym != NULL || sym->s_flags & SYM_INIT))
+			continue;
 		if (sym->s_sclass == AST_SC_STATIC && sym->s_scope > 0) {
 			p = uniquename(sym->s_ident);
 			irsym = ir_symbol(IR_VARSYM, p, ty->it_size,
@@ -351,7 +386,8 @@ func_gencode(struct ast_decl *decl)
 	}
 	if (decla == NULL || decla->ad_op != AST_FNDECLA)
 		fatalx("func_gencode");
-	if (sym->s_sclass == AST_SC_STATIC && !(sym->s_flags & SYM_USED))
+	if (sym->s_sclass == AST_SC_STATIC && !(sym->s_flags & SYM_USED) &&
+	    !streaming)
 		return;
 
 	/* XXX: Fix when struct assignments are fixed */
@@ -548,11 +584,45 @@ switch_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_stmt *stmt)
 	ir_insnq_enq(iq, brklbl);
 }
 
+/* Returns 1 if x is a comparison or a logical operator. */
+static int
+istruthval(struct ast_expr *x)
+{
+	switch (x->ae_op) {
+	case AST_LT:
+	case AST_GT:
+	case AST_LE:
+	case AST_GE:
+	case AST_EQ:
+	case AST_NE:
+	case AST_ANDAND:
+	case AST_OROR:
+	case AST_NOT:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static void
+ret_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ir_expr *x)
+{
+	struct ir_expr *reg;
+
+	x = ir_cast(x, fn->if_sym->is_type);
+	reg = ir_newvreg(fn, x->ie_type);
+	ir_insnq_enq(iq, ir_asg(reg, x));
+	reg = ir_virtreg(reg->ie_sym);
+	ir_insnq_enq(iq, ir_ret(reg, 0));
+}
+
 static void
 stmt_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_stmt *stmt)
 {
-	struct ir_expr *reg, *x;
-	struct ir_insn *insn;
+	union ir_con con;
+	struct ir_expr *x;
+	struct ir_insn *f, *insn, *t;
+	struct ir_type *rty;
 
 	struct ir_insn *obrk, *ocnt, *odflt;
 
@@ -617,12 +687,26 @@ stmt_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_stmt *stmt)
 			ir_insnq_enq(iq, ir_ret(NULL, 0));
 			break;
 		}
+
+		/*
+		 * Return 1 and 0 from where the truth value is known. An
+		 * integer constant can only be moved into an integer register.
+		 */
+		rty = fn->if_sym->is_type;
+		if (istruthval(stmt->as_exprs[0]) &&
+		    (tyisinteger(rty) || IR_ISPTR(rty))) {
+			t = f = NULL;
+			jump_gencode(fn, iq, &t, &f, stmt->as_exprs[0], 0);
+			ir_insnq_enq(iq, t);
+			con.ic_icon = 1;
+			ret_gencode(fn, iq, ir_con(IR_ICON, con, &cir_int));
+			ir_insnq_enq(iq, f);
+			con.ic_icon = 0;
+			ret_gencode(fn, iq, ir_con(IR_ICON, con, &cir_int));
+			break;
+		}
 		x = ast_expr_gencode(fn, iq, stmt->as_exprs[0], 0);
-		x = ir_cast(x, fn->if_sym->is_type);
-		reg = ir_newvreg(fn, x->ie_type);
-		ir_insnq_enq(iq, ir_asg(reg, x));
-		reg = ir_virtreg(reg->ie_sym);
-		ir_insnq_enq(iq, ir_ret(reg, 0));
+		ret_gencode(fn, iq, x);
 		break;
 	case AST_DECLSTMT:
 		decl_gencode(fn, iq, stmt->as_decl);
@@ -659,6 +743,26 @@ jump_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ir_insn **tp,
 	case AST_NOT:
 		jump_gencode(fn, iq, fp, tp, x->ae_l, flags);
 		return;
+	case AST_ICON:
+	case AST_FCON:
+		if ((t = *tp) == NULL)
+			t = ir_lbl();
+		if ((f = *fp) == NULL)
+			f = ir_lbl();
+		if (x->ae_op == AST_ICON ? x->ae_con.ic_icon != 0 :
+		    x->ae_con.ic_fcon != 0)
+			ir_insnq_enq(iq, ir_b(t));
+		else
+			ir_insnq_enq(iq, ir_b(f));
+		*tp = t;
+		*fp = f;
+		return;
+	case AST_COMMA:
+		if (!CANSKIP(flags, x->ae_l))
+			ast_expr_gencode(fn, iq, x->ae_l,
+			    flags | GC_FLG_DISCARD);
+		jump_gencode(fn, iq, tp, fp, x->ae_r, flags);
+		return;
 	case AST_LT:
 		op = IR_BLT;
 		break;
@@ -672,10 +776,17 @@ jump_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ir_insn **tp,
 		op = IR_BGE;
 		break;
 	case AST_EQ:
-		op = IR_BEQ;
-		break;
 	case AST_NE:
-		op = IR_BNE;
+		/* Branch on a truth value compared with 0 directly. */
+		if (istruthval(x->ae_l) && x->ae_r->ae_op == AST_ICON &&
+		    x->ae_r->ae_con.ic_icon == 0) {
+			if (x->ae_op == AST_EQ)
+				jump_gencode(fn, iq, fp, tp, x->ae_l, flags);
+			else
+				jump_gencode(fn, iq, tp, fp, x->ae_l, flags);
+			return;
+		}
+		op = x->ae_op == AST_EQ ? IR_BEQ : IR_BNE;
 		break;
 	case AST_ANDAND:
 	case AST_OROR:
@@ -699,6 +810,22 @@ jump_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ir_insn **tp,
 		}
 		jump_gencode(fn, iq, tp, fp, x->ae_r, flags);
 		return;
+	case AST_COND:
+		/*
+		 * Branch on the chosen operand instead of its value. Code
+		 * that is only evaluated for side effects needs the value
+		 * form, which joins both arms.
+		 */
+		if (!(flags & GC_FLG_DISCARD)) {
+			tmpf = tmpt = NULL;
+			jump_gencode(fn, iq, &tmpt, &tmpf, x->ae_l, flags);
+			ir_insnq_enq(iq, tmpt);
+			jump_gencode(fn, iq, tp, fp, x->ae_m, flags);
+			ir_insnq_enq(iq, tmpf);
+			jump_gencode(fn, iq, tp, fp, x->ae_r, flags);
+			return;
+		}
+		/* FALLTHROUGH */
 	default:
 		if ((l = ast_expr_gencode(fn, iq, x, flags)) == NULL) {
 			if (*tp == NULL)
@@ -820,7 +947,7 @@ subscr_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_expr *x,
 			iridx = ir_bin(IR_ADD, iridx, oiridx, &cir_uintptr_t);
 
 		oiridx = iridx;
-	} while (x->ae_op == AST_SUBSCR);
+	} while (x->ae_op == AST_SUBSCR && IR_ISARR(x->ae_type));
 
 	if (CANSKIP(flags, x))
 		return NULL;
@@ -835,10 +962,26 @@ subscr_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_expr *x,
 	irx = ir_bin(IR_ADD, irbase, iridx, &ir_ptr);
 	if (flags & GC_FLG_ADDR)
 		return irx;
-	irx = ir_load(irx, ir_type_dequal(oldx->ae_type));
+	irx = load_gencode(irx, ir_type_dequal(oldx->ae_type),
+	    IR_ISVOLAT(oldx->ae_type));
 	return irx;
 }
 
+/*
+ * Loads of volatile objects are marked so that no pass merges or moves
+ * them.
+ */
+static struct ir_expr *
+load_gencode(struct ir_expr *addr, struct ir_type *ty, int volat)
+{
+	struct ir_expr *load;
+
+	load = ir_load(addr, ty);
+	if (volat)
+		load->i_flags |= IR_LOAD_VOLAT;
+	return load;
+}
+
 static struct ir_symbol *
 indcall_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_expr *x)
 {
@@ -868,11 +1011,79 @@ builtin_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_expr *x,
 	fatalx("builtin_gencode");
 }
 
+/*
+ * Returns the number of registers needed to evaluate x without spilling,
+ * Sethi-Ullman style. A call needs a register for each of its arguments.
+ * Sets *calls if x contains a call.
+ */
+static int
+regneed(struct ast_expr *x, int *calls)
+{
+	int l, r, m;
+	struct ast_expr *arg;
+
+	switch (x->ae_op) {
+	case AST_CALL:
+		*calls = 1;
+		l = regneed(x->ae_l, calls);
+		m = 0;
+		TAILQ_FOREACH(arg, &x->ae_args->al_exprs, ae_link) {
+			if ((r = regneed(arg, calls)) > l)
+				l = r;
+			m++;
+		}
+		return l > m ? l : m;
+	case AST_COND:
+		l = regneed(x->ae_l, calls);
+		m = regneed(x->ae_m, calls);
+		r = regneed(x->ae_r, calls);
+		if (m > l)
+			l = m;
+		return r > l ? r : l;
+	case AST_SOUDIR:
+	case AST_SOUIND:
+	case AST_POSTINC:
+	case AST_POSTDEC:
+	case AST_PREINC:
+	case AST_PREDEC:
+	case AST_ADDROF:
+	case AST_DEREF:
+	case AST_UPLUS:
+	case AST_UMINUS:
+	case AST_BITFLIP:
+	case AST_NOT:
+	case AST_CAST:
+		return regneed(x->ae_l, calls);
+	case AST_SUBSCR:
+		break;
+	default:
+		if (x->ae_op < AST_MUL || x->ae_op > AST_COMMA)
+			return 1;
+	}
+	l = regneed(x->ae_l, calls);
+	r = regneed(x->ae_r, calls);
+	if (l == r)
+		return l + 1;
+	return l > r ? l : r;
+}
+
+struct callarg {
+	struct	ast_expr *ca_x;
+	struct	ir_expr *ca_reg;
+	int	ca_need;
+	int	ca_conv;
+};
+
+/*
+ * Arguments that contain calls are evaluated first, those that need the
+ * most registers before the others. The remaining arguments are evaluated
+ * directly before the call, so that fewer values must be kept across calls.
+ */
 static struct ir_expr *
 call_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_expr *x,
     int flags)
 {
-	int argno, ellipsis;
+	int argno, ellipsis, calls, i, j, nargs;
 	struct ast_expr *arg;
 	struct ir_expr *reg, *tmp;
 	struct ir_exprq argq;
@@ -881,6 +1092,7 @@ call_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_expr *x,
 	struct ir_type *fnty, *ty;
 	struct ir_typelm *elm;
 	struct symbol *csym;
+	struct callarg *args, **order, *ca;
 
 	static char *setjmpstr;
 
@@ -900,13 +1112,44 @@ call_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_expr *x,
 	if (!IR_ISFUNTY(fnty))
 		fatalx("call_gencode: not a function type");
 
-	ir_exprq_init(&argq);
+	nargs = 0;
+	TAILQ_FOREACH(arg, &x->ae_args->al_exprs, ae_link)
+		nargs++;
+	args = NULL;
+	order = NULL;
+	if (nargs > 0) {
+		args = xmnalloc(nargs, sizeof *args);
+		order = xmnalloc(nargs, sizeof *order);
+	}
+
 	elm = SIMPLEQ_FIRST(&fnty->it_typeq);
 	argno = ellipsis = 0;
+	i = 0;
 	TAILQ_FOREACH(arg, &x->ae_args->al_exprs, ae_link) {
-		tmp = ast_expr_gencode(fn, iq, arg, 0);
-		if ((fnty->it_flags & IR_KRFUNC) || ellipsis) {
-			ty = ir_type_dequal(arg->ae_type);
+		ca = &args[i];
+		ca->ca_x = arg;
+		ca->ca_conv = (fnty->it_flags & IR_KRFUNC) || ellipsis;
+		calls = 0;
+		ca->ca_need = regneed(arg, &calls);
+		if (!calls)
+			ca->ca_need = 0;
+		for (j = i; j > 0 && order[j - 1]->ca_need < ca->ca_need; j--)
+			order[j] = order[j - 1];
+		order[j] = ca;
+		i++;
+		if (elm != NULL) {
+			elm = SIMPLEQ_NEXT(elm, it_link);
+			argno++;
+		}
+		if ((fnty->it_flags & IR_ELLIPSIS) && !ellipsis)
+			ellipsis = 1;
+	}
+
+	for (i = 0; i < nargs; i++) {
+		ca = order[i];
+		tmp = ast_expr_gencode(fn, iq, ca->ca_x, 0);
+		if (ca->ca_conv) {
+			ty = ir_type_dequal(ca->ca_x->ae_type);
 			tmp = ir_cast(tmp, tyargconv(ty));
 		}
 		if (IR_ISARR(tmp->ie_type) || IR_ISFUNTY(tmp->ie_type))
@@ -914,15 +1157,14 @@ call_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_expr *x,
 		else
 			reg = ir_newvreg(fn, tmp->ie_type);
 		ir_insnq_enq(iq, ir_asg(reg, tmp));
-		reg = ir_virtreg(reg->ie_sym);
-		ir_exprq_enq(&argq, reg);
-		if (elm != NULL) {
-			elm = SIMPLEQ_NEXT(elm, it_link);
-			argno++;
-		}
-		if ((fnty->it_flags & IR_ELLIPSIS) && !ellipsis)
-			ellipsis = 1;
+		ca->ca_reg = ir_virtreg(reg->ie_sym);
 	}
+
+	ir_exprq_init(&argq);
+	for (i = 0; i < nargs; i++)
+		ir_exprq_enq(&argq, args[i].ca_reg);
+	free(args);
+	free(order);
 	if (IR_ISFUNTY(x->ae_l->ae_type)) {
 		if (x->ae_l->ae_op != AST_IDENT)
 			sym = indcall_gencode(fn, iq, x->ae_l);
@@ -978,7 +1220,8 @@ souref_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_expr *x,
 	irx = ir_souref(irx, ty, elm);
 	if ((flags & GC_FLG_ADDR) || IR_ISARR(elm->it_type))
 		return irx;
-	irx = ir_load(irx, elm->it_type);
+	irx = load_gencode(irx, elm->it_type,
+	    IR_ISVOLAT(elm->it_type) || IR_ISVOLAT(x->ae_type));
 	return ir_cast(irx, ir_type_dequal(x->ae_type));
 }
 
@@ -1004,7 +1247,7 @@ incdec_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_expr *x,
 		ir_insnq_enq(iq, ir_asg(dst, tmp));
 		dst = ir_virtreg(dst->ie_sym);
 		ty = ir_type_dequal(x->ae_l->ae_type);
-		val = ir_load(dst, ty);
+		val = load_gencode(dst, ty, IR_ISVOLAT(x->ae_l->ae_type));
 		dst = ir_virtreg(dst->ie_sym);
 	}
 
@@ -1069,7 +1312,7 @@ deref_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_expr *x,
 		return irx;
 	if (flags & GC_FLG_ADDR)
 		return irx;
-	return ir_load(irx, ty);
+	return load_gencode(irx, ty, IR_ISVOLAT(x->ae_type));
 }
 
 static struct ir_expr *
@@ -1155,7 +1398,8 @@ bin_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_expr *x,
 			tmp = ir_newvreg(fn, dst->ie_type);
 			ir_insnq_enq(iq, ir_asg(tmp, dst));
 			dst = ir_virtreg(tmp->ie_sym);
-			l = ir_load(dst, ir_type_dequal(x->ae_l->ae_type));
+			l = load_gencode(dst, ir_type_dequal(x->ae_l->ae_type),
+			    IR_ISVOLAT(x->ae_l->ae_type));
 			dst = ir_virtreg(tmp->ie_sym);
 		}
 	}
@@ -1577,6 +1821,7 @@ ast_expr_gencode(struct ir_func *fn, struct ir_insnq *iq, struct ast_expr *x,
 	case AST_RS:
 		return shift_gencode(fn, iq, x, NULL, flags);
 	case AST_BWAND:
+	case AST_BWXOR:
 	case AST_BWOR:
 		return bw_gencode(fn, iq, x, NULL, flags);
 	case AST_LT:
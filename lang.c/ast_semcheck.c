@@ -152,7 +152,7 @@ static struct ir_type *typematrix[TS_MAX - 1][2] = {
 };
 
 static struct symbol *lastpar;
-static struct ir_type cir_enum;
+struct ir_type cir_enum;
 static struct ir_type cir_id;
 static int ininline;
 
@@ -432,8 +432,12 @@ decglobl(struct ast_decl *decl, char *ident, struct ir_type *type)
 		errp(&decl->ad_sp, "invalid redeclaration of `%s'", ident);
 		return sym;
 	}
+	if (decl->ad_ds->ad_sclass == 0 && !IR_ISFUNTY(type) &&
+	    !(sym->s_flags & SYM_DEF))
+		sym->s_flags |= SYM_TENTDEF;
 
-	if (IR_ISARR(sym->s_type) && !IR_ISCOMPLETE(sym->s_type)) {
+	if (IR_ISARR(sym->s_type) && !IR_ISCOMPLETE(sym->s_type) &&
+	    IR_ISCOMPLETE(type)) {
 		if (IR_ISQUAL(sym->s_type))
 			fatalx("decglobl: qualified array");
 		ir_type_setflags(sym->s_type, IR_COMPLETE);
@@ -472,17 +476,22 @@ declocal(struct ast_decl *decl, char *ident, struct ir_type *type, int hasinit)
 	}
 
 	if ((sym = symlookup(ident, NSORD)) != NULL) {
-		if (sym->s_scope == 1)
-			warnp(&decl->ad_sp, "declaration of `%s' shadows a "
-			    "parameter", ident);
-		else if (sym->s_scope == 0 && sclass == AST_SC_EXTERN) {
+		if (sym->s_scope == 0 && sclass == AST_SC_EXTERN) {
 			if (!tyiscompat(sym->s_type, type))
 				errp(&decl->ad_sp, "incompatible redeclaration "
 				    "of `%s'", ident);
 			return sym;
 		}
-		errp(&decl->ad_sp, "redeclaration of `%s'", ident);
-		return sym;
+
+		/* Parameters share the scope of the outermost block. */
+		if (sym->s_scope == curscope ||
+		    (sym->s_scope == 1 && curscope == 2)) {
+			errp(&decl->ad_sp, "redeclaration of `%s'", ident);
+			return sym;
+		}
+		if (sym->s_scope == 1)
+			warnp(&decl->ad_sp, "declaration of `%s' shadows a "
+			    "parameter", ident);
 	}
 
 	sym = symenter(ident, type, NSORD);
@@ -502,6 +511,12 @@ ast_semcheck(void)
 		decl_semcheck(decl, 0);
 }
 
+void
+ast_semcheck_decl(struct ast_decl *decl)
+{
+	decl_semcheck(decl, 0);
+}
+
 static int
 funcdecl_semcheck(struct ast_decl *decl)
 {
@@ -596,6 +611,8 @@ decl_semcheck(struct ast_decl *decl, int flags)
 					    "of `%s'", decla->ad_sym->s_ident);
 				decla->ad_sym->s_flags |= SYM_DEF;
 				decla->ad_sym->s_flags &= ~SYM_TENTDEF;
+				if (decla->ad_init != NULL)
+					decla->ad_sym->s_flags |= SYM_INIT;
 			}
 		} else {
 			if (decla->ad_init != NULL &&
@@ -760,18 +777,22 @@ souspec_semcheck(struct ast_tyspec *ts, int *needdecla)
 			symenter(sou->as_name, souty, NSTAG);
 			return souty;
 		}
-		if (sym->s_scope == curscope) {
-			if (!IR_ISTYOP(sym->s_type, tyop)) {
-				errp(&sou->as_sp, "`%s' is not a %s",
-				    sou->as_name, what);
-				return &cir_int;
-			}
+		if (!IR_ISTYOP(sym->s_type, tyop)) {
+			errp(&sou->as_sp, "`%s' is not a %s", sou->as_name,
+			    what);
+			return &cir_int;
 		}
 		return sym->s_type;
 	}
 
-	if (sym != NULL) {
-		if (IR_ISCOMPLETE(sym->s_type) && sym->s_scope == curscope) {
+	/* A definition in an inner scope declares a new type. */
+	if (sym != NULL && sym->s_scope == curscope) {
+		if (!IR_ISTYOP(sym->s_type, tyop)) {
+			errp(&sou->as_sp, "`%s' is not a %s", sou->as_name,
+			    what);
+			return &cir_int;
+		}
+		if (IR_ISCOMPLETE(sym->s_type)) {
 			errp(&sou->as_sp, "%s `%s' redeclared", what,
 			    sou->as_name);
 			return &cir_int;
@@ -910,7 +931,7 @@ enumspec_semcheck(struct ast_tyspec *ts, int *needdecla)
 	}
 
 	if (enu->aen_ident != NULL)
-		symenter(enu->aen_ident, &cir_enum, NSORD);
+		symenter(enu->aen_ident, &cir_enum, NSTAG);
 	return &cir_int;
 }
 
@@ -29,6 +29,8 @@
 #include "lang.c/c.h"
 
 struct memarea frontmem;
+struct memarea *astmem = &frontmem;
+static struct memarea declmem;
 
 struct ir_type *builtin_va_list;
 struct symbol *builtin_va_start_sym;
@@ -36,41 +38,57 @@ struct symbol *builtin_va_arg_sym;
 struct symbol *builtin_va_end_sym;
 
 static int nerrors;
+static int nsynerrors;
 
 static void builtin_init(void);
 static void tokdump(void);
+static void stream(char *, char *);
 
 int
 main(int argc, char **argv)
 {
 	int ch;
-	int aflag = 0, gflag = 0, pflag = 0, sflag = 0, tflag = 0;
+	int aflag = 0, fflag = 0, gflag = 0, pflag = 0, sflag = 0, tflag = 0;
+	char *rfile = NULL, *wfile = NULL;
 
 	comp_init();
 
-	while ((ch = getopt(argc, argv, "agpst"COMPOPTS)) != -1) {
+	while ((ch = getopt(argc, argv, "afgpr:stw:"COMPOPTS)) != -1) {
 		switch (ch) {
 		case 'a':
 			aflag = 1;
 			break;
+		case 'f':
+			fflag = 1;
+			break;
 		case 'g':
 			gflag = 1;
 			break;
 		case 'p':
 			pflag = 1;
 			break;
+		case 'r':
+			rfile = optarg;
+			break;
 		case 's':
 			sflag = 1;
 			break;
 		case 't':
 			tflag = 1;
 			break;
+		case 'w':
+			wfile = optarg;
+			break;
 		default:
 			compopt(ch);
 		}
 	}
 	argc -= optind;
 	argv += optind;
+	if (fflag && (aflag || pflag || sflag))
+		errx(1, "-f cannot be used with -a, -p or -s");
+	if (!fflag && (rfile != NULL || wfile != NULL))
+		errx(1, "-r and -w need -f");
 
 	if (argc > 0) {
 		setinfile(argv[0]);
@@ -85,6 +103,11 @@ main(int argc, char **argv)
 		comp_exit(0);
 	}
 
+	if (fflag) {
+		stream(rfile, wfile);
+		comp_exit(nerrors != 0);
+	}
+
 	builtin_init();
 	symtabinit(0);
 	parse();
@@ -109,6 +132,55 @@ main(int argc, char **argv)
 	comp_exit(0);
 }
 
+/*
+ * Check, generate and compile one external declaration at a time and
+ * release its AST afterwards. Typedef names the parser entered for a
+ * declaration are replaced by the symbols of the semantic checker.
+ * After a syntax error, the parser keeps its own symbols.
+ *
+ * The file scope is loaded from the snapshot rfile if the input starts
+ * with its prefix, and saved to wfile at the end.
+ */
+static void
+stream(char *rfile, char *wfile)
+{
+	size_t mark;
+	struct ast_decl *decl;
+	struct ir_func *fn;
+
+	mem_area_init(&declmem);
+	astmem = &declmem;
+	builtin_init();
+	symtabinit(1);
+	irprog = ir_prog();
+	compile_start();
+	if (rfile != NULL)
+		snapload(rfile);
+
+	parse_start();
+	for (;;) {
+		mark = symmark();
+		if ((decl = parse_extdecl()) == NULL)
+			break;
+		if (nsynerrors == 0) {
+			symrelease(mark);
+			ast_semcheck_decl(decl);
+		}
+		if (nerrors == 0) {
+			ast_gencode_decl(decl);
+			while ((fn = SIMPLEQ_FIRST(&irprog->ip_funq)) != NULL) {
+				SIMPLEQ_REMOVE_HEAD(&irprog->ip_funq, if_link);
+				compile_stream(fn);
+			}
+		}
+		mem_area_free(&declmem);
+	}
+	if (nerrors == 0)
+		compile_finish();
+	if (nerrors == 0 && wfile != NULL)
+		snapsave(wfile);
+}
+
 static void
 builtin_init(void)
 {
@@ -238,6 +310,7 @@ synh(const char *fmt, ...)
 	msg("syntax error", fmt, ap, &cursp);
 	va_end(ap);
 	nerrors++;
+	nsynerrors++;
 }
 
 void
@@ -312,7 +385,6 @@ escapechar(char *p, char **ep)
 		if (*p < '0' || *p > '7')
 			fatalx("esccon: bad input: %d(%s)", *p, p);
 		ch = *p - '0';
-		q++;
 		for (i = 1; i <= 2; i++) {
 			if (p[i] < '0' || p[i] > '7')
 				break;
@@ -330,50 +402,39 @@ escapechar(char *p, char **ep)
 char *
 cstring(char *start, char *end, struct memarea *m, size_t *lenp)
 {
-	char nul;
-	char *p, *tmp;
-	int ch, esc;
-	size_t i;
-
-	if (start > end) {
-		nul = '\0';
-		i = 1;
-		tmp = &nul;
-	} else {
-		tmp = xmalloc(end - start + 2);
-		tmp[0] = '\0';
-		p = start;
-		i = esc = 0;
-		while (p <= end) {
-			if (esc == 0) {
-				if (*p != '\\')
-					tmp[i++] = *p;
-				else
-					esc = 1;
-				p++;
-				continue;
-			}
+	char *p, *str;
+	int esc;
+	size_t i, size;
 
-			ch = escapechar(p, &p);
-			tmp[i++] = ch;
-			esc = 0;
+	/* Escape sequences only shrink, so the result fits in size. */
+	size = start > end ? 1 : end - start + 2;
+	if (m == NULL)
+		str = xmalloc(size);
+	else
+		str = mem_alloc(m, size);
+
+	p = start;
+	i = esc = 0;
+	while (p <= end) {
+		if (esc == 0) {
+			if (*p != '\\')
+				str[i++] = *p;
+			else
+				esc = 1;
+			p++;
+			continue;
 		}
-		tmp[i++] = 0;
-		if (esc)
-			fatalx("cstring: still in escape mode: %s", start);
+
+		str[i++] = escapechar(p, &p);
+		esc = 0;
 	}
+	str[i++] = 0;
+	if (esc)
+		fatalx("cstring: still in escape mode: %s", start);
 
-	if (m == NULL)
-		p = xmalloc(i);
-	else
-		p = mem_alloc(m, i);
 	if (lenp != NULL)
 		*lenp = i;
-
-	memcpy(p, tmp, i);
-	if (tmp != &nul)
-		free(tmp);
-	return p;
+	return str;
 }
 
 int
@@ -414,10 +475,10 @@ tyiscompat(struct ir_type *lty, struct ir_type *rty)
 		return 1;
 	if (lty->it_op != rty->it_op)
 		return 0;
-	if (IR_ISUNION(lty) || IR_ISSTRUCT(lty))
-		fatalx("tyiscompat");	/* Should be handled by lty == rty. */
 	if (IR_ISQUAL(lty))
 		return tyiscompat(ir_type_dequal(lty), ir_type_dequal(rty));
+	if (IR_ISUNION(lty) || IR_ISSTRUCT(lty))
+		fatalx("tyiscompat");	/* Should be handled by lty == rty. */
 	if (IR_ISPTR(lty))
 		return tyiscompat(lty->it_base, rty->it_base);
 	if (IR_ISARR(lty)) {
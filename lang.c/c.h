@@ -131,6 +131,7 @@
 extern char *toknames[];
 
 extern struct memarea frontmem;
+extern struct memarea *astmem;
 
 void warnh(const char *, ...);
 void warnp(struct srcpos *, const char *, ...);
@@ -142,11 +143,21 @@ void fatalsynh(const char *, ...);
 void lexinit(char *);
 int peek(void);
 int yylex(void);
+char *lexprefix(size_t *);
+int lexskip(char *, size_t);
 void parse(void);
+void parse_start(void);
+struct ast_decl *parse_extdecl(void);
+
+/* A string literal with its quotes, pointing into the input. */
+struct tokspan {
+	char	*ts_ptr;
+	size_t	ts_len;
+};
 
 union token {
 	struct	ast_expr *t_expr;
-	char	*t_strlit;
+	struct	tokspan t_strlit;
 	char	*t_ident;
 };
 
@@ -168,6 +179,8 @@ extern struct symbol *builtin_va_start_sym;
 extern struct symbol *builtin_va_arg_sym;
 extern struct symbol *builtin_va_end_sym;
 
+extern struct ir_type cir_enum;
+
 #define AST_SC_AUTO	1
 #define AST_SC_EXTERN	2
 #define AST_SC_REGISTER	3
@@ -532,7 +545,7 @@ struct ast_expr *ast_expr_fcon(struct srcpos *, double, struct ir_type *);
 struct ast_expr *ast_expr_ident(char *);
 
 struct ast_expr *ast_expr_strlit(void);
-void ast_expr_strlit_append(struct ast_expr *, char *);
+void ast_expr_strlit_append(struct ast_expr *, char *, size_t);
 void ast_expr_strlit_finish(struct ast_expr *);
 
 struct ast_expr *ast_expr_subscr(struct srcpos *, struct ast_expr *,
@@ -564,6 +577,7 @@ struct ast_expr *ast_expr_comma(struct srcpos *, struct ast_expr *,
 
 void ast_pretty(char *);
 void ast_semcheck(void);
+void ast_semcheck_decl(struct ast_decl *);
 
 #define GC_FLG_DISCARD	1	/* Skip expressions without side effects. */
 #define GC_FLG_INIF	2
@@ -571,6 +585,8 @@ void ast_semcheck(void);
 #define GC_FLG_ASG	8
 
 void ast_gencode(void);
+void ast_gencode_decl(struct ast_decl *);
+void ast_gencode_funsym(struct symbol *);
 struct ir_expr *ast_expr_gencode(struct ir_func *, struct ir_insnq *,
     struct ast_expr *, int);
 
@@ -581,11 +597,10 @@ struct ir_expr *ast_expr_gencode(struct ir_func *, struct ir_insnq *,
 
 extern int curscope;
 
+/* Parameters of a function definition, see popsymtab. */
 struct symtab {
-	SLIST_HEAD(, symbol) s_syms[NSMAX];
-	struct	symtab *s_top;
-	struct	symbol *s_root[NSMAX];
-	int	s_scope;
+	SLIST_HEAD(, symbol) s_syms;
+	struct	symtab *s_next;
 };
 
 #define SYM_ENUM	1
@@ -594,18 +609,18 @@ struct symtab {
 #define SYM_USED	8
 #define SYM_BUILTIN	16
 #define SYM_TYPEDEF	32
+#define SYM_INIT	64
 
 struct symbol {
 	SLIST_ENTRY(symbol) s_link;
-	struct	symbol *s_left;
-	struct	symbol *s_right;
+	struct	symbol *s_shadow;
 	struct	srcpos s_lblpos;
 	struct	ir_symbol *s_irsym;
 	struct	ir_insn *s_irlbl;
 	struct	ir_type *s_type;
 	char	*s_ident;
-	char	*s_key;
 	int	s_scope;
+	int	s_ns;
 	int	s_sclass;
 	int	s_fnspec;
 	int	s_flags;
@@ -620,6 +635,12 @@ void pushsymtab(struct symtab *);
 struct symtab *popsymtab(void);
 struct symbol *symlookup(char *, int);
 struct symbol *symenter(char *, struct ir_type *, int);
+size_t symmark(void);
+struct symbol *symnth(size_t);
+void symrelease(size_t);
+
+int snapload(char *);
+void snapsave(char *);
 
 #define CIR_SCHAR	IR_I8
 #define CIR_UCHAR	IR_U8
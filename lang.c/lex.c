@@ -0,0 +1,949 @@
+/*
+ * Copyright (c) 2008 Stefan Kempf <sisnkemp@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Scanner for preprocessed C. The whole input is mapped (or read) into
+ * memory and followed by a '\0' that stops every lookahead. String
+ * literals are handed to the parser as spans of the input. Numbers are
+ * matched with the longest-match rules the old flex scanner had.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/queue.h>
+#include <sys/stat.h>
+
+#include <ctype.h>
+#include <err.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "comp/comp.h"
+#include "comp/ir.h"
+
+#include "lang.c/c.h"
+
+#define C_ALPHA		0x01	/* [a-zA-Z_] */
+#define C_DIGIT		0x02	/* [0-9] */
+#define C_HEX		0x04	/* [0-9a-fA-F] */
+#define C_OCT		0x08	/* [0-7] */
+#define C_BLANK		0x10	/* [\t\v ] */
+
+#define ISALPHA(c)	(cclass[(u_char)(c)] & C_ALPHA)
+#define ISDIGIT(c)	(cclass[(u_char)(c)] & C_DIGIT)
+#define ISHEX(c)	(cclass[(u_char)(c)] & C_HEX)
+#define ISOCT(c)	(cclass[(u_char)(c)] & C_OCT)
+#define ISIDENT(c)	(cclass[(u_char)(c)] & (C_ALPHA | C_DIGIT))
+#define ISBLANK(c)	(cclass[(u_char)(c)] & C_BLANK)
+
+/*
+ * Keywords are found by their name table hash. The table is perfect for
+ * the keywords below; kwinit() complains if a new keyword collides.
+ */
+#define KW_TABSIZE	256
+#define KW_HASH(h)	(((h) ^ ((h) >> 27)) & (KW_TABSIZE - 1))
+#define KW_SKIP		0	/* Accepted and ignored. */
+
+struct keyword {
+	const char	*k_name;
+	size_t		k_len;
+	int		k_tok;
+};
+
+static struct keyword keywords[] = {
+	{ "auto", 0, TOK_AUTO },
+	{ "break", 0, TOK_BREAK },
+	{ "case", 0, TOK_CASE },
+	{ "char", 0, TOK_CHAR },
+	{ "const", 0, TOK_CONST },
+	{ "__const", 0, TOK_CONST },
+	{ "continue", 0, TOK_CONTINUE },
+	{ "default", 0, TOK_DEFAULT },
+	{ "do", 0, TOK_DO },
+	{ "double", 0, TOK_DOUBLE },
+	{ "else", 0, TOK_ELSE },
+	{ "enum", 0, TOK_ENUM },
+	{ "extern", 0, TOK_EXTERN },
+	{ "float", 0, TOK_FLOAT },
+	{ "for", 0, TOK_FOR },
+	{ "goto", 0, TOK_GOTO },
+	{ "if", 0, TOK_IF },
+	{ "inline", 0, KW_SKIP },
+	{ "__inline", 0, KW_SKIP },
+	{ "__inline__", 0, KW_SKIP },
+	{ "int", 0, TOK_INT },
+	{ "long", 0, TOK_LONG },
+	{ "register", 0, TOK_REGISTER },
+	{ "restrict", 0, KW_SKIP },
+	{ "return", 0, TOK_RETURN },
+	{ "short", 0, TOK_SHORT },
+	{ "signed", 0, TOK_SIGNED },
+	{ "__signed", 0, TOK_SIGNED },
+	{ "sizeof", 0, TOK_SIZEOF },
+	{ "static", 0, TOK_STATIC },
+	{ "struct", 0, TOK_STRUCT },
+	{ "switch", 0, TOK_SWITCH },
+	{ "typedef", 0, TOK_TYPEDEF },
+	{ "union", 0, TOK_UNION },
+	{ "unsigned", 0, TOK_UNSIGNED },
+	{ "void", 0, TOK_VOID },
+	{ "volatile", 0, TOK_VOLATILE },
+	{ "__volatile", 0, TOK_VOLATILE },
+	{ "__volatile__", 0, TOK_VOLATILE },
+	{ "while", 0, TOK_WHILE },
+	{ "_Bool", 0, TOK_BOOL },
+	{ "__dead", 0, TOK_DEAD },
+	{ "__packed", 0, TOK_PACKED },
+	{ NULL, 0, 0 }
+};
+
+static u_char cclass[UCHAR_MAX + 1];
+static struct keyword *kwtab[KW_TABSIZE];
+
+static char *lexbuf;	/* Input, followed by '\0'. */
+static char *lexend;	/* Points to the '\0'. */
+static char *lexp;	/* Current position. */
+
+static char *numbuf;
+static size_t numbufsize;
+
+static struct srcpos nextsp;
+
+static void nl(void);
+static char *skipblanks(char *);
+static void badchar(char *);
+static void directive(char *);
+static void ppline(char *, char *);
+static char *scanlit(char *);
+static char *number(char *, int *);
+static void charcon(char *);
+static void intcon(int);
+static void floatcon(void);
+static void hexfloatcon(void);
+
+static void
+classinit(void)
+{
+	int c;
+
+	for (c = 'a'; c <= 'z'; c++)
+		cclass[c] |= C_ALPHA;
+	for (c = 'A'; c <= 'Z'; c++)
+		cclass[c] |= C_ALPHA;
+	cclass['_'] |= C_ALPHA;
+	for (c = '0'; c <= '9'; c++)
+		cclass[c] |= C_DIGIT | C_HEX;
+	for (c = '0'; c <= '7'; c++)
+		cclass[c] |= C_OCT;
+	for (c = 'a'; c <= 'f'; c++)
+		cclass[c] |= C_HEX;
+	for (c = 'A'; c <= 'F'; c++)
+		cclass[c] |= C_HEX;
+	cclass['\t'] |= C_BLANK;
+	cclass['\v'] |= C_BLANK;
+	cclass[' '] |= C_BLANK;
+}
+
+static void
+kwinit(void)
+{
+	struct keyword *kw;
+	u_int h;
+
+	for (kw = keywords; kw->k_name != NULL; kw++) {
+		kw->k_len = strlen(kw->k_name);
+		h = KW_HASH(nthash(kw->k_name, kw->k_len));
+		if (kwtab[h] != NULL)
+			fatalx("kwinit: %s and %s collide", kw->k_name,
+			    kwtab[h]->k_name);
+		kwtab[h] = kw;
+	}
+}
+
+static void
+readinput(char *path)
+{
+	size_t len, size;
+	ssize_t n;
+
+	len = 0;
+	size = 65536;
+	lexbuf = xmalloc(size);
+	for (;;) {
+		if (len == size - 1) {
+			size *= 2;
+			lexbuf = xrealloc(lexbuf, size);
+		}
+		n = read(STDIN_FILENO, &lexbuf[len], size - 1 - len);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			fatal("read %s", path);
+		}
+		if (n == 0)
+			break;
+		len += n;
+	}
+	lexbuf[len] = '\0';
+	lexend = &lexbuf[len];
+}
+
+void
+lexinit(char *path)
+{
+	struct stat st;
+	long pgsize;
+
+	cursp.s_file = nextsp.s_file = path;
+	cursp.s_line = nextsp.s_line = 1;
+	classinit();
+	kwinit();
+
+	/*
+	 * The rest of the last page of a mapping reads as zeroes, which
+	 * gives the '\0' after the input for free. If the file fills its
+	 * last page, it is read instead.
+	 */
+	pgsize = sysconf(_SC_PAGESIZE);
+	if (fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode) &&
+	    st.st_size > 0 && st.st_size % pgsize != 0) {
+		lexbuf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+		    STDIN_FILENO, 0);
+		if (lexbuf == MAP_FAILED)
+			fatal("mmap %s", path);
+		lexend = &lexbuf[st.st_size];
+	} else
+		readinput(path);
+	lexp = lexbuf;
+}
+
+/*
+ * Walk the lines from p on that hold code, until max bytes of them are
+ * seen. Blank lines and directives are left out, so the same headers
+ * give the same text whichever file included them. Each line counts
+ * with its newline. The text is copied to out unless it is NULL, and
+ * compared with cmp unless that is NULL, in which case the walk stops
+ * at the first line that differs. If skip is set, the lines are
+ * consumed as the lexer would.
+ */
+static char *
+codelines(char *p, size_t max, char *out, char *cmp, size_t *lenp, int skip)
+{
+	char *eol, *q;
+	size_t len = 0, n;
+
+	while (p < lexend && len < max) {
+		if ((eol = memchr(p, '\n', lexend - p)) == NULL)
+			eol = lexend;
+		q = skipblanks(p);
+		if (*q == '#') {
+			if (skip)
+				directive(q);
+		} else {
+			if (q != eol && *q != '\r') {
+				n = eol - p;
+				if (cmp != NULL && (n >= max - len ||
+				    memcmp(p, &cmp[len], n) != 0 ||
+				    cmp[len + n] != '\n'))
+					break;
+				if (out != NULL) {
+					memcpy(&out[len], p, n);
+					out[len + n] = '\n';
+				}
+				len += n + 1;
+			}
+			if (skip)
+				nl();
+		}
+		p = eol < lexend ? eol + 1 : lexend;
+	}
+	*lenp = len;
+	return p;
+}
+
+/*
+ * Return the code lines of the whole input for a snapshot.
+ */
+char *
+lexprefix(size_t *lenp)
+{
+	char *text;
+
+	codelines(lexbuf, SIZE_MAX, NULL, NULL, lenp, 0);
+	text = xmalloc(*lenp + 1);
+	codelines(lexbuf, SIZE_MAX, text, NULL, lenp, 0);
+	return text;
+}
+
+/*
+ * Skip the start of the input if its code lines are text, as returned
+ * by lexprefix. Returns 0 and leaves the input alone otherwise.
+ */
+int
+lexskip(char *text, size_t len)
+{
+	char *p, *op = lexp;
+	size_t l;
+	struct srcpos sp = cursp, nsp = nextsp;
+
+	p = codelines(lexp, len, NULL, text, &l, 1);
+	if (l == len) {
+		lexp = p;
+		return 1;
+	}
+	cursp = sp;
+	nextsp = nsp;
+	lexp = op;
+	return 0;
+}
+
+static void
+nl(void)
+{
+	cursp.s_line = ++nextsp.s_line;
+}
+
+static char *
+skipblanks(char *p)
+{
+#ifdef __SSE2__
+	__m128i v, sp, tab, vt;
+	u_int mask;
+
+	if (!ISBLANK(*p))
+		return p;
+	sp = _mm_set1_epi8(' ');
+	tab = _mm_set1_epi8('\t');
+	vt = _mm_set1_epi8('\v');
+	while (p + 16 <= lexend) {
+		v = _mm_loadu_si128((__m128i *)p);
+		mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(
+		    _mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+		    _mm_cmpeq_epi8(v, vt)));
+		if (mask != 0xffff)
+			return p + __builtin_ctz(~mask);
+		p += 16;
+	}
+#endif
+	while (ISBLANK(*p))
+		p++;
+	return p;
+}
+
+int
+yylex(void)
+{
+	struct keyword *kw;
+	char *p, *q, *start;
+	u_int h;
+	int c, tok;
+
+	for (;;) {
+		start = p = skipblanks(lexp);
+		if (p >= lexend) {
+			lexp = p;
+			return 0;
+		}
+
+		c = (u_char)*p;
+		if (ISALPHA(c)) {
+			/* L'x' and L"x" are treated like 'x' and "x". */
+			if (c == 'L' && (p[1] == '\'' || p[1] == '"') &&
+			    (q = scanlit(&p[1])) != NULL) {
+				lexp = q;
+				if (p[1] == '\'') {
+					charcon(&p[1]);
+					return TOK_ICON;
+				}
+				token.t_strlit.ts_ptr = &p[1];
+				token.t_strlit.ts_len = q - &p[1];
+				return TOK_STRLIT;
+			}
+			h = NTHASH_INIT;
+			do {
+				h = NTHASH_STEP(h, *p);
+				p++;
+			} while (ISIDENT(*p));
+			lexp = p;
+			kw = kwtab[KW_HASH(h)];
+			if (kw != NULL && kw->k_len == (size_t)(p - start) &&
+			    memcmp(kw->k_name, start, kw->k_len) == 0) {
+				if (kw->k_tok == KW_SKIP)
+					continue;
+				return kw->k_tok;
+			}
+			token.t_ident = ntenterh(&names, start, p - start, h);
+			return TOK_IDENT;
+		}
+		if (ISDIGIT(c) || (c == '.' && ISDIGIT(p[1]))) {
+			lexp = number(p, &tok);
+			return tok;
+		}
+
+		lexp = p + 1;
+		switch (c) {
+		case '\n':
+			nl();
+			continue;
+		case '#':
+			if (p != lexbuf && p[-1] != '\n')
+				break;
+			directive(p);
+			continue;
+		case '\'':
+			if ((q = scanlit(p)) == NULL)
+				break;
+			lexp = q;
+			charcon(p);
+			return TOK_ICON;
+		case '"':
+			if ((q = scanlit(p)) == NULL)
+				break;
+			lexp = q;
+			token.t_strlit.ts_ptr = p;
+			token.t_strlit.ts_len = q - p;
+			return TOK_STRLIT;
+		case '[':
+		case ']':
+		case '(':
+		case ')':
+		case '{':
+		case '}':
+		case '~':
+		case '?':
+		case ':':
+		case ';':
+		case ',':
+			return c;
+		case '.':
+			if (p[1] == '.' && p[2] == '.') {
+				lexp = p + 3;
+				return TOK_ELLIPSIS;
+			}
+			return '.';
+		case '-':
+			lexp = p + 2;
+			if (p[1] == '>')
+				return TOK_ARROW;
+			if (p[1] == '-')
+				return TOK_DEC;
+			if (p[1] == '=')
+				return TOK_SUBASG;
+			lexp = p + 1;
+			return '-';
+		case '+':
+			lexp = p + 2;
+			if (p[1] == '+')
+				return TOK_INC;
+			if (p[1] == '=')
+				return TOK_ADDASG;
+			lexp = p + 1;
+			return '+';
+		case '&':
+			lexp = p + 2;
+			if (p[1] == '&')
+				return TOK_ANDAND;
+			if (p[1] == '=')
+				return TOK_ANDASG;
+			lexp = p + 1;
+			return '&';
+		case '|':
+			lexp = p + 2;
+			if (p[1] == '|')
+				return TOK_OROR;
+			if (p[1] == '=')
+				return TOK_ORASG;
+			lexp = p + 1;
+			return '|';
+		case '<':
+			if (p[1] == '<') {
+				if (p[2] == '=') {
+					lexp = p + 3;
+					return TOK_LSASG;
+				}
+				lexp = p + 2;
+				return TOK_LS;
+			}
+			if (p[1] == '=') {
+				lexp = p + 2;
+				return TOK_LE;
+			}
+			return '<';
+		case '>':
+			if (p[1] == '>') {
+				if (p[2] == '=') {
+					lexp = p + 3;
+					return TOK_RSASG;
+				}
+				lexp = p + 2;
+				return TOK_RS;
+			}
+			if (p[1] == '=') {
+				lexp = p + 2;
+				return TOK_GE;
+			}
+			return '>';
+		case '*':
+		case '/':
+		case '%':
+		case '=':
+		case '!':
+		case '^':
+			if (p[1] != '=')
+				return c;
+			lexp = p + 2;
+			switch (c) {
+			case '*':
+				return TOK_MULASG;
+			case '/':
+				return TOK_DIVASG;
+			case '%':
+				return TOK_MODASG;
+			case '=':
+				return TOK_EQ;
+			case '!':
+				return TOK_NE;
+			default:
+				return TOK_XORASG;
+			}
+		}
+		badchar(p);
+	}
+}
+
+static void
+badchar(char *p)
+{
+	char buf[2];
+
+	buf[0] = *p;
+	buf[1] = '\0';
+	fatalsynh("unexpected character: %s", buf);
+}
+
+/*
+ * A line starting with '#'. Line markers (# 12 "file" or #line 12)
+ * are obeyed, everything else is ignored.
+ */
+static void
+directive(char *p)
+{
+	char *eol, *q;
+
+	if ((eol = memchr(p, '\n', lexend - p)) == NULL)
+		badchar(p);
+	lexp = eol + 1;
+
+	q = skipblanks(p + 1);
+	if (strncmp(q, "line", 4) == 0 && ISBLANK(q[4]))
+		q = skipblanks(q + 4);
+	if (ISDIGIT(*q))
+		ppline(q, eol);
+	else
+		nl();
+}
+
+/* p points to the line number, eol to the end of the line. */
+static void
+ppline(char *p, char *eol)
+{
+	char *ep, *str;
+	size_t l;
+
+	l = strtoul(p, &ep, 10);
+	if ((p = memchr(ep, '\"', eol - ep)) == NULL) {
+		cursp.s_line = nextsp.s_line = l;
+		return;
+	}
+
+	ep = eol;
+	while (ep > p && *ep != '\"')
+		ep--;
+	if (ep == p)
+		fatalx("ppline: error parsing line %zu", nextsp.s_line);
+	str = cstring(p + 1, ep - 1, NULL, NULL);
+
+	/* XXX: str might be \0 terminated in the middle */
+	cursp.s_file = nextsp.s_file = ntenter(&names, str);
+	free(str);
+	cursp.s_line = nextsp.s_line = l;
+}
+
+/*
+ * p points to the opening quote of a character constant or a string
+ * literal. Returns a pointer behind the closing quote, or NULL if the
+ * literal is malformed.
+ */
+static char *
+scanlit(char *p)
+{
+	char *q = p + 1;
+	int i;
+
+	for (;;) {
+		if (q >= lexend || *q == '\n')
+			return NULL;
+		if (*q == *p)
+			break;
+		if (*q++ != '\\')
+			continue;
+		switch (*q) {
+		case '\'':
+		case '"':
+		case '?':
+		case '\\':
+		case 'a':
+		case 'b':
+		case 'e':
+		case 'f':
+		case 'n':
+		case 'r':
+		case 't':
+		case 'v':
+			q++;
+			break;
+		case 'x':
+			if (!ISHEX(q[1]))
+				return NULL;
+			q += ISHEX(q[2]) ? 3 : 2;
+			break;
+		default:
+			if (!ISOCT(*q))
+				return NULL;
+			for (i = 0; i < 3 && ISOCT(*q); i++)
+				q++;
+			break;
+		}
+	}
+	if (*p == '\'' && q == p + 1)
+		return NULL;
+	return q + 1;
+}
+
+/* Integer suffix: [uU]?([lL]|ll|LL) or ([lL]|ll|LL)?[uU] */
+static int
+isuffix(char *p)
+{
+	int l, n, u;
+
+	u = *p == 'u' || *p == 'U';
+	if ((p[u] == 'l' && p[u + 1] == 'l') ||
+	    (p[u] == 'L' && p[u + 1] == 'L'))
+		n = u + 2;
+	else if (p[u] == 'l' || p[u] == 'L')
+		n = u + 1;
+	else
+		n = 0;
+	if (u)
+		return n > 0 ? n : 1;
+
+	/* No leading u, look for a trailing one. */
+	if ((p[0] == 'l' && p[1] == 'l') || (p[0] == 'L' && p[1] == 'L'))
+		l = 2;
+	else
+		l = p[0] == 'l' || p[0] == 'L';
+	if (p[l] == 'u' || p[l] == 'U')
+		return l + 1;
+	return n;
+}
+
+/* Exponent: [eE][-+]?[0-9]+, or [pP]... if bin is set. */
+static int
+exponent(char *p, int bin)
+{
+	int n;
+
+	if (bin ? (*p != 'p' && *p != 'P') : (*p != 'e' && *p != 'E'))
+		return 0;
+	n = p[1] == '-' || p[1] == '+' ? 2 : 1;
+	if (!ISDIGIT(p[n]))
+		return 0;
+	while (ISDIGIT(p[n]))
+		n++;
+	return n;
+}
+
+static int
+fsuffix(char *p)
+{
+	return *p == 'f' || *p == 'F' || *p == 'l' || *p == 'L';
+}
+
+static int
+span(char *p, int class)
+{
+	int n;
+
+	for (n = 0; cclass[(u_char)p[n]] & class; n++)
+		continue;
+	return n;
+}
+
+/*
+ * Finds the longest of the number rules below that matches at p. On a
+ * tie, the rule listed first wins.
+ *
+ *	0[0-7]*ISUF?			octal integer
+ *	[1-9][0-9]*ISUF?		decimal integer
+ *	0[xX]HD+ISUF?			hexadecimal integer
+ *	[0-9]*"."[0-9]+EP?[fFlL]?	floating
+ *	[0-9]+"."?EP?[fFlL]?		floating
+ *	0[xX]HD*"."HD+BEP[fFlL]?	hexadecimal floating
+ *	0[xX]HD+"."BEP[fFlL]?		hexadecimal floating
+ *	0[xX]HD+BEP[fFlL]?		hexadecimal floating
+ */
+static char *
+number(char *p, int *tokp)
+{
+	int best, d, e, h, n, rule;
+
+	best = rule = 0;
+#define MATCH(r, len)	do {						\
+	if ((len) > best) {						\
+		best = (len);						\
+		rule = (r);						\
+	}								\
+} while (0)
+
+	d = span(p, C_DIGIT);
+	if (*p == '0') {
+		n = 1 + span(&p[1], C_OCT);
+		MATCH(1, n + isuffix(&p[n]));
+	} else if (d > 0) {
+		MATCH(2, d + isuffix(&p[d]));
+	}
+	if (*p == '0' && (p[1] == 'x' || p[1] == 'X')) {
+		h = span(&p[2], C_HEX);
+		if (h > 0) {
+			n = 2 + h;
+			MATCH(3, n + isuffix(&p[n]));
+		}
+		n = 2 + h;
+		if (p[n] == '.' && (e = span(&p[n + 1], C_HEX)) > 0) {
+			n += 1 + e;
+			if ((e = exponent(&p[n], 1)) > 0) {
+				n += e;
+				MATCH(6, n + fsuffix(&p[n]));
+			}
+		}
+		n = 2 + h;
+		if (h > 0 && p[n] == '.' && (e = exponent(&p[n + 1], 1)) > 0) {
+			n += 1 + e;
+			MATCH(7, n + fsuffix(&p[n]));
+		}
+		n = 2 + h;
+		if (h > 0 && (e = exponent(&p[n], 1)) > 0) {
+			n += e;
+			MATCH(8, n + fsuffix(&p[n]));
+		}
+	}
+	if (p[d] == '.' && (e = span(&p[d + 1], C_DIGIT)) > 0) {
+		n = d + 1 + e;
+		n += exponent(&p[n], 0);
+		MATCH(4, n + fsuffix(&p[n]));
+	}
+	if (d > 0) {
+		n = d + (p[d] == '.');
+		n += exponent(&p[n], 0);
+		MATCH(5, n + fsuffix(&p[n]));
+	}
+#undef MATCH
+
+	if ((size_t)best >= numbufsize) {
+		numbufsize = best + 32;
+		numbuf = xrealloc(numbuf, numbufsize);
+	}
+	memcpy(numbuf, p, best);
+	numbuf[best] = '\0';
+
+	switch (rule) {
+	case 1:
+		intcon(8);
+		*tokp = TOK_ICON;
+		break;
+	case 2:
+		intcon(10);
+		*tokp = TOK_ICON;
+		break;
+	case 3:
+		intcon(16);
+		*tokp = TOK_ICON;
+		break;
+	case 4:
+	case 5:
+		floatcon();
+		*tokp = TOK_FCON;
+		break;
+	default:
+		hexfloatcon();
+		*tokp = TOK_FCON;
+		break;
+	}
+	return p + best;
+}
+
+/* p points to the opening quote. */
+static void
+charcon(char *p)
+{
+	int ch;
+
+	p++;	/* skip ' */
+	if (*p != '\\') {
+		token.t_expr = ast_expr_icon(&cursp, *p, &cir_int);
+		return;
+	}
+
+	p++;
+	ch = escapechar(p, NULL);
+	token.t_expr = ast_expr_icon(&cursp, ch, &cir_int);
+}
+
+static void
+intcon(int base)
+{
+	char *ep;
+	int l, u;
+	uint64_t val;
+
+	errno = 0;
+	val = strtoull(numbuf, &ep, 0);
+	if (errno == ERANGE && val == ULLONG_MAX) {
+		warnh("integer constant %s too large, using 1 instead",
+		    numbuf);
+		val = 1;
+	}
+
+	l = u = 0;
+	while (*ep != '\0') {
+		switch (*ep) {
+		case 'u':
+		case 'U':
+			u++;
+			break;
+		case 'l':
+		case 'L':
+			l++;
+			break;
+		default:
+			fatalx("intcon: bad integer suffix accepted by lexer: "
+			    "%s ", numbuf);
+		}
+		ep++;
+	}
+
+	if (u > 1 || l > 2)
+		fatalx("intcon: bad integer suffix accepted by lexer: %s",
+		    numbuf);
+
+	/* See 6.4.4 for the rules that determine the type of the constant. */
+	if (u == 1 && l == 2) {
+		token.t_expr = ast_expr_ucon(&cursp, val, &cir_ullong);
+		return;
+	}
+	if ((u == 0 && l == 2) || (u == 1 && l == 1)) {
+		if (val <= C_LLONG_MAX)
+			token.t_expr = ast_expr_icon(&cursp, val, &cir_llong);
+		else	/* dec gets extended type unsigned long long */
+			token.t_expr = ast_expr_ucon(&cursp, val, &cir_ullong);
+		return;
+	}
+	if (u == 1 && l == 0) {
+		if (val <= C_UINT_MAX)
+			token.t_expr = ast_expr_ucon(&cursp, val, &cir_uint);
+		else if (val <= C_ULONG_MAX)
+			token.t_expr = ast_expr_ucon(&cursp, val, &cir_ulong);
+		else
+			token.t_expr = ast_expr_ucon(&cursp, val, &cir_ullong);
+		return;
+	}
+	if (u == 0 && l == 1) {
+		if (val <= C_LONG_MAX)
+			token.t_expr = ast_expr_icon(&cursp, val, &cir_long);
+		else if (base != 10 && val <= C_ULONG_MAX)
+			token.t_expr = ast_expr_ucon(&cursp, val, &cir_ulong);
+		else if (val <= C_LLONG_MAX)
+			token.t_expr = ast_expr_icon(&cursp, val, &cir_llong);
+		else	/* dec gets extended type unsigned long long */
+			token.t_expr = ast_expr_ucon(&cursp, val, &cir_ullong);
+		return;
+	}
+
+	/* u == 0 && l == 0 */
+	if (val <= C_INT_MAX)
+		token.t_expr = ast_expr_icon(&cursp, val, &cir_int);
+	else if (base != 10 && val <= C_UINT_MAX)
+		token.t_expr = ast_expr_ucon(&cursp, val, &cir_uint);
+	else if (val <= C_LONG_MAX)
+		token.t_expr = ast_expr_icon(&cursp, val, &cir_long);
+	else if (base != 10 && val <= C_ULONG_MAX)
+		token.t_expr = ast_expr_ucon(&cursp, val, &cir_ulong);
+	else if (val <= C_LLONG_MAX)
+		token.t_expr = ast_expr_icon(&cursp, val, &cir_llong);
+	else	/* dec gets extended type unsigned long long */
+		token.t_expr = ast_expr_ucon(&cursp, val, &cir_ullong);
+}
+
+static void
+floatcon(void)
+{
+	char *ep, *f, *l;
+	double dval;
+
+	if ((f = strrchr(numbuf, 'f')) == NULL)
+		f = strrchr(numbuf, 'F');
+	if ((l = strchr(numbuf, 'l')) == NULL)
+		l = strchr(numbuf, 'L');
+
+	errno = 0;
+	dval = strtod(numbuf, &ep);
+	if (errno == ERANGE && dval == HUGE_VAL) {
+		warnh("floating-point constant too large, using 1.0");
+		dval = 1.0;
+	}
+
+	if (f != NULL)
+		token.t_expr = ast_expr_fcon(&cursp, dval, &cir_double);
+	else
+		token.t_expr = ast_expr_fcon(&cursp, dval, &cir_float);
+}
+
+static void
+hexfloatcon(void)
+{
+	fatalx("hexadecimal floating-point constants are not supported yet");
+}
+
+int
+peek(void)
+{
+	char *p;
+
+	for (p = lexp; p < lexend && isspace((u_char)*p); p++) {
+		if (*p == '\n')
+			nl();
+	}
+	lexp = p;
+	return p < lexend ? (u_char)*p : 0;
+}
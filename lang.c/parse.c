@@ -25,6 +25,14 @@
 
 #include "lang.c/c.h"
 
+/*
+ * The semantic checker marks typedef names with their storage class.
+ * Its symbols are visible to the parser when declarations are compiled
+ * one at a time.
+ */
+#define ISTYPEDEF(sym)	\
+	(((sym)->s_flags & SYM_TYPEDEF) || (sym)->s_sclass == AST_SC_TYPEDEF)
+
 union token token;
 
 char *toknames[] = {
@@ -186,11 +194,31 @@ parse(void)
 {
 	struct ast_decl *dcl;
 
+	parse_start();
+	while ((dcl = parse_extdecl()) != NULL)
+		ast_declhead_newdecl(&ast_program, dcl);
+}
+
+void
+parse_start(void)
+{
 	gettok();
+}
+
+/*
+ * Returns the next external declaration, or NULL at the end of the
+ * translation unit.
+ */
+struct ast_decl *
+parse_extdecl(void)
+{
+	struct ast_decl *dcl;
+
 	while (tok != 0) {
 		if ((dcl = decl(1)) != NULL)
-			ast_declhead_newdecl(&ast_program, dcl);
+			return dcl;
 	}
+	return NULL;
 }
 
 static int
@@ -220,7 +248,7 @@ istypename(char *ident)
 
 	if ((sym = symlookup(ident, NSORD)) == NULL)
 		return 0;
-	return sym->s_flags & SYM_TYPEDEF;
+	return ISTYPEDEF(sym);
 }
 
 static int
@@ -779,7 +807,7 @@ register_typedef(struct ast_declspecs *ad, char *ident)
 	if (sym->s_scope == curscope)
 		return;
 
-	if ((sym->s_flags & SYM_TYPEDEF) || ad->ad_sclass == AST_SC_TYPEDEF) {
+	if (ISTYPEDEF(sym) || ad->ad_sclass == AST_SC_TYPEDEF) {
 		if (ad->ad_sclass == AST_SC_TYPEDEF) {
 			symenter(ident, &dummytype, NSORD);
 			sym->s_flags |= SYM_TYPEDEF;
@@ -903,7 +931,8 @@ postfixexpr(void)
 		/* TODO: Handle wide strings, mixed normal and wide strings. */
 		x = ast_expr_strlit();
 		while (tok == TOK_STRLIT) {
-			ast_expr_strlit_append(x, token.t_strlit);
+			ast_expr_strlit_append(x, token.t_strlit.ts_ptr,
+			    token.t_strlit.ts_len);
 			gettok();
 		}
 		ast_expr_strlit_finish(x);
@@ -0,0 +1,524 @@
+/*
+ * Copyright (c) 2008 Stefan Kempf <sisnkemp@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Snapshots of the file scope. After the input has been compiled,
+ * snapsave writes the names, types and symbols of the file scope
+ * together with the code lines of the input. A later compilation whose
+ * input starts with the same lines loads them with snapload and skips
+ * those lines. Pointers are stored as indices into the tables of
+ * the file, so it can be mapped at any address.
+ *
+ * Only declarations can be saved. Objects and functions defined in
+ * the prefix would need their IR as well.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/queue.h>
+#include <sys/stat.h>
+
+#include <err.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "comp/comp.h"
+#include "comp/ir.h"
+
+#include "lang.c/c.h"
+
+#define SNAP_MAGIC	0x50414e53	/* "SNAP" */
+#define SNAP_VERSION	2
+#define SNAP_NONE	UINT32_MAX
+
+struct snaphdr {
+	uint32_t	sh_magic;
+	uint32_t	sh_version;
+	uint32_t	sh_ptrsize;
+	uint32_t	sh_pad;
+	uint64_t	sh_len;		/* Of the prefix, see lexprefix. */
+	uint32_t	sh_ntypes;
+	uint32_t	sh_nelms;
+	uint32_t	sh_nsyms;
+	uint32_t	sh_nstrs;
+	uint64_t	sh_strsize;
+};
+
+/* Types that are not fixed[] are numbered from NFIXED on. */
+struct snaptype {
+	uint64_t	st_size;
+	uint64_t	st_align;
+	uint64_t	st_dim;
+	uint32_t	st_op;
+	uint32_t	st_flags;
+	uint32_t	st_base;
+	uint32_t	st_elms;	/* First element in the element table. */
+	uint32_t	st_nelms;
+	uint32_t	st_pad;
+};
+
+struct snapelm {
+	uint64_t	se_off;
+	uint32_t	se_name;
+	uint32_t	se_type;
+	int32_t		se_fldsize;
+	uint32_t	se_pad;
+};
+
+struct snapsym {
+	uint32_t	ss_ident;
+	uint32_t	ss_type;
+	int32_t		ss_ns;
+	int32_t		ss_sclass;
+	int32_t		ss_fnspec;
+	int32_t		ss_flags;
+	int32_t		ss_enumval;
+};
+
+struct snapstr {
+	uint32_t	ss_off;
+	uint32_t	ss_len;
+	uint32_t	ss_hash;
+};
+
+/* Types that every compilation has. */
+static struct ir_type *fixed[] = {
+	NULL, &ir_i8, &ir_u8, &ir_i16, &ir_u16, &ir_i32, &ir_u32, &ir_i64,
+	&ir_u64, &ir_f32, &ir_f64, &ir_void, &ir_bool, &ir_ptr, &ir_obj,
+	&cir_enum,
+	NULL		/* builtin_va_list */
+};
+
+#define NFIXED	(sizeof fixed / sizeof fixed[0])
+
+#define GROW(a, n, max) do {						\
+	if ((n) == (max)) {						\
+		(max) = (max) == 0 ? 256 : (max) * 2;			\
+		(a) = xrealloc((a), (max) * sizeof *(a));		\
+	}								\
+} while (0)
+
+#ifdef __LP64__
+#define SCRAMBLE_A	11400714819323198485UL
+#else
+#define SCRAMBLE_A	2654435769UL
+#endif
+
+#define SCRAMBLE(p)	((uintptr_t)(p) * SCRAMBLE_A)
+#define PTRBITS		(sizeof(uintptr_t) * CHAR_BIT)
+
+/* Maps the types and names saved so far to their indices. */
+struct ptrent {
+	void		*p_key;
+	uint32_t	p_idx;
+};
+
+struct ptrmap {
+	struct	ptrent *p_tab;
+	size_t	p_size;
+	size_t	p_used;
+	int	p_bits;
+};
+
+static struct ptrmap typemap, strmap;
+static struct snaptype *types;
+static struct snapelm *elms;
+static struct snapsym *syms;
+static struct snapstr *strs;
+static char *chars;
+static size_t ntypes, maxtypes, nelms, maxelms, nsyms, maxsyms;
+static size_t nstrs, maxstrs, nchars, maxchars;
+
+static struct ptrent *
+mapfind(struct ptrmap *m, void *key)
+{
+	size_t i, mask = m->p_size - 1;
+
+	i = SCRAMBLE(key) >> (PTRBITS - m->p_bits);
+	while (m->p_tab[i].p_key != NULL && m->p_tab[i].p_key != key)
+		i = (i + 1) & mask;
+	return &m->p_tab[i];
+}
+
+static uint32_t
+mapget(struct ptrmap *m, void *key)
+{
+	struct ptrent *e;
+
+	if (m->p_size == 0)
+		return SNAP_NONE;
+	e = mapfind(m, key);
+	return e->p_key == NULL ? SNAP_NONE : e->p_idx;
+}
+
+static void
+mapput(struct ptrmap *m, void *key, uint32_t idx)
+{
+	size_t i, osize = m->p_size;
+	struct ptrent *e, *otab = m->p_tab;
+
+	if (m->p_used >= m->p_size / 2) {
+		m->p_bits = osize == 0 ? 10 : m->p_bits + 1;
+		m->p_size = (size_t)1 << m->p_bits;
+		m->p_tab = xcalloc(m->p_size, sizeof *m->p_tab);
+		for (i = 0; i < osize; i++) {
+			if (otab[i].p_key != NULL)
+				*mapfind(m, otab[i].p_key) = otab[i];
+		}
+		free(otab);
+	}
+	e = mapfind(m, key);
+	e->p_key = key;
+	e->p_idx = idx;
+	m->p_used++;
+}
+
+static uint32_t
+savestr(char *name)
+{
+	size_t len;
+	uint32_t idx;
+
+	if (name == NULL)
+		return SNAP_NONE;
+	if ((idx = mapget(&strmap, name)) != SNAP_NONE)
+		return idx;
+	len = strlen(name);
+	while (nchars + len > maxchars) {
+		maxchars = maxchars == 0 ? 65536 : maxchars * 2;
+		chars = xrealloc(chars, maxchars);
+	}
+	memcpy(&chars[nchars], name, len);
+	GROW(strs, nstrs, maxstrs);
+	strs[nstrs].ss_off = nchars;
+	strs[nstrs].ss_len = len;
+	strs[nstrs].ss_hash = nthash(name, len);
+	nchars += len;
+	mapput(&strmap, name, nstrs);
+	return nstrs++;
+}
+
+static uint32_t
+newtype(struct ir_type *ty, uint32_t base)
+{
+	struct snaptype *st;
+
+	GROW(types, ntypes, maxtypes);
+	st = &types[ntypes];
+	st->st_op = ty->it_op;
+	st->st_flags = ty->it_flags;
+	st->st_size = ty->it_size;
+	st->st_align = ty->it_align;
+	st->st_dim = ty->it_op == IR_ARR ? ty->it_dim : 0;
+	st->st_base = base;
+	st->st_elms = st->st_nelms = 0;
+	st->st_pad = 0;
+	mapput(&typemap, ty, NFIXED + ntypes);
+	return NFIXED + ntypes++;
+}
+
+static uint32_t savetype(struct ir_type *);
+
+/*
+ * The element types are saved before the elements themselves, so that
+ * the elements of a type are contiguous in the table.
+ */
+static void
+saveelms(struct ir_type *ty, uint32_t idx)
+{
+	struct ir_typelm *elm;
+	struct snapelm *se;
+
+	SIMPLEQ_FOREACH(elm, &ty->it_typeq, it_link)
+		savetype(elm->it_type);
+	types[idx - NFIXED].st_elms = nelms;
+	SIMPLEQ_FOREACH(elm, &ty->it_typeq, it_link) {
+		GROW(elms, nelms, maxelms);
+		se = &elms[nelms++];
+		se->se_name = savestr(elm->it_name);
+		se->se_type = savetype(elm->it_type);
+		se->se_fldsize = elm->it_fldsize;
+		se->se_off = elm->it_off;
+		se->se_pad = 0;
+		types[idx - NFIXED].st_nelms++;
+	}
+}
+
+/*
+ * Structs and unions get their index before their elements are saved,
+ * because they may refer to themselves. Every other type comes after
+ * the types it is made of.
+ */
+static uint32_t
+savetype(struct ir_type *ty)
+{
+	size_t i;
+	uint32_t idx;
+
+	for (i = 0; i < NFIXED; i++) {
+		if (fixed[i] == ty)
+			return i;
+	}
+	if ((idx = mapget(&typemap, ty)) != SNAP_NONE)
+		return idx;
+	if (ty->it_op == IR_STRUCT || ty->it_op == IR_UNION) {
+		idx = newtype(ty, SNAP_NONE);
+		saveelms(ty, idx);
+		return idx;
+	}
+	idx = savetype(ty->it_base);
+	idx = newtype(ty, idx);
+	if (ty->it_op == IR_FUNTY)
+		saveelms(ty, idx);
+	return idx;
+}
+
+static void
+writeall(FILE *fp, char *path, void *p, size_t size, size_t n)
+{
+	if (n > 0 && fwrite(p, size, n, fp) != n)
+		err(1, "%s", path);
+}
+
+void
+snapsave(char *path)
+{
+	char *text;
+	size_t i, len;
+	struct snaphdr sh;
+	struct snapsym *ss;
+	struct symbol *sym;
+	FILE *fp;
+
+	fixed[NFIXED - 1] = builtin_va_list;
+	for (i = 0; i < symmark(); i++) {
+		sym = symnth(i);
+		if (sym->s_scope != 0)
+			continue;
+		if (IR_ISFUNTY(sym->s_type) ?
+		    sym->s_type->it_flags & IR_FUNDEF :
+		    sym->s_flags & (SYM_DEF | SYM_TENTDEF))
+			errx(1, "%s: `%s' is defined, only declarations can "
+			    "be saved", path, sym->s_ident);
+		GROW(syms, nsyms, maxsyms);
+		ss = &syms[nsyms++];
+		ss->ss_ident = savestr(sym->s_ident);
+		ss->ss_type = savetype(sym->s_type);
+		ss->ss_ns = sym->s_ns;
+		ss->ss_sclass = sym->s_sclass;
+		ss->ss_fnspec = sym->s_fnspec;
+		ss->ss_flags = sym->s_flags;
+		ss->ss_enumval = sym->s_enumval;
+	}
+
+	text = lexprefix(&len);
+	sh.sh_magic = SNAP_MAGIC;
+	sh.sh_version = SNAP_VERSION;
+	sh.sh_ptrsize = IR_PTR_SIZE;
+	sh.sh_pad = 0;
+	sh.sh_len = len;
+	sh.sh_ntypes = ntypes;
+	sh.sh_nelms = nelms;
+	sh.sh_nsyms = nsyms;
+	sh.sh_nstrs = nstrs;
+	sh.sh_strsize = nchars;
+
+	if ((fp = fopen(path, "w")) == NULL)
+		err(1, "%s", path);
+	writeall(fp, path, &sh, sizeof sh, 1);
+	writeall(fp, path, types, sizeof *types, ntypes);
+	writeall(fp, path, elms, sizeof *elms, nelms);
+	writeall(fp, path, syms, sizeof *syms, nsyms);
+	writeall(fp, path, strs, sizeof *strs, nstrs);
+	writeall(fp, path, chars, 1, nchars);
+	writeall(fp, path, text, 1, len);
+	if (fclose(fp) == EOF)
+		err(1, "%s", path);
+	free(text);
+}
+
+static char *
+loadstr(struct snapstr *st, char *ch, uint32_t idx, size_t n, size_t size,
+    char *path)
+{
+	if (idx == SNAP_NONE)
+		return NULL;
+	if (idx >= n || st[idx].ss_off + (uint64_t)st[idx].ss_len > size)
+		errx(1, "%s: corrupt snapshot", path);
+	st = &st[idx];
+	return ntenterh(&names, &ch[st->ss_off], st->ss_len, st->ss_hash);
+}
+
+/*
+ * Rebuild the types in three passes: structs and unions are created
+ * first, then the other types in the order they were saved, and then
+ * the elements of structs, unions and functions. Sizes and flags are
+ * taken from the snapshot, not recomputed. Derived types that came
+ * back complete are interned and may be shared, so they are left alone.
+ */
+static struct ir_type **
+loadtypes(struct snaphdr *sh, struct snaptype *st, struct snapelm *se,
+    struct snapstr *ss, char *ch, char *path)
+{
+	size_t i, j, n = NFIXED + sh->sh_ntypes;
+	struct ir_type **tys, *ty;
+	struct ir_typelm *elm;
+	struct snapelm *e;
+
+	tys = xmnalloc(n, sizeof *tys);
+	for (i = 0; i < NFIXED; i++)
+		tys[i] = fixed[i];
+	for (i = 0; i < sh->sh_ntypes; i++) {
+		if (st[i].st_op == IR_STRUCT || st[i].st_op == IR_UNION)
+			tys[NFIXED + i] = ir_type_sou(st[i].st_op);
+		else if (st[i].st_base >= NFIXED + i)
+			errx(1, "%s: corrupt snapshot", path);
+		if ((uint64_t)st[i].st_elms + st[i].st_nelms > sh->sh_nelms)
+			errx(1, "%s: corrupt snapshot", path);
+		for (j = 0; j < st[i].st_nelms; j++) {
+			if (se[st[i].st_elms + j].se_type >= n)
+				errx(1, "%s: corrupt snapshot", path);
+		}
+	}
+
+	for (i = 0; i < sh->sh_ntypes; i++) {
+		if (st[i].st_op == IR_STRUCT || st[i].st_op == IR_UNION)
+			continue;
+		ty = tys[st[i].st_base];
+		switch (st[i].st_op) {
+		case IR_PTR:
+			ty = ir_type_ptr(ty);
+			break;
+		case IR_ARR:
+			ty = ir_type_arr(ty, st[i].st_dim);
+			break;
+		case IR_FUNTY:
+			ty = ir_type_func(ty);
+			break;
+		default:
+			if (!(st[i].st_op & IR_TYQUALS))
+				errx(1, "%s: corrupt snapshot", path);
+			ty = ir_type_qual(ty, st[i].st_op);
+			break;
+		}
+		tys[NFIXED + i] = ty;
+	}
+
+	for (i = 0; i < sh->sh_ntypes; i++) {
+		ty = tys[NFIXED + i];
+		for (j = 0; j < st[i].st_nelms; j++) {
+			e = &se[st[i].st_elms + j];
+			elm = ir_typelm(loadstr(ss, ch, e->se_name,
+			    sh->sh_nstrs, sh->sh_strsize, path),
+			    tys[e->se_type], 0, 0);
+			elm->it_fldsize = e->se_fldsize;
+			elm->it_off = e->se_off;
+			ir_type_newelm(ty, elm);
+		}
+		if (st[i].st_op != IR_STRUCT && st[i].st_op != IR_UNION &&
+		    st[i].st_op != IR_FUNTY && IR_ISCOMPLETE(ty))
+			continue;
+		ty->it_flags = st[i].st_flags;
+		ty->it_size = st[i].st_size;
+		ty->it_align = st[i].st_align;
+		if (IR_ISQUAL(ty))
+			ty->it_dim = ty->it_base->it_dim;
+		else if (ty->it_op == IR_ARR)
+			ty->it_dim = st[i].st_dim;
+	}
+	return tys;
+}
+
+/*
+ * Returns 1 if the snapshot in path was loaded and its prefix skipped.
+ */
+int
+snapload(char *path)
+{
+	int fd;
+	char *p, *ch, *text;
+	size_t i, size;
+	struct stat st;
+	struct snaphdr *sh;
+	struct snaptype *stys;
+	struct snapelm *selms;
+	struct snapsym *ssyms;
+	struct snapstr *sstrs;
+	struct ir_type **tys, *ty;
+	struct symbol *sym;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		err(1, "%s", path);
+	if (fstat(fd, &st) == -1)
+		err(1, "%s", path);
+	if ((size_t)st.st_size < sizeof *sh)
+		errx(1, "%s: not a snapshot", path);
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED)
+		err(1, "%s", path);
+	close(fd);
+
+	sh = (struct snaphdr *)p;
+	if (sh->sh_magic != SNAP_MAGIC)
+		errx(1, "%s: not a snapshot", path);
+	if (sh->sh_version != SNAP_VERSION || sh->sh_ptrsize != IR_PTR_SIZE) {
+		warnx("%s: snapshot from another compiler, not used", path);
+		munmap(p, st.st_size);
+		return 0;
+	}
+	size = sizeof *sh + sh->sh_ntypes * sizeof *stys +
+	    sh->sh_nelms * sizeof *selms + sh->sh_nsyms * sizeof *ssyms +
+	    sh->sh_nstrs * sizeof *sstrs + sh->sh_strsize + sh->sh_len;
+	if (size != (size_t)st.st_size)
+		errx(1, "%s: corrupt snapshot", path);
+
+	stys = (struct snaptype *)(sh + 1);
+	selms = (struct snapelm *)(stys + sh->sh_ntypes);
+	ssyms = (struct snapsym *)(selms + sh->sh_nelms);
+	sstrs = (struct snapstr *)(ssyms + sh->sh_nsyms);
+	ch = (char *)(sstrs + sh->sh_nstrs);
+	text = ch + sh->sh_strsize;
+
+	if (!lexskip(text, sh->sh_len)) {
+		warnx("%s: input does not start with the prefix of the "
+		    "snapshot, not used", path);
+		munmap(p, st.st_size);
+		return 0;
+	}
+
+	fixed[NFIXED - 1] = builtin_va_list;
+	tys = loadtypes(sh, stys, selms, sstrs, ch, path);
+	for (i = 0; i < sh->sh_nsyms; i++) {
+		if (ssyms[i].ss_type >= NFIXED + sh->sh_ntypes ||
+		    ssyms[i].ss_ns < 0 || ssyms[i].ss_ns >= NSMAX)
+			errx(1, "%s: corrupt snapshot", path);
+		ty = tys[ssyms[i].ss_type];
+		sym = symenter(loadstr(sstrs, ch, ssyms[i].ss_ident,
+		    sh->sh_nstrs, sh->sh_strsize, path), ty, ssyms[i].ss_ns);
+		sym->s_sclass = ssyms[i].ss_sclass;
+		sym->s_fnspec = ssyms[i].ss_fnspec;
+		sym->s_flags = ssyms[i].ss_flags;
+		sym->s_enumval = ssyms[i].ss_enumval;
+		if (sym->s_ns == NSORD && ty != NULL && IR_ISFUNTY(ty))
+			ast_gencode_funsym(sym);
+	}
+	free(tys);
+	munmap(p, st.st_size);
+	return 1;
+}
@@ -14,6 +14,16 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+/*
+ * All visible symbols are found through one hash table keyed by the
+ * interned identifier. Each entry holds, per namespace, the innermost
+ * symbol for that identifier; it points to the symbol it shadows.
+ * Entering a symbol pushes it onto an undo log, and closing a scope
+ * pops the symbols of that scope from the log and makes the shadowed
+ * ones visible again. Labels have function scope and are kept on a
+ * separate list until the function body is closed.
+ */
+
 #include <sys/types.h>
 #include <sys/queue.h>
 
@@ -31,36 +41,118 @@
 #define SCRAMBLE_A	2654435769UL
 #endif
 
-#define SCRAMBLE(ident)	((char *)((uintptr_t)(ident) * SCRAMBLE_A))
+#define SCRAMBLE(ident)	((uintptr_t)(ident) * SCRAMBLE_A)
+
+#define HASHBITS_INIT	10
+#define PTRBITS		(sizeof(uintptr_t) * CHAR_BIT)
+
+struct hashent {
+	char	*h_ident;
+	struct	symbol *h_syms[NSMAX];
+};
 
 int curscope = -1;
 
 static int stkeepsyms;
-static struct symtab builtintab;
-static struct symtab *labeltab;
-static struct symtab *toptab;
+static struct hashent *hashtab;
+static size_t hashsize;
+static int hashbits;
+static size_t hashused;
+static struct symbol **undolog;
+static size_t nundo;
+static size_t maxundo;
+static SLIST_HEAD(, symbol) labels = SLIST_HEAD_INITIALIZER(labels);
 static struct symtab *freetabs;
 static struct symbol *freesyms;
 
+static struct hashent *
+hashfind(struct hashent *tab, size_t size, char *ident)
+{
+	size_t i, mask = size - 1;
+
+	i = SCRAMBLE(ident) >> (PTRBITS - hashbits);
+	while (tab[i].h_ident != NULL && tab[i].h_ident != ident)
+		i = (i + 1) & mask;
+	return &tab[i];
+}
+
 static void
-tabinit(struct symtab *st, int scope)
+hashgrow(void)
 {
-	int i;
+	size_t i, osize = hashsize;
+	struct hashent *h, *otab = hashtab;
 
-	for (i = 0; i < NSMAX; i++) {
-		SLIST_INIT(&st->s_syms[i]);
-		st->s_root[i] = NULL;
+	hashbits = osize == 0 ? HASHBITS_INIT : hashbits + 1;
+	hashsize = (size_t)1 << hashbits;
+	hashtab = xcalloc(hashsize, sizeof *hashtab);
+	for (i = 0; i < osize; i++) {
+		if (otab[i].h_ident == NULL)
+			continue;
+		h = hashfind(hashtab, hashsize, otab[i].h_ident);
+		*h = otab[i];
 	}
-	st->s_top = toptab;
-	st->s_scope = scope;
-	toptab = st;
+	free(otab);
+}
+
+static struct hashent *
+hashenter(char *ident)
+{
+	struct hashent *h;
+
+	if (hashused >= hashsize / 2)
+		hashgrow();
+	h = hashfind(hashtab, hashsize, ident);
+	if (h->h_ident == NULL) {
+		h->h_ident = ident;
+		hashused++;
+	}
+	return h;
+}
+
+static void
+bind(struct symbol *sym)
+{
+	struct hashent *h;
+
+	h = hashenter(sym->s_ident);
+	sym->s_shadow = h->h_syms[sym->s_ns];
+	h->h_syms[sym->s_ns] = sym;
+}
+
+static void
+unbind(struct symbol *sym)
+{
+	struct hashent *h;
+
+	h = hashfind(hashtab, hashsize, sym->s_ident);
+	if (h->h_syms[sym->s_ns] != sym)
+		fatalx("unbind %s", sym->s_ident);
+	h->h_syms[sym->s_ns] = sym->s_shadow;
+}
+
+static void
+logsym(struct symbol *sym)
+{
+	if (nundo == maxundo) {
+		maxundo = maxundo == 0 ? 256 : maxundo * 2;
+		undolog = xrealloc(undolog, maxundo * sizeof *undolog);
+	}
+	undolog[nundo++] = sym;
+}
+
+static void
+freesym(struct symbol *sym)
+{
+	if (stkeepsyms)
+		return;
+	sym->s_shadow = freesyms;
+	freesyms = sym;
 }
 
 void
 symtab_builtin_init(void)
 {
-	toptab = NULL;
-	tabinit(&builtintab, -1);
+	curscope = -1;
 }
 
 void
@@ -69,7 +161,7 @@ symtabinit(int keepsyms)
 	while (curscope >= 0)
 		closescope();
 	stkeepsyms = keepsyms;
-	if (toptab != &builtintab)
+	if (nundo > 0 && undolog[nundo - 1]->s_scope != -1)
 		fatalx("symtabinit");
 	curscope = 0;
 }
@@ -80,117 +172,94 @@ openscope(void)
 	curscope++;
 }
 
-static void
-killtab(struct symtab *st)
-{
-	int i;
-	struct symbol *sym;
-
-	if (!stkeepsyms) {
-		for (i = 0; i < NSMAX; i++) {
-			while (!SLIST_EMPTY(&st->s_syms[i])) {
-				sym = SLIST_FIRST(&st->s_syms[i]);
-				SLIST_REMOVE_HEAD(&st->s_syms[i], s_link);
-				sym->s_left = freesyms;
-				freesyms = sym;
-			}
-		}
-	}
-	st->s_top = freetabs;
-	freetabs = st;
-}
-
 void
 closescope(void)
 {
 	struct symbol *sym;
-	struct symtab *st;
 
-	if (toptab != &builtintab && toptab->s_scope == curscope) {
-		st = toptab;
-		toptab = toptab->s_top;
-		if (st != labeltab)
-			killtab(st);
+	while (nundo > 0 && undolog[nundo - 1]->s_scope >= curscope) {
+		sym = undolog[--nundo];
+		unbind(sym);
+		freesym(sym);
 	}
-	if (labeltab != NULL && curscope == 2) {
-		SLIST_FOREACH(sym, &labeltab->s_syms[NSLBL], s_link) {
+	if (curscope == 2) {
+		SLIST_FOREACH(sym, &labels, s_link) {
 			if (sym->s_type != NULL)
 				continue;
 			errp(&sym->s_lblpos, "label `%s' undefined (first"
 			    "used here)", sym->s_ident);
 		}
-		killtab(labeltab);
-		labeltab = NULL;
+		while (!SLIST_EMPTY(&labels)) {
+			sym = SLIST_FIRST(&labels);
+			SLIST_REMOVE_HEAD(&labels, s_link);
+			unbind(sym);
+			freesym(sym);
+		}
 	}
 	curscope--;
 }
 
+/*
+ * Make the parameters saved by popsymtab visible again.
+ */
 void
 pushsymtab(struct symtab *st)
 {
+	struct symbol *sym;
+
 	if (curscope != 0)
 		fatalx("pushsymtab only for parameter scope supported");
 	curscope = 1;
 	if (st == NULL)
 		return;
-	st->s_top = toptab;
-	toptab = st;
+	while (!SLIST_EMPTY(&st->s_syms)) {
+		sym = SLIST_FIRST(&st->s_syms);
+		SLIST_REMOVE_HEAD(&st->s_syms, s_link);
+		bind(sym);
+		logsym(sym);
+	}
+	st->s_next = freetabs;
+	freetabs = st;
 }
 
+/*
+ * Hide the parameters of a function definition while the function
+ * itself is declared.
+ */
 struct symtab *
 popsymtab(void)
 {
+	struct symbol *sym;
 	struct symtab *st;
 
 	if (curscope != 1)
 		fatalx("popsymtab only for parameter scope supported");
-	if (toptab == &builtintab || toptab->s_scope != curscope) {
-		curscope = 0;
-		return NULL;
-	}
-
-	st = toptab;
-	toptab = toptab->s_top;
 	curscope = 0;
-	return st;
-}
-
-static struct symbol *
-searchtab(struct symtab *st, char *ident, int ns)
-{
-	char *key;
-	struct symbol *sym;
+	if (nundo == 0 || undolog[nundo - 1]->s_scope != 1)
+		return NULL;
 
-	sym = st->s_root[ns];
-	key = SCRAMBLE(ident);
-	while (sym != NULL) {
-		if (sym->s_key == key)
-			return sym;
-		if (key < sym->s_key)
-			sym = sym->s_left;
-		else
-			sym = sym->s_right;
+	if ((st = freetabs) != NULL)
+		freetabs = freetabs->s_next;
+	else
+		st = mem_alloc(&frontmem, sizeof *st);
+	SLIST_INIT(&st->s_syms);
+	while (nundo > 0 && undolog[nundo - 1]->s_scope == 1) {
+		sym = undolog[--nundo];
+		unbind(sym);
+		SLIST_INSERT_HEAD(&st->s_syms, sym, s_link);
 	}
-	return NULL;
+	return st;
 }
 
 struct symbol *
 symlookup(char *ident, int ns)
 {
-	struct symbol *sym;
-	struct symtab *st;
-	
-	if (ns == NSLBL) {
-		if (labeltab == NULL)
-			return NULL;
-		return searchtab(labeltab, ident, NSLBL);
-	}
+	struct hashent *h;
 
-	for (st = toptab; st != NULL; st = st->s_top) {
-		if ((sym = searchtab(st, ident, ns)) != NULL)
-			return sym;
-	}
-	return NULL;
+	if (hashsize == 0)
+		return NULL;
+	h = hashfind(hashtab, hashsize, ident);
+	return h->h_syms[ns];
 }
 
 /*
@@ -199,50 +268,62 @@ symlookup(char *ident, int ns)
 struct symbol *
 symenter(char *ident, struct ir_type *type, int ns)
 {
-	char *key;
-	struct symbol *sym, *p, **pp;
-	struct symtab *st = toptab;
-
-	if (ns == NSLBL && labeltab != NULL)
-		st = labeltab;
-	else if (toptab->s_scope != curscope) {
-		if ((st = freetabs) != NULL)
-			freetabs = freetabs->s_top;
-		else
-			st = mem_alloc(&frontmem, sizeof *st);
-		tabinit(st, curscope);
-		if (curscope >= 2 && labeltab == NULL)
-			labeltab = st;
-		if (ns == NSLBL)
-			st = labeltab;
-	}
+	struct symbol *sym;
 
+	/* Block scope symbols go away with the AST that refers to them. */
 	if ((sym = freesyms) != NULL)
-		freesyms = freesyms->s_left;
+		freesyms = freesyms->s_shadow;
+	else if (curscope > 0)
+		sym = mem_alloc(astmem, sizeof *sym);
 	else
 		sym = mem_alloc(&frontmem, sizeof *sym);
-	sym->s_left = sym->s_right = NULL;
 	sym->s_irsym = NULL;
 	sym->s_irlbl = NULL;
 	sym->s_type = type;
 	sym->s_ident = ident;
-	key = sym->s_key = SCRAMBLE(ident);
 	sym->s_scope = curscope;
+	sym->s_ns = ns;
 	sym->s_sclass = sym->s_fnspec = 0;
 	sym->s_flags = 0;
 	sym->s_enumval = 0;
-	SLIST_INSERT_HEAD(&st->s_syms[ns], sym, s_link);
-	pp = &st->s_root[ns];
-	while (*pp != NULL) {
-		p = *pp;
-		if (key < p->s_key)
-			pp = &p->s_left;
-		else if (key > p->s_key)
-			pp = &p->s_right;
-		else
-			fatalx("symenter %s(%p) == %s(%p)", ident, key,
-			    p->s_ident, p->s_key);
-	}
-	*pp = sym;
+	bind(sym);
+	if (ns == NSLBL)
+		SLIST_INSERT_HEAD(&labels, sym, s_link);
+	else
+		logsym(sym);
 	return sym;
 }
+
+size_t
+symmark(void)
+{
+	return nundo;
+}
+
+/* The symbols below a mark in the order they were entered. */
+struct symbol *
+symnth(size_t i)
+{
+	if (i >= nundo)
+		fatalx("symnth");
+	return undolog[i];
+}
+
+/*
+ * Remove the symbols entered since symmark() returned mark. The parser
+ * uses this to drop the typedef names it entered for an external
+ * declaration before the semantic checker enters the real symbols.
+ * Nothing refers to these symbols, so they are reused.
+ */
+void
+symrelease(size_t mark)
+{
+	struct symbol *sym;
+
+	while (nundo > mark) {
+		sym = undolog[--nundo];
+		unbind(sym);
+		sym->s_shadow = freesyms;
+		freesyms = sym;
+	}
+}
@@ -129,7 +129,7 @@ ir_emit_regpair(struct ir_symbol *sym, int sec)
 		fatalx("ir_emit_regpair %s_%d, %d",
 		    sym->is_name, sym->is_id, sec);
 	reg = pairtogpr[sym->is_id - REG_R3R4][sec];
-	emitf("%s", physregs[reg]->is_name);
+	emits(physregs[reg]->is_name);
 }
 
 void
@@ -367,6 +367,20 @@ pass_ralloc_retreg(struct ir_type *type)
 	fatalx("pass_ralloc_retreg: bad type: %d", type->it_op);
 }
 
+/*
+ * The prologue, epilogue and call sequences use r0, r11 and r12 as
+ * scratch registers, and r3, r4 and f1 to move arguments and return
+ * values into place.
+ */
+void
+pass_ralloc_clobbers(struct ir_func *fn, struct regset *rs)
+{
+	regset_addreg(rs, REG_R0);
+	regset_addreg(rs, REG_R3R4);
+	regset_addreg(rs, REG_R11R12);
+	regset_addreg(rs, REG_F1);
+}
+
 static void
 storereg(char *op, struct ir_symbol *reg, size_t off)
 {
@@ -474,14 +488,30 @@ pass_emit_call(struct ir_func *fn, struct ir_call *call)
 		emitf("\tmr\t%s, %%r3\n", sym->is_name);
 }
 
+/*
+ * The prologue uses %r0, %r11 and %r12 as scratch registers, so it
+ * can only be moved into the function body if they are not in use.
+ */
+int
+pass_shrinkwrap_machdep(struct ir_func *fn)
+{
+	return !BITVEC_ISSET(&fn->if_usedregs, REG_R0) &&
+	    !BITVEC_ISSET(&fn->if_usedregs, REG_R11) &&
+	    !BITVEC_ISSET(&fn->if_usedregs, REG_R12) &&
+	    !BITVEC_ISSET(&fn->if_usedregs, REG_R11R12);
+}
+
 void
 pass_emit_ret(struct ir_func *fn, struct ir_ret *ret)
 {
 	struct ir_symbol *sym;
 	struct ir_type *rety;
 
-	if (ret->ir_deadret)
+	if (ret->ir_deadret) {
+		if (ret->i_flags & IR_RET_NOFRAME)
+			emitf("\tblr\n");
 		return;
+	}
 	if (ret->ir_retexpr != NULL) {
 		rety = ret->ir_retexpr->ie_type;
 		sym = ret->ir_retexpr->ie_sym;
@@ -496,7 +526,9 @@ pass_emit_ret(struct ir_func *fn, struct ir_ret *ret)
 			fatalx("pass_emit_ret: bad return type: %d",
 			    rety->it_op);
 	}
-	if ((struct ir_insn *)ret != TAILQ_LAST(&fn->if_iq, ir_insnq))
+	if (ret->i_flags & IR_RET_NOFRAME)
+		emitf("\tblr\n");
+	else if ((struct ir_insn *)ret != TAILQ_LAST(&fn->if_iq, ir_insnq))
 		emitf("\tb\t.L%d\n", fn->if_retlab);
 }
 
@@ -0,0 +1,50 @@
+int ncalls;
+
+int
+id(int a)
+{
+	ncalls++;
+	return a;
+}
+
+int
+twice(int a)
+{
+	ncalls++;
+	return a * 2;
+}
+
+int
+sub(int a, int b)
+{
+	return a - b;
+}
+
+int
+mix(int a, int b, int c, int d, int e, int f)
+{
+	return a * 100000 + b * 10000 + c * 1000 + d * 100 + e * 10 + f;
+}
+
+int
+main(void)
+{
+	int x, y, r;
+
+	x = 3;
+	y = 4;
+	r = 0;
+	if (sub(id(x), twice(y)) != -5)
+		r = r + 1;
+	if (sub(x, id(y)) != -1)
+		r = r + 2;
+	if (sub(twice(x), y) != 2)
+		r = r + 4;
+	if (mix(1, id(2), x, twice(2), id(twice(y)) - 3, 5) != 123455)
+		r = r + 8;
+	if (sub(sub(id(9), x), sub(y, twice(1))) != 4)
+		r = r + 16;
+	if (ncalls != 10)
+		r = r + 32;
+	return r;
+}
@@ -0,0 +1,35 @@
+int
+g(int x)
+{
+	return x + 1;
+}
+
+int
+f(int a, int b)
+{
+	return a + b;
+}
+
+int
+f3(int a, int b, int c)
+{
+	return a * 100 + b * 10 + c;
+}
+
+int
+h(int x)
+{
+	return f(0, g(x));
+}
+
+int
+k(int x)
+{
+	return f3(1, 2, g(x));
+}
+
+int
+main(void)
+{
+	return h(4) + k(0) - 126;
+}
@@ -0,0 +1,21 @@
+#!/bin/sh
+
+c=../lang.c/c_`uname -m`
+
+# The constant arguments in callarg0001.c must be assigned after the
+# nested call to g, so only the result of g is live right after it.
+rm -f CFG.callarg0001.* DFA.LIVE.callarg0001.* IR.callarg0001.* RA.callarg0001.*
+$c -I callarg0001.c > /dev/null || exit 1
+for f in DFA.LIVE.callarg0001.c.*.h DFA.LIVE.callarg0001.c.*.k; do
+	awk '
+		/= call g/ { call = 1; next }
+		call && /^#/ {
+			if (NF != 2) {
+				print FILENAME ": live across g:" $0
+				bad = 1
+			}
+			call = 0
+		}
+		END { exit bad }
+	' $f || exit 1
+done
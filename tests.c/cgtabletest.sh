@@ -0,0 +1,29 @@
+#!/bin/sh
+
+arch=`uname -p`
+c=../lang.c/c_$arch
+grammar=../$arch/$arch.cgg
+
+# Loading the machine grammar with -G must select the same instructions
+# as the tables compiled into the compiler. This needs a compiler built
+# with CGGFLAGS="-a -i" and cgg in the PATH or in $CGG.
+rm -f CGTAB.*
+$c -G $grammar callarg0000.c > CGTAB.s 2> CGTAB.err || {
+	if grep -q 'cgg -i' CGTAB.err; then
+		echo "compiler not built with cgg -i"
+		exit 0
+	fi
+	cat CGTAB.err
+	exit 1
+}
+for f in callarg0000.c costmodel0000.c ralloc0011.c stdarg0000.c \
+    switch0000.c; do
+	for o in -Ospeed -Os; do
+		$c $o $f > CGTAB.compiled.s || exit 1
+		$c -G $grammar $o $f > CGTAB.loaded.s || exit 1
+		cmp -s CGTAB.compiled.s CGTAB.loaded.s || {
+			echo "$f $o: -G $grammar selects other instructions"
+			exit 1
+		}
+	done
+done
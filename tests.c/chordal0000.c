@@ -0,0 +1,109 @@
+/*
+ * Meant for -C: loop carried values, values live across calls and
+ * swaps that need parallel copies out of the phis. The allocator
+ * skips functions that multiply or subtract, so results are passed
+ * back in globals instead of being combined.
+ */
+
+int ga, gb;
+
+int
+id(int a)
+{
+	return a;
+}
+
+int
+fib(int n)
+{
+	int a, b, t;
+
+	a = 0;
+	b = 1;
+	while (n > 0) {
+		t = a + b;
+		a = b;
+		b = t;
+		n--;
+	}
+	return a;
+}
+
+int
+swaps(int n)
+{
+	int a, b, c, t;
+
+	a = 1;
+	b = 2;
+	c = 3;
+	while (n > 0) {
+		t = a;
+		a = b;
+		b = c;
+		c = t;
+		n--;
+	}
+	ga = a;
+	gb = b;
+	return c;
+}
+
+int
+acrosscalls(int n)
+{
+	int a, b, c, d, e, f, i;
+
+	a = n;
+	b = n + 1;
+	c = n + 2;
+	d = n + 3;
+	e = n + 4;
+	f = n + 5;
+	for (i = 0; i < 3; i++) {
+		a = a + id(b);
+		b = b + id(c);
+		c = c + id(d);
+	}
+	return a + b + c + d + e + f;
+}
+
+int
+branches(int n, int m)
+{
+	int r, s;
+
+	r = 0;
+	s = 0;
+	while (n > 0) {
+		if (n > m) {
+			r = r + n;
+			s = id(s) + 1;
+		} else {
+			r = r + m;
+			s = s + 2;
+		}
+		n--;
+	}
+	ga = s;
+	return r;
+}
+
+int
+main(void)
+{
+	int r;
+
+	r = 0;
+	if (fib(10) != 55)
+		r = r + 1;
+	if (swaps(4) != 1 || ga != 2 || gb != 3)
+		r = r + 2;
+	if (swaps(0) != 3 || ga != 1 || gb != 2)
+		r = r + 2;
+	if (acrosscalls(1) != 73)
+		r = r + 4;
+	if (branches(5, 3) != 18 || ga != 8)
+		r = r + 8;
+	return r;
+}
@@ -0,0 +1,104 @@
+int g;
+
+int
+lt(int a, int b)
+{
+	return a < b;
+}
+
+int
+both(int a, int b)
+{
+	return a && b;
+}
+
+int
+either(int a, int b)
+{
+	return a > 0 || b > 0;
+}
+
+int
+not(int a)
+{
+	return !a;
+}
+
+int *
+ptr(int *p, int a)
+{
+	if (a == 0 && p != 0)
+		return p;
+	return 0;
+}
+
+double
+dlt(double a, double b)
+{
+	return a < b;
+}
+
+int
+sel(int a, int b, int c)
+{
+	if (a ? b : c)
+		return 1;
+	return 0;
+}
+
+int
+comma(int a)
+{
+	if (g = a, g != 0)
+		return 2;
+	return 3;
+}
+
+int
+cons(int a)
+{
+	if (1)
+		a++;
+	if (0)
+		a--;
+	while (0)
+		a = 0;
+	return a;
+}
+
+int
+eqzero(int a, int b)
+{
+	if ((a < b) == 0)
+		return 4;
+	if ((a < b) != 0)
+		return 5;
+	return 6;
+}
+
+int
+main(void)
+{
+	int r;
+
+	r = 0;
+	if (lt(1, 2) != 1 || lt(2, 1) != 0)
+		r = r + 1;
+	if (both(1, 2) != 1 || both(0, 2) != 0 || both(2, 0) != 0)
+		r = r + 2;
+	if (either(0, 1) != 1 || either(1, 0) != 1 || either(0, 0) != 0)
+		r = r + 4;
+	if (not(0) != 1 || not(7) != 0)
+		r = r + 8;
+	if (ptr(&g, 0) != &g || ptr(&g, 1) != 0)
+		r = r + 16;
+	if (sel(1, 1, 0) != 1 || sel(1, 0, 1) != 0 || sel(0, 0, 1) != 1)
+		r = r + 32;
+	if (comma(5) != 2 || g != 5 || comma(0) != 3 || g != 0)
+		r = r + 64;
+	if (cons(1) != 2)
+		r = r + 128;
+	if (eqzero(2, 1) != 4 || eqzero(1, 2) != 5)
+		r = r + 256;
+	return r;
+}
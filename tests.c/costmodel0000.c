@@ -0,0 +1,37 @@
+int
+inc(int a)
+{
+	int b;
+
+	b = a + 1;
+	return b;
+}
+
+int
+add(int a, int b)
+{
+	int c;
+
+	c = a + b;
+	return c + a;
+}
+
+int
+mul3(int a)
+{
+	return a * 3;
+}
+
+int
+mul5(int a)
+{
+	return a * 5;
+}
+
+int
+main(void)
+{
+	if (inc(1) != 2 || add(2, 3) != 7 || mul3(4) != 12 || mul5(3) != 15)
+		return 1;
+	return 0;
+}
@@ -0,0 +1,33 @@
+#!/bin/sh
+
+arch=`uname -p`
+c=../lang.c/c_$arch
+
+# The speed and size models must select different instructions for
+# costmodel0000.c: lea vs. inc on amd64, shift and add vs. mulli on
+# powerpc.
+rm -f COST.*
+$c -Ospeed costmodel0000.c > COST.speed.s || exit 1
+$c -Os costmodel0000.c > COST.size.s || exit 1
+case $arch in
+amd64)
+	fast='leal'
+	small='incl'
+	;;
+powerpc)
+	fast='slwi'
+	small='mulli'
+	;;
+*)
+	echo "no cost model test for $arch"
+	exit 0
+	;;
+esac
+grep -q $fast COST.speed.s && ! grep -q $small COST.speed.s || {
+	echo "-Ospeed: expected $fast, not $small"
+	exit 1
+}
+grep -q $small COST.size.s && ! grep -q $fast COST.size.s || {
+	echo "-Os: expected $small, not $fast"
+	exit 1
+}
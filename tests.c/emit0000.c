@@ -0,0 +1,78 @@
+char *strs[] = { "abc", "d\te\n" };
+int arr[8];
+
+int
+id(int x)
+{
+	return x;
+}
+
+int
+consts(int x)
+{
+	int r;
+
+	r = 0;
+	if (x + 2147483647 != -2147483647 - 1 + x - 1)
+		r = r + 1;
+	if ((x & 65535) != 0 || (x | 65535) != 65535)
+		r = r + 2;
+	if (x - -1 != 1 || x * -7 != 0)
+		r = r + 4;
+	if ((unsigned)x + 4294967295U != 4294967295U)
+		r = r + 8;
+	if ((x ^ 0x12345678) != 305419896)
+		r = r + 16;
+	return r;
+}
+
+int
+sw(int x)
+{
+	switch (x) {
+	case -1:
+		return 10;
+	case 0:
+		return 20;
+	case 65536:
+		return 30;
+	case 'a':
+		return 40;
+	default:
+		return 50;
+	}
+}
+
+int
+frame(int n)
+{
+	int a[6], i, s;
+
+	for (i = 0; i < 6; i++)
+		a[i] = n + i;
+	s = 0;
+	for (i = 5; i >= 0; i--)
+		s = s * 2 + a[i];
+	return s;
+}
+
+int
+main(void)
+{
+	if (consts(id(0)) != 0)
+		return 1;
+	if (sw(id(-1)) != 10 || sw(id(0)) != 20 || sw(id(65536)) != 30 ||
+	    sw(id(97)) != 40 || sw(id(2)) != 50)
+		return 2;
+	if (strs[0][2] != 'c' || strs[1][1] != '\t' || strs[1][3] != '\n')
+		return 3;
+	if (frame(1) != 1 + 2 * 2 + 4 * 3 + 8 * 4 + 16 * 5 + 32 * 6)
+		return 4;
+	arr[3] = 7;
+	arr[7] = -8;
+	if (*(arr + 3) + arr[id(7)] != -1)
+		return 6;
+	if (id(-128) != -128 || (char)id(200) != (char)200)
+		return 5;
+	return 0;
+}
@@ -0,0 +1,38 @@
+static int
+twice(int x)
+{
+	return x + x;
+}
+
+static int
+unused(int x)
+{
+	return x - 1;
+}
+
+static int
+inc(int x)
+{
+	return x + 1;
+}
+
+int (*incp)(int) = inc;
+
+int
+f(int a, int b)
+{
+	int s;
+
+	s = a + b;
+	return s + twice(b);
+}
+
+int
+main(void)
+{
+	if (f(3, 4) != 15)
+		return 1;
+	if (incp == 0)
+		return 2;
+	return 0;
+}
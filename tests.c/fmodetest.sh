@@ -0,0 +1,32 @@
+#!/bin/sh
+
+c=../lang.c/c_`uname -m`
+
+# With -f, twice() and inc() in fmode0000.c are compiled before they
+# are used and must still be emitted, once each. unused() must not be.
+# The same functions must be emitted as without -f. twice() is defined
+# before f(), so f() can use its register summary and must get the same
+# code as without -f.
+rm -f FMODE.*
+$c fmode0000.c > FMODE.whole.s || exit 1
+$c -f fmode0000.c > FMODE.stream.s || exit 1
+awk '$1 == ".type" && $3 == "@function" { print $2 }' FMODE.whole.s |
+    sort > FMODE.whole
+awk '$1 == ".type" && $3 == "@function" { print $2 }' FMODE.stream.s |
+    sort > FMODE.stream
+printf 'f,\ninc,\nmain,\ntwice,\n' | cmp -s - FMODE.stream || {
+	echo "-f: wrong functions emitted"
+	exit 1
+}
+cmp -s FMODE.whole FMODE.stream || {
+	echo "-f: other functions emitted than without -f"
+	exit 1
+}
+for m in whole stream; do
+	awk '/^f:/ { p = 1 } p { gsub(/\.L[0-9]+/, ".L"); print }
+	    p && /\.size/ { exit }' FMODE.$m.s > FMODE.$m.f
+done
+cmp -s FMODE.whole.f FMODE.stream.f || {
+	echo "-f: different code for f"
+	exit 1
+}
@@ -0,0 +1,95 @@
+#!/bin/sh
+
+cgg=${CGG:-cgg}
+
+# Patterns that use the same named or inline action share one case in
+# cg_actionemit, patterns with the same emit string share one bytecode
+# array and a named cost gives each of its patterns the same costs.
+# Needs cgg in the PATH or in $CGG.
+if ! command -v $cgg > /dev/null 2>&1; then
+	echo "no cgg"
+	exit 0
+fi
+rm -f FRAG*
+cat > FRAG.cgg << 'END'
+%costmodel speed, size
+
+%action same { f(&nctx) }
+%cost cheap { speed: 2, size: 3 }
+%emit mov { "\tmov\t@R, @L\n" }
+
+%nonterm insn, r
+
+%%
+
+insn:	IR_ASG(r, r) emit mov action same
+	| IR_ST(r, r) emit { "\tmov\t@R, @L\n" } action { f(&nctx); }
+	| IR_B cost cheap emit { "\tjmp\t@T\n" }
+	;
+
+r:	IR_REG
+	| IR_ICON cost cheap action same
+	;
+
+%%
+END
+$cgg FRAG.cgg FRAG.c FRAG.h || exit 1
+awk '
+	/^static u_char cg_emit_[0-9]*\[\]/ {
+		nemit++
+	}
+	/^u_char \*cg_emitstrs\[\]/ {
+		emitstrs = 1
+		next
+	}
+	emitstrs && /^};/ {
+		emitstrs = 0
+	}
+	emitstrs && /cg_emit_/ {
+		emitof[n++] = $1
+	}
+	/^cg_actionemit\(/ {
+		actions = 1
+	}
+	actions && /^}/ {
+		actions = 0
+	}
+	actions && /break;/ {
+		nbody++
+	}
+	/^short cg_pattern_cost/ {
+		costs = 1
+		next
+	}
+	costs && /^};/ {
+		costs = 0
+	}
+	costs && /\/\* [0-9]* \*\// {
+		cost[$6] = $2 $3
+	}
+	END {
+		if (nemit != 2 || emitof[0] != emitof[1]) {
+			print "emit strings not shared"
+			exit 1
+		}
+		if (nbody != 1) {
+			print "actions not shared"
+			exit 1
+		}
+		if (cost[2] != "2,3" || cost[4] != "2,3" || cost[0] != "1,1") {
+			print "named cost not applied"
+			exit 1
+		}
+	}
+' FRAG.c || exit 1
+
+# A pattern that refers to an undeclared fragment is an error.
+sed 's/) emit mov/) emit nosuch/' FRAG.cgg > FRAG.bad.cgg
+if $cgg FRAG.bad.cgg FRAG.bad.c FRAG.bad.h 2> FRAG.err; then
+	echo "unknown fragment accepted"
+	exit 1
+fi
+grep -q 'unknown emit fragment: nosuch' FRAG.err || {
+	cat FRAG.err
+	exit 1
+}
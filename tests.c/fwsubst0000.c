@@ -0,0 +1,68 @@
+volatile int v;
+int g;
+
+int
+bump(void)
+{
+	g++;
+	return g;
+}
+
+int
+overstore(int *p)
+{
+	int t;
+
+	t = *p;
+	*p = 5;
+	return t;
+}
+
+int
+overcall(void)
+{
+	int t;
+
+	t = g;
+	bump();
+	return t;
+}
+
+int
+volat(void)
+{
+	int t, u;
+
+	t = v;
+	u = v;
+	return u - t;
+}
+
+int
+single(int a, int b)
+{
+	int t;
+
+	t = a * b;
+	return t + 1;
+}
+
+int
+main(void)
+{
+	int x, r;
+
+	x = 7;
+	g = 1;
+	v = 3;
+	r = 0;
+	if (overstore(&x) != 7 || x != 5)
+		r = r + 1;
+	if (overcall() != 1 || g != 2)
+		r = r + 2;
+	if (volat() != 0)
+		r = r + 4;
+	if (single(3, 4) != 13)
+		r = r + 8;
+	return r;
+}
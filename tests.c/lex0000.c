@@ -0,0 +1,138 @@
+int integer, ifx, do_, returned, sizeofx, unsignedness, L, Long;
+
+struct s {
+	int	a;
+};
+
+int
+sum(int n, ...)
+{
+	return n;
+}
+
+int
+chars(void)
+{
+	int r;
+
+	r = 0;
+	if ('a' != 97 || '\n' != 10 || '\t' != 9 || '\0' != 0)
+		r = r + 1;
+	if ('\\' != 92 || '\'' != 39 || '"' != 34 || '\?' != 63)
+		r = r + 2;
+	if ('\101' != 65 || '\x41' != 65 || '\7' != 7 || '\x7f' != 127)
+		r = r + 4;
+	if (L'a' != 97 || '\a' != 7 || '\v' != 11 || '\f' != 12)
+		r = r + 8;
+	return r;
+}
+
+int
+strings(void)
+{
+	char *p, *q;
+	int r;
+
+	r = 0;
+	p = "ab" "cd";
+	if (p[0] != 'a' || p[3] != 'd' || p[4] != 0)
+		r = r + 1;
+	q = "\x41\102\n\"\\";
+	if (q[0] != 'A' || q[1] != 'B' || q[2] != '\n' || q[3] != '"' ||
+	    q[4] != '\\' || q[5] != 0)
+		r = r + 2;
+	p = "a\0b";
+	if (p[1] != 0 || p[2] != 'b' || p[3] != 0)
+		r = r + 4;
+	return r;
+}
+
+int
+ints(void)
+{
+	int r;
+
+	r = 0;
+	if (0x1F != 31 || 0X1f != 31 || 017 != 15 || 0 != 00)
+		r = r + 1;
+	if (sizeof(10L) != sizeof(long) || sizeof(10LL) != sizeof(long long) ||
+	    sizeof(10ul) != sizeof(long) || sizeof(10) != sizeof(int))
+		r = r + 2;
+	if (sizeof(0x80000000) != sizeof(int) || 0x80000000 < 0 ||
+	    sizeof(4294967296) != sizeof(long long))
+		r = r + 4;
+	if (-1u < 0 || 10U != 10 || 0xffffffffu != 4294967295U)
+		r = r + 8;
+	return r;
+}
+
+int
+ops(void)
+{
+	struct s s, *sp;
+	int a, b, r;
+
+	r = 0;
+	sp = &s;
+	sp->a = 1;
+	a = 4;
+	b = 2;
+	if (a != 4 || a+++b != 6 || a != 5 || a---b != 3 || a != 4)
+		r = r + 1;
+	a &= 6;
+	a |= 1;
+	a ^= 2;
+	a -= 4;
+	if (a != 3 || !(a&&b) || (a&b) != 2 || (a|b) != 3 || (a^b) != 1)
+		r = r + 2;
+	if (sp->a != 1 || (*sp).a != 1 || sum(3, a, b) != 3 || a<=b ||
+	    !(a>=b) || a==b || !(a!=b))
+		r = r + 4;
+
+	/* Not evaluated, shifts and divisions are folded. */
+	if (sizeof(a <<= 1) != sizeof(int) || sizeof(a >>= 1) != sizeof(int) ||
+	    sizeof(a /= 1) != sizeof(int) || sizeof(a %= 1) != sizeof(int) ||
+	    (1<<3>>1) != 4 || 7/2 != 3 || 7%4 != 3)
+		r = r + 8;
+	a *= 2;
+	a -= 3;
+	a += 2;
+	if (a != 5 || (b ? a : b) != 5 || (a-b) != 3)
+		r = r + 16;
+	return r;
+}
+
+#line 100 "lexline.c"
+int
+names(void)
+{
+	integer = 1;
+	ifx = 2;
+	do_ = 3;
+	returned = 4;
+	sizeofx = 5;
+	unsignedness = 6;
+	L = 7;
+	Long = 8;
+	return integer + ifx + do_ + returned + sizeofx + unsignedness + L +
+	    Long;
+}
+
+int
+main(void)
+{
+	int r;
+
+	r = 0;
+	if (chars() != 0)
+		r = r + 1;
+	if (strings() != 0)
+		r = r + 2;
+	if (ints() != 0)
+		r = r + 4;
+	if (ops() != 0)
+		r = r + 8;
+	if (names() != 36)
+		r = r + 16;
+	return r;
+}
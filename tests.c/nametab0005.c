@@ -0,0 +1,61 @@
+#define CAT_(a, b)	a##b
+#define CAT(a, b)	CAT_(a, b)
+#define X16(p)	int CAT(p, 0), CAT(p, 1), CAT(p, 2), CAT(p, 3), \
+		CAT(p, 4), CAT(p, 5), CAT(p, 6), CAT(p, 7), \
+		CAT(p, 8), CAT(p, 9), CAT(p, a), CAT(p, b), \
+		CAT(p, c), CAT(p, d), CAT(p, e), CAT(p, f);
+#define X256(p)	X16(CAT(p, 0)) X16(CAT(p, 1)) X16(CAT(p, 2)) X16(CAT(p, 3)) \
+		X16(CAT(p, 4)) X16(CAT(p, 5)) X16(CAT(p, 6)) X16(CAT(p, 7)) \
+		X16(CAT(p, 8)) X16(CAT(p, 9)) X16(CAT(p, a)) X16(CAT(p, b)) \
+		X16(CAT(p, c)) X16(CAT(p, d)) X16(CAT(p, e)) X16(CAT(p, f))
+
+/* More names than fit into the initial table. */
+X256(v0)
+X256(v1)
+X256(v2)
+X256(v3)
+X256(v4)
+X256(v5)
+X256(v6)
+X256(v7)
+X256(v8)
+X256(v9)
+X256(va)
+X256(vb)
+
+/* Names that differ only in their last character or in their length. */
+int v, v0, v00, v000, v0000, v00000;
+int abcdefghijklmnopqrstuvwxyz0, abcdefghijklmnopqrstuvwxyz1;
+
+/* Names longer than an arena block can hold. */
+#define D1(a)	CAT(a, a)
+#define D4(a)	D1(D1(D1(D1(a))))
+#define D12(a)	D4(D4(D4(a)))
+int D12(long_name_);
+int CAT(D12(long_name_), x);
+
+int
+main(void)
+{
+	v000 = 1;
+	v0000 = 2;
+	v0000 = v0000 + v000;
+	v00000 = 3;
+	vb00 = 4;
+	vbff = 5;
+	v5a3 = 6;
+	abcdefghijklmnopqrstuvwxyz0 = 7;
+	abcdefghijklmnopqrstuvwxyz1 = 8;
+	D12(long_name_) = 9;
+	CAT(D12(long_name_), x) = 10;
+	if (v != 0 || v0 != 0 || v00 != 0 || v000 != 1 || v0000 != 3)
+		return 1;
+	if (v00000 != 3 || vb00 != 4 || vbff != 5 || v5a3 != 6)
+		return 2;
+	if (abcdefghijklmnopqrstuvwxyz0 != 7 ||
+	    abcdefghijklmnopqrstuvwxyz1 != 8)
+		return 3;
+	if (D12(long_name_) != 9 || CAT(D12(long_name_), x) != 10)
+		return 4;
+	return 0;
+}
@@ -0,0 +1,40 @@
+#!/bin/sh
+
+c=../lang.c/c_`uname -m`
+
+# A compiler built with CGGFLAGS="-a -p" writes its pattern counters
+# with -S. The nterm records are the totals of the patterns of each
+# nonterminal, so both must add up to the same counts.
+rm -f CG.costmodel0000.c.*
+$c -S costmodel0000.c > /dev/null 2>&1 || exit 1
+p=CG.costmodel0000.c.0000.profile
+if [ ! -f $p ]; then
+	echo "compiler not built with cgg -p"
+	exit 0
+fi
+awk '
+	NR == 1 && $0 != "# kind\tid\tuses\temits\ttries\twins\tname" {
+		print "bad header: " $0
+		exit 1
+	}
+	$1 == "pattern" || $1 == "chain" {
+		for (i = 3; i <= 6; i++)
+			pat[i] += $i
+	}
+	$1 == "nterm" {
+		for (i = 3; i <= 6; i++)
+			nt[i] += $i
+	}
+	END {
+		if (pat[4] == 0) {
+			print "no instructions emitted"
+			exit 1
+		}
+		for (i = 3; i <= 6; i++) {
+			if (pat[i] != nt[i]) {
+				print "pattern and nterm counts differ"
+				exit 1
+			}
+		}
+	}
+' $p
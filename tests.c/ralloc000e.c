@@ -0,0 +1,34 @@
+int puts(const char *);
+int arr[8];
+int res;
+
+void
+cold(int x)
+{
+	if (x < 0)
+		puts("neg");
+}
+
+void
+f(int *a, int n, int k)
+{
+	int i, s;
+
+	s = 0;
+	if (n > 4)
+		cold(k);
+	for (i = 0; i < n; i++)
+		s += a[i] * k;
+	res = s + k;
+}
+
+int
+main(void)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		arr[i] = i + 1;
+	f(arr, 8, 3);
+	return res;
+}
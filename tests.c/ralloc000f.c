@@ -0,0 +1,42 @@
+int arr[8];
+int res;
+
+int
+id(int x)
+{
+	return x;
+}
+
+/* Nested loops, one loop after another and a loop with a call. */
+int
+f(int *a, int n, int k, int m)
+{
+	int i, j, s, t;
+
+	s = id(k);
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < n; j++)
+			s += a[j] * k;
+		s += m;
+	}
+	t = id(s);
+	for (i = 0; i < n; i++)
+		t += a[i] + m;
+	for (i = 0; i < n; i++) {
+		t += id(k);
+		for (j = 0; j < n; j++)
+			t += a[j] * m;
+	}
+	return s + t + k + m;
+}
+
+int
+main(void)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		arr[i] = i + 1;
+	res = f(arr, 8, 3, 2);
+	return res & 0xff;
+}
@@ -0,0 +1,28 @@
+int res;
+
+/*
+ * A leaf that only clobbers its argument and return registers. On
+ * amd64, a stays in a volatile register other than %edi across the call
+ * and f saves no callee-saved register.
+ */
+static int
+twice(int x)
+{
+	return x + x;
+}
+
+int
+f(int a, int b)
+{
+	int s;
+
+	s = a + b;
+	res = twice(b);
+	return s + res;
+}
+
+int
+main(void)
+{
+	return f(3, 4);
+}
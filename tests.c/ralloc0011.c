@@ -0,0 +1,33 @@
+int v[40];
+
+int
+f(void)
+{
+	int a, b, c, d, e, g, h, i, j, k, l, m, n, o, p, q;
+	int r, s;
+
+	a = v[0]; b = v[1]; c = v[2]; d = v[3];
+	e = v[4]; g = v[5]; h = v[6]; i = v[7];
+	j = v[8]; k = v[9]; l = v[10]; m = v[11];
+	n = v[12]; o = v[13]; p = v[14]; q = v[15];
+	r = a + b + c + d + e + g + h + i + j + k + l + m + n + o + p + q;
+	r = r + a + b + c + d + e + g + h + i + j + k + l + m + n + o + p + q;
+
+	a = v[20] + r; b = v[21] + r; c = v[22] + r; d = v[23] + r;
+	e = v[24] + r; g = v[25] + r; h = v[26] + r; i = v[27] + r;
+	j = v[28] + r; k = v[29] + r; l = v[30] + r; m = v[31] + r;
+	n = v[32] + r; o = v[33] + r; p = v[34] + r; q = v[35] + r;
+	s = a + b + c + d + e + g + h + i + j + k + l + m + n + o + p + q;
+	s = s + a + b + c + d + e + g + h + i + j + k + l + m + n + o + p + q;
+	return r + s;
+}
+
+int
+main(void)
+{
+	int i;
+
+	for (i = 0; i < 40; i++)
+		v[i] = i;
+	return f() == 2 * 120 + 2 * 440 + 32 * 240 ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+struct s;
+
+extern const struct s cs;
+extern const struct s cs;
+extern const struct s *csp;
+extern const struct s *csp;
+extern volatile struct s *vsp[2];
+extern volatile struct s *vsp[2];
+
+extern int arr[];
+extern int arr[];
+extern int *const *pp[3];
+extern int *const *pp[3];
+extern const char *const names[];
+extern const char *const names[];
+
+int fn(int *const p[2], const char *, volatile struct s *);
+int fn(int *const p[2], const char *, volatile struct s *);
+
+struct s {
+	int a;
+	int b;
+};
+
+extern const struct s cs;
+extern const struct s *csp;
+extern volatile struct s *vsp[2];
+const struct s cs = { 1, 2 };
+const struct s *csp = &cs;
+volatile struct s *vsp[2];
+
+int arr[4] = { 1, 2, 3, 4 };
+extern int arr[4];
+extern int arr[];
+int *const *pp[3];
+extern int *const *pp[3];
+const char *const names[] = { "a", "bc" };
+extern const char *const names[2];
+
+int fn(int *const p[2], const char *, volatile struct s *);
+
+int
+fn(int *const p[2], const char *s, volatile struct s *v)
+{
+	return *p[0] + *p[1] + s[0] + v->a;
+}
+
+int
+main(void)
+{
+	int x, y;
+	int *const ptrs[2] = { &x, &y };
+	const struct s *lp;
+	volatile struct s vs;
+
+	x = 1;
+	y = 2;
+	lp = csp;
+	vs.a = arr[3];
+	vsp[0] = &vs;
+	if (fn(ptrs, names[1], vsp[0]) != 1 + 2 + 'b' + 4)
+		return 1;
+	if (lp->b + sizeof cs != 2 + sizeof(struct s))
+		return 2;
+	if (sizeof arr != 4 * sizeof(int) || sizeof names != 2 * sizeof(char *))
+		return 3;
+	return 0;
+}
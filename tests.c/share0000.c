@@ -0,0 +1,37 @@
+volatile int v;
+int a[4];
+
+int
+common(int x, int y)
+{
+	return x * y + x * y;
+}
+
+int
+loads(int *p, int i)
+{
+	return p[i] + p[i] * p[i];
+}
+
+int
+volat(volatile int *p)
+{
+	return *p + *p + v + v;
+}
+
+int
+main(void)
+{
+	int r;
+
+	a[1] = 3;
+	v = 2;
+	r = 0;
+	if (common(3, 4) != 24)
+		r = r + 1;
+	if (loads(a, 1) != 12)
+		r = r + 2;
+	if (volat(&v) != 8)
+		r = r + 4;
+	return r;
+}
@@ -0,0 +1,33 @@
+int calls;
+
+int
+work(int n)
+{
+	calls++;
+	return n * 2;
+}
+
+int
+fast(int n, int *p)
+{
+	int buf[4];
+
+	if (n == 0)
+		return *p;
+	buf[0] = n;
+	buf[1] = work(n);
+	return buf[0] + buf[1];
+}
+
+int
+main(void)
+{
+	int x;
+
+	x = 7;
+	if (fast(0, &x) != 7)
+		return 1;
+	if (fast(3, &x) != 9 || calls != 1)
+		return 2;
+	return 0;
+}
@@ -0,0 +1,30 @@
+#!/bin/sh
+
+arch=`uname -p`
+c=../lang.c/c_$arch
+
+# The early return of fast() in shrinkwrap0000.c needs no stack frame,
+# so the prologue must not be executed before it.
+case $arch in
+amd64)
+	frame='push|%rbp|%rsp'
+	ret='ret'
+	;;
+powerpc)
+	frame='%r1|mflr'
+	ret='blr'
+	;;
+*)
+	echo "no shrink-wrapping test for $arch"
+	exit 0
+	;;
+esac
+rm -f SWRAP.*
+$c shrinkwrap0000.c > SWRAP.s || exit 1
+awk -v frame="$frame" -v ret="$ret" '
+	/^fast:/ { infast = 1; next }
+	!infast { next }
+	$0 ~ frame { print "frame used before the early return: " $0; bad = 1 }
+	$1 == ret { exit }
+	END { exit bad }
+' SWRAP.s
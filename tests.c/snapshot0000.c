@@ -0,0 +1,16 @@
+typedef unsigned int uint;
+typedef struct point {
+	int	x, y;
+} point;
+
+enum color { RED, GREEN = 5, BLUE };
+
+struct list {
+	struct	list *next;
+	int	val;
+};
+
+extern int nvals;
+
+int sum(struct list *);
+uint scale(uint, enum color);
@@ -0,0 +1,53 @@
+typedef unsigned int uint;
+typedef struct point {
+	int	x, y;
+} point;
+
+enum color { RED, GREEN = 5, BLUE };
+
+struct list {
+	struct	list *next;
+	int	val;
+};
+
+extern int nvals;
+
+int sum(struct list *);
+uint scale(uint, enum color);
+
+int nvals;
+
+int
+sum(struct list *l)
+{
+	int s;
+
+	for (s = 0; l != 0; l = l->next) {
+		s = s + l->val;
+		nvals++;
+	}
+	return s;
+}
+
+uint
+scale(uint u, enum color c)
+{
+	return u * c;
+}
+
+int
+main(void)
+{
+	struct list a, b;
+	point p;
+
+	a.next = &b;
+	a.val = 1;
+	b.next = 0;
+	b.val = 2;
+	p.x = sum(&a);
+	p.y = scale(2, BLUE);
+	if (p.x != 3 || p.y != 12 || nvals != 2 || GREEN != 5)
+		return 1;
+	return 0;
+}
@@ -0,0 +1,15 @@
+#!/bin/sh
+
+c=../lang.c/c_`uname -m`
+
+# snapshot0001.c must start with the text of snapshot0000.c.
+rm -f SNAP.*
+$c -f -w SNAP.snap snapshot0000.c > SNAP.0000.s || exit 1
+$c -f snapshot0001.c > SNAP.0001.s || exit 1
+$c -f -r SNAP.snap snapshot0001.c > SNAP.0001.r.s 2> SNAP.err || exit 1
+if [ -s SNAP.err ]
+then
+	cat SNAP.err
+	exit 1
+fi
+cmp SNAP.0001.s SNAP.0001.r.s
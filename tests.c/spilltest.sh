@@ -0,0 +1,22 @@
+#!/bin/sh
+
+arch=`uname -p`
+c=../lang.c/c_$arch
+
+# The values of the two halves of f() in ralloc0011.c are spilled on
+# amd64, and their live ranges do not overlap. Their stack slots must be
+# shared.
+case $arch in
+amd64)
+	;;
+*)
+	echo "no spill slot test for $arch"
+	exit 0
+	;;
+esac
+rm -f CFG.ralloc0011.* DFA.LIVE.ralloc0011.* IR.ralloc0011.* RA.ralloc0011.*
+$c -I ralloc0011.c > /dev/null || exit 1
+grep -q '^slot [0-9]* shares [0-9]*$' RA.ralloc0011.c.*.f || {
+	echo "no spill slots shared in f"
+	exit 1
+}
@@ -0,0 +1,53 @@
+typedef int T;
+enum e { A = 1, B = 2 };
+struct s {
+	int	x;
+};
+int x = 10;
+
+int
+scopes(int x)
+{
+	int r;
+
+	r = x;
+	{
+		typedef char T;
+		int x;
+
+		x = 100;
+		r = r + x + sizeof(T);
+		{
+			enum e { A = 5 };
+			struct s {
+				int	a, b;
+			} s;
+
+			s.a = A;
+			s.b = B;
+			r = r + s.a + s.b + sizeof(struct s);
+		}
+		r = r + A;
+	}
+	{
+		typedef long T;
+
+		r = r + sizeof(T);
+	}
+	return r + sizeof(T) + x;
+}
+
+int
+main(void)
+{
+	struct s s;
+	T t;
+
+	s.x = 3;
+	t = x;
+	if (scopes(s.x) != 3 + 100 + 1 + 5 + 2 + 8 + 1 + 8 + 4 + 3)
+		return 1;
+	if (t != 10 || sizeof(struct s) != sizeof(int))
+		return 2;
+	return 0;
+}
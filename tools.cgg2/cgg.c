@@ -32,11 +32,27 @@
  *
  * However, we directly generate code out of the trie instead of transforming
  * it into an automaton.
+ *
+ * With -a, the grammar is also normalized into rules whose trees have
+ * only one level, like in:
+ *
+ * Todd A. Proebsting: BURS Automata Generation
+ *
+ * Almost every leaf in our grammars carries a constraint, so we do not
+ * enumerate the states here. The compiler builds them on demand from the
+ * normalized rules, with the outcome of the constraints as part of the
+ * input of the automaton. Nodes matched by patterns with a dynamic cost
+ * are labeled by cg_match.
+ *
+ * With -t, only the normalized grammar is written out as a table, which
+ * a compiler generated with -i can load instead of its own rules.
  */
 
 #include <ctype.h>
 #include <err.h>
+#include <limits.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -78,9 +94,59 @@ static int nerrors;
 static int nterms;
 static int npatterns;
 static int gflag;
+static int iflag;
+static int pflag;
+int tflag;
 
 static SIMPLEQ_HEAD(, rule) rules = SIMPLEQ_HEAD_INITIALIZER(rules);
 
+/* A named action, cost or emit string. */
+struct fragment {
+	SIMPLEQ_ENTRY(fragment) f_link;
+	char	*f_name;
+	int	f_kind;
+	char	f_text[P_MAXSTR];
+};
+
+static SIMPLEQ_HEAD(, fragment) fragments =
+    SIMPLEQ_HEAD_INITIALIZER(fragments);
+
+static char *costmodels[P_MAXCOSTS];
+static int ncostmodels;
+#define NCOSTS	(ncostmodels > 0 ? ncostmodels : 1)
+
+#define NRULESMAX	4096
+#define PREDSMAX	32
+
+/*
+ * With -i, tables that a loaded grammar replaces are reached through
+ * pointers, and there is room for more nonterminals of its fragments.
+ */
+#define TABLE		iflag ? "static " : "", iflag ? "0" : ""
+#define INTERP_NTS	64
+
+/* A rule of the normalized grammar. */
+struct nrule {
+	short	n_nt;
+	short	n_op;			/* -1 for chain rules */
+	short	n_kids[T_MAXKIDS];	/* -1 if child is not matched */
+	short	n_cost[P_MAXCOSTS];
+	short	n_pattern;		/* -1 for pattern fragments */
+	short	n_pred;			/* -1 if unconstrained */
+};
+
+static struct nrule nrules[NRULESMAX];
+static int nnrules;
+static char *preds[PREDSMAX];
+static int npreds;
+static int nallnts;
+static int8_t dynops[MAXIDS];
+static int aflag;
+
+/* Slot of each nonterminal in struct cg_data, by operator. */
+static uint8_t *slots[MAXIDS];
+static int nslots;
+
 struct path {
 	struct	path *p_prev;
 	int	p_kid;
@@ -103,12 +169,27 @@ struct trie {
 static struct triehead trieh = SIMPLEQ_HEAD_INITIALIZER(trieh);
 static int trie_maxdepth;
 
+static int calc_slots(void);
+static void print_cg_slots(void);
 static void print_pattern_nts(void);
 static void print_cg_pattern_subtree(void);
 static int print_subtree_access(struct tree *t, struct path *, int, int);
 static void print_subtree_access_trailer(struct path *);
 static void print_cg_closures(void);
 static void print_cg_actionemit(void);
+static void print_cg_pattern_cost(void);
+static void print_cg_profile(void);
+static void print_cg_ntnames(void);
+static void print_emit(struct pattern *);
+static void print_lit(char *, size_t);
+static size_t unquote(struct pattern *, char *);
+static size_t trimcode(const char *, const char **);
+static int samecode(const char *, const char *);
+static void split_costs(void);
+static char *split_cost(struct pattern *, char *);
+static const char *costexpr(struct pattern *);
+static int constcost(struct pattern *, short *);
+static void emitbyte(const char *, ...);
 static void print_cg_match(void);
 static void print_cg_trie(struct triehead *, int);
 static void print_cg_term(struct trie *, int);
@@ -117,6 +198,8 @@ static int print_cg_chains(int, int, int);
 static void print_trie(struct triehead *, int);
 static void printgrammar(void);
 static void printtree(struct tree *);
+static void treestr(char *, size_t, struct tree *);
+static void treecat(char *, size_t, struct tree *);
 
 static void check_nterm_chains(void);
 static void check_chain(int, int);
@@ -126,6 +209,17 @@ static void build_trie(void);
 static struct triehead *trie_insert_tree(struct triehead *, struct trie **,
     struct tree *, int, int);
 
+static int normalize(void);
+static int normtree(struct tree *, int, int, const short *);
+static int predidx(const char *);
+static void print_automaton(FILE *);
+static void print_nrules(void);
+static void print_cg_predmask(void);
+static void print_cg_interp(void);
+static void print_table(void);
+static void print_table_leaves(struct tree *, char *, int);
+static void print_text(const char *, size_t);
+
 static int treecmp(const void *, const void *);
 
 static void *xmalloc(size_t);
@@ -140,11 +234,23 @@ main(int argc, char **argv)
 	int i;
 	FILE *hfp;
 
-	while ((ch = getopt(argc, argv, "g")) != -1) {
+	while ((ch = getopt(argc, argv, "agipt")) != -1) {
 		switch (ch) {
+		case 'a':
+			aflag = 1;
+			break;
 		case 'g':
 			gflag = 1;
 			break;
+		case 'i':
+			iflag = aflag = 1;
+			break;
+		case 'p':
+			pflag = 1;
+			break;
+		case 't':
+			tflag = 1;
+			break;
 		default:
 			usage();
 		}
@@ -152,25 +258,39 @@ main(int argc, char **argv)
 
 	argc -= optind;
 	argv += optind;
-	if (argc < 3)
+	if (argc < (tflag ? 2 : 3))
 		usage();
 	infile = argv[0];
 	cfile = argv[1];
-	hfile = argv[2];
 	if (freopen(infile, "r", stdin) == NULL)
 		err(1, "couldn't open %s", infile);
-	if (freopen(cfile, "w", stdout) == NULL)
+	if (strcmp(cfile, "-") != 0 && freopen(cfile, "w", stdout) == NULL)
 		err(1, "couldn't open %s", cfile);
+
+	/* The table for a compiler that interprets the grammar. */
+	if (tflag) {
+		parse();
+		if (nerrors)
+			return 1;
+		split_costs();
+		check_nterm_chains();
+		print_table();
+		return 0;
+	}
+
+	hfile = argv[2];
 	if ((hfp = fopen(hfile, "w")) == NULL)
 		err(1, "couldn't open %s", hfile);
 
 	fprintf(hfp, "#ifndef CG_H\n");
 	fprintf(hfp, "#define CG_H\n\n");
+	fprintf(hfp, "#include <stdint.h>\n\n");
 
 	parse();
 	if (nerrors)
 		return 1;
 
+	split_costs();
 	check_nterm_chains();
 
 	if (gflag) {
@@ -180,31 +300,80 @@ main(int argc, char **argv)
 	}
 
 	printf("#include \"cg.h\"");
+	if (pflag)
+		fprintf(hfp, "#define CG_PROFILE\n");
+	if (iflag)
+		fprintf(hfp, "#define CG_INTERP\n");
 	fprintf(hfp, "#define CG_MAXCOST\tSHRT_MAX\n");
 	fprintf(hfp, "#define CG_NTERMS\t%d\n", nterms);
-	fprintf(hfp, "\nstruct cg_data {\n\tshort\tcd_cost[CG_NTERMS];\n");
-	fprintf(hfp, "\tshort\tcd_pattern[CG_NTERMS];\n};\n");
+	fprintf(hfp, "#define CG_NSLOTS\t%d\n", calc_slots());
+	fprintf(hfp, "#define CG_NCOSTMODELS\t%d\n", NCOSTS);
+	fprintf(hfp, "#define CG_NPATTERNS\t%d\n", npatterns);
+	fprintf(hfp, "\nstruct cg_data {\n\tuint8_t\t*cd_slot;\n");
+	fprintf(hfp, "\tu_int\tcd_valid;\n");
+	fprintf(hfp, "\tshort\tcd_cost[CG_NSLOTS];\n");
+	fprintf(hfp, "\tshort\tcd_pattern[CG_NSLOTS];\n};\n");
+	fprintf(hfp, "\n#define CG_VALID(cd, nt)\t\t\t\t\t\t\\\n");
+	fprintf(hfp, "\t((cd)->cd_valid & 1U << (cd)->cd_slot[nt])\n");
+	fprintf(hfp, "#define CG_COST(cd, nt)\t\t\t\t\t\t\\\n");
+	fprintf(hfp, "\t(CG_VALID(cd, nt) ? "
+	    "(cd)->cd_cost[(cd)->cd_slot[nt]] : CG_MAXCOST)\n");
+	fprintf(hfp, "#define CG_PATTERN(cd, nt)\t\t\t\t\t\t\\\n");
+	fprintf(hfp, "\t(CG_VALID(cd, nt) ? "
+	    "(cd)->cd_pattern[(cd)->cd_slot[nt]] : -1)\n\n");
 	fprintf(hfp, "extern int cg_startnt;\n");
-	fprintf(hfp, "extern short *cg_nts[];\n");
-	fprintf(hfp, "extern short cg_pattern_nts[];\n");
-	fprintf(hfp, "extern int8_t cg_hasaction[];\n");
-	fprintf(hfp, "extern char *cg_emitstrs[];\n");
+	fprintf(hfp, "extern int cg_costmodel;\n");
+	fprintf(hfp, "extern char *cg_costmodels[];\n");
+	if (iflag) {
+		fprintf(hfp, "extern short **cg_nts;\n");
+		fprintf(hfp, "extern short *cg_pattern_nts;\n");
+		fprintf(hfp, "extern int8_t *cg_hasaction;\n");
+		fprintf(hfp, "extern u_char **cg_emitstrs;\n");
+		fprintf(hfp, "extern short (*cg_pattern_cost)"
+		    "[CG_NCOSTMODELS];\n");
+	} else {
+		fprintf(hfp, "extern short *cg_nts[];\n");
+		fprintf(hfp, "extern short cg_pattern_nts[];\n");
+		fprintf(hfp, "extern int8_t cg_hasaction[];\n");
+		fprintf(hfp, "extern u_char *cg_emitstrs[];\n");
+		fprintf(hfp, "extern short "
+		    "cg_pattern_cost[][CG_NCOSTMODELS];\n");
+	}
+	if (pflag || iflag)
+		fprintf(hfp, "extern char *cg_ntnames[];\n");
+	if (pflag) {
+		fprintf(hfp, "extern char *cg_pattern_names[];\n");
+		fprintf(hfp, "extern short cg_pattern_nt[];\n");
+		fprintf(hfp, "extern int8_t cg_pattern_chain[];\n");
+	}
 	fprintf(hfp, "CGI_IR **cg_pattern_subtree(CGI_IR **, int, int);\n");
 	fprintf(hfp, "CGI_IR *cg_actionemit(CGI_CTX *, CGI_IR *, CGI_IR *, "
 	    "int);\n");
 	fprintf(hfp, "int cg_addmatch(struct cg_data *, int, int, int);\n");
+	fprintf(hfp, "uint8_t *cg_slotmap(int);\n");
 
 	printf("\nint cg_startnt = %d;\n", 0);
+	printf("int cg_costmodel;\n");
+	printf("char *cg_costmodels[] = {");
+	for (i = 0; i < ncostmodels; i++)
+		printf(" \"%s\",", costmodels[i]);
+	printf(" NULL };\n");
 
 	for (i = 0; i < nterms; i++)
 		printf("\n#define CG_NT_%s\t%d", ntermnames[i], i);
 	printf("\n\n");
 
+	print_cg_slots();
 	collect_pattern_nts();
 	print_pattern_nts();
 	print_cg_pattern_subtree();
 	print_cg_closures();
 	print_cg_actionemit();
+	print_cg_pattern_cost();
+	if (pflag || iflag)
+		print_cg_ntnames();
+	if (pflag)
+		print_cg_profile();
 	build_trie();
 	if (gflag) {
 		printf("#if 0\n");
@@ -212,6 +381,10 @@ main(int argc, char **argv)
 		printf("#endif\n");
 	}
 	print_cg_match();
+	if (aflag && normalize())
+		print_automaton(hfp);
+	else if (iflag)
+		errx(1, "-i needs the automaton");
 	fprintf(hfp, "\n#endif /* CG_H */\n");
 	return 0;
 }
@@ -255,6 +428,93 @@ check_chain(int start, int nterm)
 	}
 }
 
+static void
+reach(uint8_t *map, int nterm)
+{
+	struct pattern *p;
+
+	if (map[nterm])
+		return;
+	map[nterm] = 1;
+	SIMPLEQ_FOREACH(p, &nonterms[nterm].n_chainpats, p_chlink)
+		reach(map, p->p_rule->r_nterm);
+}
+
+/*
+ * A node only needs room in its struct cg_data for the nonterminals that
+ * its operator can derive. Map them to slots. All other nonterminals map
+ * to slot CG_NSLOTS, whose bit in cd_valid is never set.
+ */
+static int
+calc_slots(void)
+{
+	int i, n, op;
+	struct pattern *p;
+	struct rule *r;
+
+	SIMPLEQ_FOREACH(r, &rules, r_glolink) {
+		SIMPLEQ_FOREACH(p, &r->r_patterns, p_rlink) {
+			if (p->p_tree->t_kind != T_TERM)
+				continue;
+			op = p->p_tree->t_id;
+			if (slots[op] == NULL)
+				slots[op] = xcalloc(nterms, sizeof *slots[op]);
+			reach(slots[op], r->r_nterm);
+		}
+	}
+	for (op = 0; op < MAXIDS; op++) {
+		if (slots[op] == NULL)
+			continue;
+		for (i = n = 0; i < nterms; i++)
+			slots[op][i] = slots[op][i] ? n++ : UCHAR_MAX;
+		if (n > nslots)
+			nslots = n;
+	}
+	if (nslots >= sizeof(u_int) * 8)
+		errx(1, "too many nonterminals per operator: %d", nslots);
+	for (op = 0; op < MAXIDS; op++) {
+		for (i = 0; slots[op] != NULL && i < nterms; i++) {
+			if (slots[op][i] == UCHAR_MAX)
+				slots[op][i] = nslots;
+		}
+	}
+	return nslots;
+}
+
+static void
+print_cg_slots(void)
+{
+	int i, op;
+
+	for (op = 0; op < MAXIDS; op++) {
+		if (slots[op] == NULL)
+			continue;
+		printf("static uint8_t cg_slots_%s[] = {", treenames[op]);
+		for (i = 0; i < nterms; i++) {
+			printf("%s%d", i == 0 ? "\n\t" :
+			    i % 16 ? ", " : ",\n\t", slots[op][i]);
+		}
+		printf("\n};\n\n");
+	}
+	printf("static uint8_t cg_noslots[] = {");
+	for (i = 0; i < nterms; i++) {
+		printf("%sCG_NSLOTS", i == 0 ? "\n\t" :
+		    i % 6 ? ", " : ",\n\t");
+	}
+	printf("\n};\n");
+
+	printf("\nuint8_t *\ncg_slotmap(int op)\n{\n");
+	printf("\tswitch (op) {\n");
+	for (op = 0; op < MAXIDS; op++) {
+		if (slots[op] == NULL)
+			continue;
+		printf("\tcase %s:\n", treenames[op]);
+		printf("\t\treturn cg_slots_%s;\n", treenames[op]);
+	}
+	printf("\tdefault:\n\t\treturn cg_noslots;\n");
+	printf("\t}\n}\n\n");
+}
+
 /*
  * Collect which nonterminals each pattern uses. The sequence of nonterminals
  * is in prefix order.
@@ -508,7 +768,7 @@ print_pattern_nts(void)
 		printf("-1 };\n");
 	}
 
-	printf("\nshort *cg_nts[] = {\n\t");
+	printf("\n%sshort *cg_nts%s[] = {\n\t", TABLE);
 	for (i = 0, j = 8; i < nnts; i++) {
 		if (ntsseq[i]->n_sufof != -1) {
 			printf("&cg_nts%d[%d]",
@@ -528,7 +788,9 @@ print_pattern_nts(void)
 		}
 	}
 	printf("\n};\n\n");
-	printf("short cg_pattern_nts[%d] = {\n\t", npatterns);
+	if (iflag)
+		printf("short **cg_nts = cg_nts0;\n\n");
+	printf("%sshort cg_pattern_nts%s[%d] = {\n\t", TABLE, npatterns);
 	i = j = 0;
 	SIMPLEQ_FOREACH(r, &rules, r_glolink) {
 		SIMPLEQ_FOREACH(p, &r->r_patterns, p_rlink) {
@@ -549,6 +811,8 @@ print_pattern_nts(void)
 		}
 	}
 	printf("\n};\n");
+	if (iflag)
+		printf("short *cg_pattern_nts = cg_pattern_nts0;\n");
 }
 
 /*
@@ -657,9 +921,19 @@ print_cg_closures(void)
 		    ntermnames[i]);
 		printf("{\n");
 
-		printf("\tif (cost < cd->cd_cost[CG_NT_%s]) {\n", ntermnames[i]);
-		printf("\t\tcd->cd_cost[CG_NT_%s] = cost;\n", ntermnames[i]);
-		printf("\t\tcd->cd_pattern[CG_NT_%s] = p;\n", ntermnames[i]);
+		/* cg_addmatch() counts the tries for the profile. */
+		if (pflag)
+			printf("\tif (cg_addmatch(cd, CG_NT_%s, p, cost)) {\n",
+			    ntermnames[i]);
+		else {
+			printf("\tint s = cd->cd_slot[CG_NT_%s];\n\n",
+			    ntermnames[i]);
+			printf("\tif (!(cd->cd_valid & 1U << s) || "
+			    "cost < cd->cd_cost[s]) {\n");
+			printf("\t\tcd->cd_valid |= 1U << s;\n");
+			printf("\t\tcd->cd_cost[s] = cost;\n");
+			printf("\t\tcd->cd_pattern[s] = p;\n");
+		}
 		if (!SIMPLEQ_EMPTY(&nonterms[i].n_chainpats))
 			printf("\t\tcost++;\n");
 		SIMPLEQ_FOREACH(p, &nonterms[i].n_chainpats, p_chlink)
@@ -670,30 +944,53 @@ print_cg_closures(void)
 	}
 }
 
+/*
+ * Patterns with the same emit string share their bytecode and patterns
+ * with the same action share a case in cg_actionemit.
+ */
 static void
 print_cg_actionemit(void)
 {
 	int col = 78, val;
 	struct rule *r;
-	size_t i, nrest;
-	struct pattern *p;
-	struct pattern **rest;
+	size_t i, j, nrest;
+	struct pattern *p, *q;
+	struct pattern **rest, **emitof;
 
 	nrest = 0;
 	rest = xcalloc(npatterns, sizeof *rest);
+	emitof = xcalloc(npatterns, sizeof *emitof);
 
-	printf("char *cg_emitstrs[] = {\n");
+	SIMPLEQ_FOREACH(r, &rules, r_glolink) {
+		SIMPLEQ_FOREACH(p, &r->r_patterns, p_rlink) {
+			if (p->p_emit[0] == '\0')
+				continue;
+			for (i = 0; i < nrest; i++) {
+				if (samecode(rest[i]->p_emit, p->p_emit))
+					break;
+			}
+			if (i == nrest) {
+				rest[nrest++] = p;
+				print_emit(p);
+			}
+			emitof[p->p_id] = rest[i];
+		}
+	}
+	printf("%su_char *cg_emitstrs%s[] = {\n", TABLE);
 	SIMPLEQ_FOREACH(r, &rules, r_glolink) {
 		SIMPLEQ_FOREACH(p, &r->r_patterns, p_rlink) {
 			if (p->p_emit[0] != '\0')
-				printf("\t%s,\n", p->p_emit);
+				printf("\tcg_emit_%d,\n", emitof[p->p_id]->p_id);
 			else
 				printf("\tNULL,\n");
 		}
 	}
 	printf("\n};\n");
+	if (iflag)
+		printf("u_char **cg_emitstrs = cg_emitstrs0;\n");
 
-	printf("int8_t cg_hasaction[] = {");
+	nrest = 0;
+	printf("%sint8_t cg_hasaction%s[] = {", TABLE);
 	SIMPLEQ_FOREACH(r, &rules, r_glolink) {
 		SIMPLEQ_FOREACH(p, &r->r_patterns, p_rlink) {
 			if (col >= 78) {
@@ -718,41 +1015,355 @@ print_cg_actionemit(void)
 		}
 	}
 	printf("\n};\n");
+	if (iflag)
+		printf("int8_t *cg_hasaction = cg_hasaction0;\n");
 
 	printf("\nCGI_IR *\n");
 	printf("cg_actionemit(CGI_CTX *ctx, CGI_IR *insn, CGI_IR *n, "
 	    "int p)\n{\n");
 	printf("\tstruct cg_ctx nctx = { insn, n, n, ctx };\n");
-#if 0
-	printf("\tchar *emitstr = NULL;\n");
-#endif
 	printf("\tswitch (p) {\n");
 
 	for (i = 0; i < nrest; i++) {
-		p = rest[i];
-		printf("\tcase %d:\n", p->p_id);
-#if 0
-		if (p->p_emit[0] != '\0')
-			printf("\t\temitstr = %s;\n", p->p_emit);
-#endif
-		if (p->p_action[0] != '\0')
-			printf("\t\t%s;\n", p->p_action);
+		if ((p = rest[i]) == NULL)
+			continue;
+		for (j = i; j < nrest; j++) {
+			if ((q = rest[j]) == NULL ||
+			    !samecode(p->p_action, q->p_action))
+				continue;
+			printf("\tcase %d:\n", q->p_id);
+			rest[j] = NULL;
+		}
+		printf("\t\t%s;\n", p->p_action);
 		printf("\t\tbreak;\n");
 	}
 
 	printf("\tdefault:\n");
 	printf("\t\tCGI_FATALX(\"cg_actionemit: bad pattern: %%d\", p);\n");
 	printf("\t}\n");
-#if 0
-	printf("\tif (emitstr != NULL)\n");
-	printf("\t\tCGI_IREMIT(node, emitstr);\n");
-#endif
 	printf("\treturn nctx.cc_newnode;\n");
 	printf("}\n");
 
+	free(emitof);
 	free(rest);
 }
 
+/*
+ * The cost of each pattern per cost model, for estimating the cost of
+ * a cover. Dynamic costs count as 1.
+ */
+static void
+print_cg_pattern_cost(void)
+{
+	int i;
+	short cost[P_MAXCOSTS];
+	struct pattern *p;
+	struct rule *r;
+
+	printf("\n%sshort cg_pattern_cost%s[][CG_NCOSTMODELS] = {\n", TABLE);
+	SIMPLEQ_FOREACH(r, &rules, r_glolink) {
+		SIMPLEQ_FOREACH(p, &r->r_patterns, p_rlink) {
+			if (!constcost(p, cost)) {
+				for (i = 0; i < NCOSTS; i++)
+					cost[i] = 1;
+			}
+			printf("\t{");
+			for (i = 0; i < NCOSTS; i++)
+				printf(" %d%s", cost[i], i + 1 < NCOSTS ? "," : "");
+			printf(" },\t/* %d */\n", p->p_id);
+		}
+	}
+	printf("};\n");
+	if (iflag)
+		printf("short (*cg_pattern_cost)[CG_NCOSTMODELS] = "
+		    "cg_pattern_cost0;\n");
+}
+
+static void
+print_cg_ntnames(void)
+{
+	int i;
+
+	printf("\nchar *cg_ntnames[] = {\n");
+	for (i = 0; i < nterms; i++)
+		printf("\t\"%s\",\n", ntermnames[i]);
+	printf("};\n");
+}
+
+/* Names of patterns for the selector's profile. */
+static void
+print_cg_profile(void)
+{
+	int i;
+	char buf[P_MAXSTR];
+	struct pattern *p;
+	struct rule *r;
+
+	printf("\nchar *cg_pattern_names[] = {\n");
+	SIMPLEQ_FOREACH(r, &rules, r_glolink) {
+		SIMPLEQ_FOREACH(p, &r->r_patterns, p_rlink) {
+			treestr(buf, sizeof buf, p->p_tree);
+			printf("\t\"");
+			for (i = 0; buf[i] != '\0'; i++) {
+				if (buf[i] == '"' || buf[i] == '\\')
+					putchar('\\');
+				putchar(buf[i]);
+			}
+			printf("\",\t/* %d */\n", p->p_id);
+		}
+	}
+	printf("};\n\nshort cg_pattern_nt[] = {");
+	emitbyte(NULL);
+	SIMPLEQ_FOREACH(r, &rules, r_glolink) {
+		SIMPLEQ_FOREACH(p, &r->r_patterns, p_rlink)
+			emitbyte("%d", r->r_nterm);
+	}
+	printf("\n};\n\nint8_t cg_pattern_chain[] = {");
+	emitbyte(NULL);
+	SIMPLEQ_FOREACH(r, &rules, r_glolink) {
+		SIMPLEQ_FOREACH(p, &r->r_patterns, p_rlink)
+			emitbyte("%d", p->p_tree->t_kind == T_NTERM);
+	}
+	printf("\n};\n");
+}
+
+/*
+ * Strip leading and trailing white space and semicolons from code.
+ * Returns the length of the rest, which starts at *start.
+ */
+static size_t
+trimcode(const char *code, const char **start)
+{
+	const char *e;
+
+	while (isspace((unsigned char)*code))
+		code++;
+	for (e = code + strlen(code); e > code; e--) {
+		if (!isspace((unsigned char)e[-1]) && e[-1] != ';')
+			break;
+	}
+	*start = code;
+	return e - code;
+}
+
+static int
+samecode(const char *a, const char *b)
+{
+	size_t alen, blen;
+
+	alen = trimcode(a, &a);
+	blen = trimcode(b, &b);
+	return alen == blen && memcmp(a, b, alen) == 0;
+}
+
+/*
+ * Translate the emit string of p into the bytecode that ir_emit
+ * interprets, see comp/ir.h.
+ */
+static void
+print_emit(struct pattern *p)
+{
+	static const char *flagnames[] = {
+		"D", "CGI_EMIT_SGN", "F", "CGI_EMIT_FRAMEREG",
+		"O", "CGI_EMIT_OFF", "P", "CGI_EMIT_PRIMREG",
+		"S", "CGI_EMIT_SECREG", "U", "CGI_EMIT_UNSG",
+		"W", "CGI_EMIT_WORD", "X", "CGI_EMIT_HEX", NULL
+	};
+	char str[P_MAXSTR], lit[P_MAXSTR], path[P_MAXSTR], fbuf[256];
+	char *e, *op, *s;
+	const char **fl;
+	int flags;
+	size_t i, j, len, nlit, npath;
+
+	len = unquote(p, str);
+	for (s = p->p_emit; isspace((unsigned char)*s); s++)
+		continue;
+	for (e = s + strlen(s); e > s && isspace((unsigned char)e[-1]); e--)
+		continue;
+	if (tflag)
+		printf("emit");
+	else {
+		printf("/* %.*s */\n", (int)(e - s), s);
+		printf("static u_char cg_emit_%d[] = {", p->p_id);
+	}
+	emitbyte(NULL);
+	for (i = nlit = 0; i < len; i++) {
+		if (str[i] != '@' || str[i + 1] == '@') {
+			if (str[i] == '@')
+				i++;
+			lit[nlit++] = str[i];
+			continue;
+		}
+		print_lit(lit, nlit);
+		nlit = 0;
+
+		for (i++, npath = 0; i < len && strchr("ALR", str[i]); i++)
+			path[npath++] = str[i];
+		for (flags = 0; i < len; i++) {
+			for (fl = flagnames; *fl != NULL; fl += 2) {
+				if (**fl == str[i])
+					break;
+			}
+			if (*fl == NULL)
+				break;
+			flags |= 1 << (fl - flagnames) / 2;
+		}
+		switch (str[i]) {
+		case 'T':
+			op = "CGI_EMIT_SELF";
+			break;
+		case 'Y':
+			op = "CGI_EMIT_TMP";
+			if (!isdigit((unsigned char)str[i + 1]))
+				errx(1, "pattern %d: bad temporary register",
+				    p->p_id);
+			break;
+		case 'Z':
+			op = "CGI_EMIT_MD";
+			if (!isupper((unsigned char)str[i + 1]) ||
+			    !isupper((unsigned char)str[i + 2]))
+				errx(1, "pattern %d: bad machine-dependent "
+				    "operand", p->p_id);
+			break;
+		default:
+			if (npath == 0)
+				errx(1, "pattern %d: unknown control char: %c",
+				    p->p_id, str[i]);
+			op = "CGI_EMIT_NODE";
+			i--;
+		}
+
+		emitbyte("%s", op);
+		emitbyte("%zu", npath);
+		for (j = 0; j < npath; j++)
+			emitbyte(tflag ? "%d" : "'%c'", path[j]);
+		if (str[i] == 'Y')
+			emitbyte("%c", str[++i]);
+		else if (str[i] == 'Z') {
+			emitbyte(tflag ? "%d" : "'%c'", 'Z');
+			emitbyte(tflag ? "%d" : "'%c'", str[++i]);
+			emitbyte(tflag ? "%d" : "'%c'", str[++i]);
+		} else {
+			fbuf[0] = '\0';
+			for (fl = flagnames; *fl != NULL; fl += 2) {
+				if (!(flags & 1 << (fl - flagnames) / 2))
+					continue;
+				if (fbuf[0] != '\0')
+					strlcat(fbuf, tflag ? "|" : " | ",
+					    sizeof fbuf);
+				strlcat(fbuf, fl[1], sizeof fbuf);
+			}
+			emitbyte("%s", fbuf[0] != '\0' ? fbuf : "0");
+		}
+	}
+	print_lit(lit, nlit);
+	emitbyte("CGI_EMIT_END");
+	printf(tflag ? "\n" : "\n};\n\n");
+}
+
+static void
+print_lit(char *lit, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (i % UCHAR_MAX == 0) {
+			emitbyte("CGI_EMIT_LIT");
+			emitbyte("%zu", len - i < UCHAR_MAX ? len - i : UCHAR_MAX);
+		}
+		if (tflag)
+			emitbyte("%d", (unsigned char)lit[i]);
+		else if (lit[i] == '\t')
+			emitbyte("'\\t'");
+		else if (lit[i] == '\n')
+			emitbyte("'\\n'");
+		else if (lit[i] == '\'' || lit[i] == '\\')
+			emitbyte("'\\%c'", lit[i]);
+		else if (isprint((unsigned char)lit[i]))
+			emitbyte("'%c'", lit[i]);
+		else
+			emitbyte("%d", (unsigned char)lit[i]);
+	}
+}
+
+/* Print an element of an array initializer. NULL starts a new array. */
+static void
+emitbyte(const char *fmt, ...)
+{
+	static int col, first;
+	char buf[256];
+	int len;
+	va_list ap;
+
+	if (fmt == NULL) {
+		col = 78;
+		first = 1;
+		return;
+	}
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof buf, fmt, ap);
+	va_end(ap);
+	if (tflag) {
+		printf(" %s", buf);
+		return;
+	}
+	if (!first)
+		printf(",");
+	first = 0;
+	if (col + len + 2 > 78) {
+		printf("\n\t");
+		col = 8;
+	} else {
+		printf(" ");
+		col += 2;
+	}
+	printf("%s", buf);
+	col += len;
+}
+
+/* Concatenate the string literals of the emit string of p into str. */
+static size_t
+unquote(struct pattern *p, char *str)
+{
+	char *s = p->p_emit;
+	size_t len = 0;
+	int c, i;
+
+	for (;;) {
+		while (isspace((unsigned char)*s))
+			s++;
+		if (*s == '\0')
+			break;
+		if (*s++ != '"')
+			errx(1, "pattern %d: emit is not a string", p->p_id);
+		while ((c = *s++) != '"') {
+			if (c == '\0')
+				errx(1, "pattern %d: unterminated string",
+				    p->p_id);
+			if (c == '\\') {
+				switch (c = *s++) {
+				case 'n':
+					c = '\n';
+					break;
+				case 't':
+					c = '\t';
+					break;
+				case '0': case '1': case '2': case '3':
+				case '4': case '5': case '6': case '7':
+					c -= '0';
+					for (i = 0; i < 2 && *s >= '0' && *s <= '7';
+					    i++)
+						c = c * 8 + *s++ - '0';
+					break;
+				}
+			}
+			str[len++] = c;
+		}
+	}
+	str[len] = '\0';
+	return len;
+}
+
 static void
 print_cg_match(void)
 {
@@ -785,10 +1396,7 @@ print_cg_trie(struct triehead *th, int ind)
 			if (nonterms[p->p_rule->r_nterm].n_noclosure)
 				iprintf(ind + 1, "int old = cost0;\n");
 
-			if (p->p_cost[0] != '\0')
-				iprintf(ind + 1, "tmp = %s;\n", p->p_cost);
-			else
-				iprintf(ind + 1, "tmp = 1;\n");
+			iprintf(ind + 1, "tmp = %s;\n", costexpr(p));
 			if (nonterms[p->p_rule->r_nterm].n_noclosure) {
 				iprintf(ind + 1, "cost0 += tmp;\n");
 				iprintf(ind + 1,
@@ -845,7 +1453,7 @@ print_cg_nterm(struct trie *trie, int ind)
 {
 	iprintf(ind, "ir%d = CGI_IRCHILD(ir%d, %d);\n",
 	    trie->t_depth, trie->t_depth - 1, trie->t_kid);
-	iprintf(ind, "tmp = CGI_GETDATA(ir%d)->cd_cost[CG_NT_%s];\n",
+	iprintf(ind, "tmp = CG_COST(CGI_GETDATA(ir%d), CG_NT_%s);\n",
 	    trie->t_depth, ntermnames[trie->t_id]);
 	iprintf(ind, "if (tmp < CG_MAXCOST) {\n");
 	iprintf(ind + 1, "int old = cost0;\n\n");
@@ -872,12 +1480,8 @@ print_cg_chains(int ind, int nterm, int costno)
 		else
 			printf(") {\n");
 
-		if (p->p_cost[0] != '\0')
-			iprintf(ind + 1, "int cost%d = cost%d + %s;\n\n",
-			    next, costno, p->p_cost);
-		else
-			iprintf(ind + 1, "int cost%d = cost%d + 1;\n\n",
-			    next, costno);
+		iprintf(ind + 1, "int cost%d = cost%d + %s;\n\n",
+		    next, costno, costexpr(p));
 
 		iprintf(ind + 1,
 		    "if (cg_addmatch(CGI_DATA(ir0), CG_NT_%s, %d, cost%d)",
@@ -889,6 +1493,536 @@ print_cg_chains(int ind, int nterm, int costno)
 	return next;
 }
 
+/*
+ * A cost is either an expression that holds for all cost models or a
+ * vector like { size: 3, lat: 1 } with an expression per cost model.
+ * Models missing from a vector cost 1.
+ */
+static void
+split_costs(void)
+{
+	int i;
+	char *s;
+	struct pattern *p;
+	struct rule *r;
+
+	SIMPLEQ_FOREACH(r, &rules, r_glolink) {
+		SIMPLEQ_FOREACH(p, &r->r_patterns, p_rlink) {
+			if (p->p_cost[0] == '\0')
+				continue;
+			for (s = p->p_cost; isspace((unsigned char)*s); s++)
+				continue;
+			if (isalpha((unsigned char)*s)) {
+				while (isalnum((unsigned char)*s) || *s == '_')
+					s++;
+				while (isspace((unsigned char)*s))
+					s++;
+			}
+			if (*s != ':' || s[1] == ':') {
+				for (i = 0; i < NCOSTS; i++)
+					p->p_costv[i] = p->p_cost;
+				continue;
+			}
+			if (ncostmodels == 0)
+				errx(1, "pattern %d: cost vector without "
+				    "%%costmodel", p->p_id);
+			for (s = p->p_cost; s != NULL;)
+				s = split_cost(p, s);
+		}
+	}
+}
+
+/*
+ * Store the expression of the first name: expr pair of a cost vector
+ * at s in p. Returns the start of the next pair or NULL.
+ */
+static char *
+split_cost(struct pattern *p, char *s)
+{
+	int depth, i;
+	char *e, *name;
+	size_t len;
+
+	while (isspace((unsigned char)*s))
+		s++;
+	for (name = s; isalnum((unsigned char)*s) || *s == '_'; s++)
+		continue;
+	len = s - name;
+	for (i = 0; i < ncostmodels; i++) {
+		if (strlen(costmodels[i]) == len &&
+		    strncmp(costmodels[i], name, len) == 0)
+			break;
+	}
+	if (i == ncostmodels)
+		errx(1, "pattern %d: unknown cost model: %.*s", p->p_id,
+		    (int)len, name);
+	if (p->p_costv[i] != NULL)
+		errx(1, "pattern %d: cost model %s given twice", p->p_id,
+		    costmodels[i]);
+	while (isspace((unsigned char)*s))
+		s++;
+	if (*s++ != ':')
+		errx(1, "pattern %d: `:' expected after %s", p->p_id,
+		    costmodels[i]);
+	for (e = s, depth = 0; *e != '\0'; e++) {
+		if (*e == '(' || *e == '[')
+			depth++;
+		else if (*e == ')' || *e == ']')
+			depth--;
+		else if (*e == ',' && depth == 0)
+			break;
+	}
+	p->p_costv[i] = xmalloc(e - s + 1);
+	memcpy(p->p_costv[i], s, e - s);
+	p->p_costv[i][e - s] = '\0';
+	return *e == ',' ? e + 1 : NULL;
+}
+
+/* The C expression for the cost of p under the active cost model. */
+static const char *
+costexpr(struct pattern *p)
+{
+	static char buf[P_MAXSTR * (P_MAXCOSTS + 1)];
+	int i;
+	size_t len;
+
+	if (p->p_cost[0] == '\0')
+		return "1";
+	for (i = 1; i < NCOSTS; i++) {
+		if (p->p_costv[i] != p->p_costv[0])
+			break;
+	}
+	if (i == NCOSTS)
+		return p->p_costv[0];
+	buf[0] = '\0';
+	for (i = NCOSTS - 1; i >= 0; i--) {
+		len = strlen(buf);
+		if (i > 0)
+			snprintf(buf + len, sizeof buf - len,
+			    "%scg_costmodel == %d ? (%s) : ", i == NCOSTS - 1 ?
+			    "(" : "", i, p->p_costv[i] != NULL ?
+			    p->p_costv[i] : "1");
+		else
+			snprintf(buf + len, sizeof buf - len, "(%s))",
+			    p->p_costv[0] != NULL ? p->p_costv[0] : "1");
+	}
+	return buf;
+}
+
+/*
+ * Returns 1 and stores the costs of p per cost model in cost if they
+ * are constant.
+ */
+static int
+constcost(struct pattern *p, short *cost)
+{
+	int i;
+	long val;
+	char *e;
+
+	for (i = 0; i < NCOSTS; i++) {
+		cost[i] = 1;
+		if (p->p_costv[i] == NULL)
+			continue;
+		val = strtol(p->p_costv[i], &e, 10);
+		while (isspace((unsigned char)*e))
+			e++;
+		if (e == p->p_costv[i] || *e != '\0' || val < 0 ||
+		    val > SHRT_MAX)
+			return 0;
+		cost[i] = val;
+	}
+	return 1;
+}
+
+/*
+ * Split the patterns into rules with one-level trees. Each inner node of
+ * a pattern tree becomes a rule for a new nonterminal with cost 0. Equal
+ * fragments share their nonterminal. A constrained nonterminal leaf
+ * becomes a chain rule with the constraint.
+ */
+static int
+normalize(void)
+{
+	short cost[P_MAXCOSTS];
+	struct pattern *p;
+	struct rule *r;
+
+	nallnts = nterms;
+	SIMPLEQ_FOREACH(r, &rules, r_glolink) {
+		SIMPLEQ_FOREACH(p, &r->r_patterns, p_rlink) {
+			if (!constcost(p, cost)) {
+				if (p->p_tree->t_kind == T_NTERM) {
+					warnx("chain rule with cost, "
+					    "not generating automaton");
+					return 0;
+				}
+				dynops[p->p_tree->t_id] = 1;
+				continue;
+			}
+			normtree(p->p_tree, r->r_nterm, p->p_id, cost);
+		}
+	}
+	return 1;
+}
+
+static int
+normtree(struct tree *t, int nt, int pattern, const short *cost)
+{
+	static const short nocost[P_MAXCOSTS];
+	int i;
+	struct nrule *nr, r;
+
+	if (t->t_kind == T_NTERM && t->t_constr[0] == '\0' && nt == -1)
+		return t->t_id;
+
+	r.n_op = -1;
+	r.n_kids[0] = r.n_kids[1] = -1;
+	if (t->t_kind == T_NTERM)
+		r.n_kids[0] = t->t_id;
+	else {
+		r.n_op = t->t_id;
+		for (i = 0; i < t->t_nkids; i++)
+			r.n_kids[i] = normtree(t->t_kids[i], -1, -1, nocost);
+	}
+	r.n_pred = t->t_constr[0] != '\0' ? predidx(t->t_constr) : -1;
+	memcpy(r.n_cost, cost, sizeof r.n_cost);
+	r.n_pattern = pattern;
+
+	if (nt == -1) {
+		for (nr = nrules; nr < &nrules[nnrules]; nr++) {
+			if (nr->n_pattern == -1 && nr->n_op == r.n_op &&
+			    nr->n_kids[0] == r.n_kids[0] &&
+			    nr->n_kids[1] == r.n_kids[1] &&
+			    nr->n_pred == r.n_pred)
+				return nr->n_nt;
+		}
+		nt = nallnts++;
+	}
+	if (nnrules == NRULESMAX)
+		errx(1, "too many normalized rules");
+	r.n_nt = nt;
+	nrules[nnrules++] = r;
+	return nt;
+}
+
+static int
+predidx(const char *constr)
+{
+	int i;
+
+	for (i = 0; i < npreds; i++) {
+		if (strcmp(preds[i], constr) == 0)
+			return i;
+	}
+	if (npreds == PREDSMAX)
+		errx(1, "too many different constraints for automaton");
+	preds[npreds] = (char *)constr;
+	return npreds++;
+}
+
+static void
+print_automaton(FILE *hfp)
+{
+	fprintf(hfp, "\n#define CG_AUTOMATON\n");
+	fprintf(hfp, "#define CG_NALLNTS\t%d\n",
+	    iflag ? nallnts + INTERP_NTS : nallnts);
+	fprintf(hfp, "\nstruct cg_rule {\n");
+	fprintf(hfp, "\tshort\tcr_nt;\n");
+	fprintf(hfp, "\tshort\tcr_op;\n");
+	fprintf(hfp, "\tshort\tcr_kids[2];\n");
+	fprintf(hfp, "\tshort\tcr_cost[CG_NCOSTMODELS];\n");
+	fprintf(hfp, "\tshort\tcr_pattern;\n");
+	fprintf(hfp, "\tshort\tcr_pred;\n");
+	fprintf(hfp, "};\n");
+	fprintf(hfp, "extern struct cg_rule %scg_rules%s;\n",
+	    iflag ? "*" : "", iflag ? "" : "[]");
+	fprintf(hfp, "extern int cg_nrules;\n");
+	fprintf(hfp, "int cg_predmask(CGI_IR *, u_int *);\n");
+	fprintf(hfp, "int cg_chainpred(CGI_IR *, int);\n");
+	if (iflag) {
+		fprintf(hfp, "\nstruct cg_opname {\n");
+		fprintf(hfp, "\tchar\t*co_name;\n");
+		fprintf(hfp, "\tint\tco_op;\n");
+		fprintf(hfp, "};\n");
+		fprintf(hfp, "extern struct cg_opname cg_opnames[];\n");
+		fprintf(hfp, "extern char *cg_predtexts[];\n");
+		fprintf(hfp, "extern char *cg_actiontexts[];\n");
+		fprintf(hfp, "int cg_pred(CGI_IR *, int);\n");
+	}
+
+	if (gflag) {
+		printf("\n#if 0\n");
+		print_nrules();
+		printf("#endif\n");
+	}
+
+	print_cg_predmask();
+	if (iflag)
+		print_cg_interp();
+}
+
+static void
+print_nrules(void)
+{
+	int i;
+	struct nrule *nr;
+
+	for (nr = nrules; nr < &nrules[nnrules]; nr++) {
+		if (nr->n_nt < nterms)
+			printf("%s: ", ntermnames[nr->n_nt]);
+		else
+			printf("_f%d: ", nr->n_nt);
+		if (nr->n_op != -1)
+			printf("%s", treenames[nr->n_op]);
+		for (i = 0; i < T_MAXKIDS; i++) {
+			if (nr->n_kids[i] == -1)
+				continue;
+			printf(i == 0 ? "(" : ", ");
+			if (nr->n_kids[i] < nterms)
+				printf("%s", ntermnames[nr->n_kids[i]]);
+			else
+				printf("_f%d", nr->n_kids[i]);
+		}
+		if (nr->n_op != -1 && nr->n_kids[0] != -1)
+			printf(")");
+		if (nr->n_pred != -1)
+			printf(" [%s]", preds[nr->n_pred]);
+		printf(" =");
+		for (i = 0; i < NCOSTS; i++)
+			printf(" %d", nr->n_cost[i]);
+		printf(" /* pattern %d */\n", nr->n_pattern);
+	}
+}
+
+/*
+ * Generate the rule table, cg_predmask(), which evaluates the constraints
+ * of the rules for the operator of a node, and cg_chainpred() for the
+ * constraints of chain rules. The latter must only be evaluated if the
+ * nonterminal on the right side matches, like in cg_match.
+ */
+static void
+print_cg_predmask(void)
+{
+	int i, op;
+	struct nrule *nr;
+
+	printf("\n%sstruct cg_rule cg_rules%s[] = {\n", TABLE);
+	for (nr = nrules; nr < &nrules[nnrules]; nr++) {
+		printf("\t{ %d, %s, { %d, %d }, {",
+		    nr->n_nt, nr->n_op == -1 ? "-1" : treenames[nr->n_op],
+		    nr->n_kids[0], nr->n_kids[1]);
+		for (i = 0; i < NCOSTS; i++)
+			printf(" %d%s", nr->n_cost[i], i + 1 < NCOSTS ? "," : "");
+		printf(" }, %d, %d },\n", nr->n_pattern, nr->n_pred);
+	}
+	printf("};\n\n");
+	if (iflag)
+		printf("struct cg_rule *cg_rules = cg_rules0;\n");
+	printf("int cg_nrules = %d;\n", nnrules);
+
+	printf("\nint\ncg_predmask(CGI_IR *n, u_int *mask)\n{\n");
+	printf("\tu_int m = 0;\n\n");
+	printf("\tswitch (CGI_IROP(n)) {\n");
+	for (op = 0; op < MAXIDS && treenames[op] != NULL; op++) {
+		if (dynops[op]) {
+			printf("\tcase %s:\n\t\treturn -1;\n", treenames[op]);
+			continue;
+		}
+		for (nr = nrules; nr < &nrules[nnrules]; nr++) {
+			if (nr->n_op == op && nr->n_pred != -1)
+				break;
+		}
+		if (nr == &nrules[nnrules])
+			continue;
+		printf("\tcase %s:\n", treenames[op]);
+		for (i = 0; i < npreds; i++) {
+			for (nr = nrules; nr < &nrules[nnrules]; nr++) {
+				if (nr->n_op == op && nr->n_pred == i)
+					break;
+			}
+			if (nr == &nrules[nnrules])
+				continue;
+			printf("\t\tif (%s)\n\t\t\tm |= 0x%xU;\n",
+			    preds[i], 1U << i);
+		}
+		printf("\t\tbreak;\n");
+	}
+	printf("\t}\n");
+	printf("\t*mask = m;\n");
+	printf("\treturn 0;\n}\n");
+
+	printf("\nint\ncg_chainpred(CGI_IR *n, int pred)\n{\n");
+	printf("\tswitch (pred) {\n");
+	for (i = 0; i < npreds; i++) {
+		for (nr = nrules; nr < &nrules[nnrules]; nr++) {
+			if (nr->n_op == -1 && nr->n_pred == i)
+				break;
+		}
+		if (nr == &nrules[nnrules])
+			continue;
+		printf("\tcase %d:\n\t\treturn %s;\n", i, preds[i]);
+	}
+	printf("\tdefault:\n\t\t");
+	printf("CGI_FATALX(\"cg_chainpred: bad constraint: %%d\", pred);\n");
+	printf("\t}\n}\n");
+}
+
+/*
+ * For a compiler that can load the grammar at run time, see
+ * comp/cgi_load.c: The operators, all constraints, and the action of
+ * each pattern. A loaded grammar refers to them by name and text.
+ */
+static void
+print_cg_interp(void)
+{
+	int i, op;
+	size_t len;
+	const char *code;
+	struct pattern *p;
+	struct rule *r;
+
+	printf("\nstruct cg_opname cg_opnames[] = {\n");
+	for (op = 0; op < MAXIDS && treenames[op] != NULL; op++)
+		printf("\t{ \"%s\", %s },\n", treenames[op], treenames[op]);
+	printf("\t{ NULL, -1 }\n};\n");
+
+	printf("\nchar *cg_predtexts[] = {\n");
+	for (i = 0; i < npreds; i++) {
+		printf("\t\"");
+		print_text(preds[i], strlen(preds[i]));
+		printf("\",\n");
+	}
+	printf("\tNULL\n};\n");
+
+	printf("\nint\ncg_pred(CGI_IR *n, int pred)\n{\n");
+	printf("\tswitch (pred) {\n");
+	for (i = 0; i < npreds; i++)
+		printf("\tcase %d:\n\t\treturn %s;\n", i, preds[i]);
+	printf("\tdefault:\n\t\t");
+	printf("CGI_FATALX(\"cg_pred: bad constraint: %%d\", pred);\n");
+	printf("\t}\n}\n");
+
+	printf("\nchar *cg_actiontexts[] = {\n");
+	SIMPLEQ_FOREACH(r, &rules, r_glolink) {
+		SIMPLEQ_FOREACH(p, &r->r_patterns, p_rlink) {
+			if (p->p_action[0] == '\0') {
+				printf("\tNULL,\t/* %d */\n", p->p_id);
+				continue;
+			}
+			len = trimcode(p->p_action, &code);
+			printf("\t\"");
+			print_text(code, len);
+			printf("\",\t/* %d */\n", p->p_id);
+		}
+	}
+	printf("};\n");
+}
+
+/*
+ * Print the normalized grammar as a table, one item per line. Leaves
+ * of patterns are given by their path from the root, in prefix order.
+ */
+static void
+print_table(void)
+{
+	int i;
+	size_t len;
+	short cost[P_MAXCOSTS];
+	char path[P_MAXSTR];
+	const char *code;
+	struct nrule *nr;
+	struct pattern *p;
+	struct rule *r;
+
+	if (!normalize())
+		exit(1);
+	for (i = 0; i < MAXIDS; i++) {
+		if (dynops[i])
+			errx(1, "%s: dynamic costs cannot be loaded",
+			    treenames[i]);
+	}
+
+	printf("cgg-table 1\n");
+	printf("models %d", ncostmodels);
+	for (i = 0; i < ncostmodels; i++)
+		printf(" %s", costmodels[i]);
+	printf("\nnterms %d %d\n", nterms, nallnts);
+	for (i = 0; i < nterms; i++)
+		printf("nterm %s\n", ntermnames[i]);
+	printf("preds %d\n", npreds);
+	for (i = 0; i < npreds; i++) {
+		printf("pred ");
+		print_text(preds[i], strlen(preds[i]));
+		printf("\n");
+	}
+
+	printf("patterns %d\n", npatterns);
+	SIMPLEQ_FOREACH(r, &rules, r_glolink) {
+		SIMPLEQ_FOREACH(p, &r->r_patterns, p_rlink) {
+			constcost(p, cost);
+			printf("pattern %d", p->p_id);
+			for (i = 0; i < NCOSTS; i++)
+				printf(" %d", cost[i]);
+			print_table_leaves(p->p_tree, path, 0);
+			printf("\n");
+			if (p->p_emit[0] != '\0')
+				print_emit(p);
+			if (p->p_action[0] != '\0') {
+				len = trimcode(p->p_action, &code);
+				printf("action ");
+				print_text(code, len);
+				printf("\n");
+			}
+		}
+	}
+
+	printf("rules %d\n", nnrules);
+	for (nr = nrules; nr < &nrules[nnrules]; nr++) {
+		printf("rule %d %s %d %d %d %d", nr->n_nt,
+		    nr->n_op == -1 ? "-" : treenames[nr->n_op],
+		    nr->n_kids[0], nr->n_kids[1], nr->n_pattern, nr->n_pred);
+		for (i = 0; i < NCOSTS; i++)
+			printf(" %d", nr->n_cost[i]);
+		printf("\n");
+	}
+	printf("end\n");
+}
+
+static void
+print_table_leaves(struct tree *t, char *path, int depth)
+{
+	int i;
+
+	if (t->t_kind == T_NTERM) {
+		path[depth] = '\0';
+		printf(" %s %d", depth == 0 ? "." : path, t->t_id);
+		return;
+	}
+	for (i = 0; i < t->t_nkids; i++) {
+		path[depth] = '0' + i;
+		print_table_leaves(t->t_kids[i], path, depth + 1);
+	}
+}
+
+/* Print text with the escapes of a C string. */
+static void
+print_text(const char *text, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (text[i] == '\n')
+			printf("\\n");
+		else if (text[i] == '\t')
+			printf("\\t");
+		else if (text[i] == '"' || text[i] == '\\')
+			printf("\\%c", text[i]);
+		else
+			putchar(text[i]);
+	}
+}
+
 static void
 print_trie(struct triehead *th, int indent)
 {
@@ -946,23 +2080,42 @@ printgrammar(void)
 
 static void
 printtree(struct tree *t)
+{
+	char buf[P_MAXSTR];
+
+	treestr(buf, sizeof buf, t);
+	printf("%s", buf);
+}
+
+static void
+treestr(char *buf, size_t size, struct tree *t)
+{
+	buf[0] = '\0';
+	treecat(buf, size, t);
+}
+
+static void
+treecat(char *buf, size_t size, struct tree *t)
 {
 	int i;
 
 	if (t->t_kind == T_TERM)
-		printf("%s", treenames[t->t_id]);
+		strlcat(buf, treenames[t->t_id], size);
 	else
-		printf("%s", ntermnames[t->t_id]);
-	if (t->t_constr[0] != '\0')
-		printf("[%s]", t->t_constr);
+		strlcat(buf, ntermnames[t->t_id], size);
+	if (t->t_constr[0] != '\0') {
+		strlcat(buf, "[", size);
+		strlcat(buf, t->t_constr, size);
+		strlcat(buf, "]", size);
+	}
 	if (t->t_nkids != 0) {
-		printf("(");
+		strlcat(buf, "(", size);
 		for (i = 0; i < t->t_nkids; i++) {
-			printtree(t->t_kids[i]);
+			treecat(buf, size, t->t_kids[i]);
 			if (i != t->t_nkids - 1)
-				printf(", ");
+				strlcat(buf, ", ", size);
 		}
-		printf(")");
+		strlcat(buf, ")", size);
 	}
 }
 
@@ -1006,37 +2159,73 @@ pattern(struct tree *t)
 	p = xmalloc(sizeof *p);
 	p->p_tree = t;
 	p->p_action[0] = p->p_cost[0] = p->p_emit[0] = '\0';
+	memset(p->p_costv, 0, sizeof p->p_costv);
 	p->p_id = npatterns++;
 	p->p_ntsidx = 0;
 	t->t_pattern = p;
 	return p;
 }
 
-void
-pattern_addace(struct pattern *p, int op, int idx, int ch)
+char *
+pattern_ace(struct pattern *p, int op)
 {
-	char *buf;
-
 	switch (op) {
 	case TOK_ACTION:
-		buf = p->p_action;
-		break;
+		return p->p_action;
 	case TOK_COST:
-		buf = p->p_cost;
-		break;
+		return p->p_cost;
 	case TOK_EMIT:
-		buf = p->p_emit;
-		break;
+		return p->p_emit;
 	default:
-		errx(1, "pattern_addace");
+		errx(1, "pattern_ace");
 	}
+}
+
+void
+costmodel(const char *name)
+{
+	int i;
 
-	if (idx >= P_MAXSTR) {
-		errh("pattern_addace: too many chars for buffer: %s", buf);
+	for (i = 0; i < ncostmodels; i++) {
+		if (strcmp(costmodels[i], name) == 0) {
+			errh("cost model %s redeclared", name);
+			return;
+		}
+	}
+	if (ncostmodels == P_MAXCOSTS) {
+		errh("too many cost models");
 		return;
 	}
-	buf[idx] = ch;
-	buf[idx + 1] = '\0';
+	if ((costmodels[ncostmodels++] = strdup(name)) == NULL)
+		err(1, "strdup");
+}
+
+char *
+fragment(int op, const char *name)
+{
+	struct fragment *f;
+
+	if (findfragment(op, name) != NULL)
+		errh("fragment %s redefined", name);
+	f = xmalloc(sizeof *f);
+	if ((f->f_name = strdup(name)) == NULL)
+		err(1, "strdup");
+	f->f_kind = op;
+	f->f_text[0] = '\0';
+	SIMPLEQ_INSERT_TAIL(&fragments, f, f_link);
+	return f->f_text;
+}
+
+char *
+findfragment(int op, const char *name)
+{
+	struct fragment *f;
+
+	SIMPLEQ_FOREACH(f, &fragments, f_link) {
+		if (f->f_kind == op && strcmp(f->f_name, name) == 0)
+			return f->f_text;
+	}
+	return NULL;
 }
 
 struct tree *
@@ -1203,6 +2392,7 @@ usage(void)
 {
 	extern char *__progname;
 
-	fprintf(stderr, "usage: %s infile cfile hfile\n", __progname);
+	fprintf(stderr, "usage: %s [-agip] infile cfile hfile\n"
+	    "       %s -t infile tablefile\n", __progname, __progname);
 	exit(1);
 }
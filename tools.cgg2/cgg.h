@@ -28,10 +28,15 @@
 #define TOK_LVERB	260
 #define TOK_RVERB	261
 #define TOK_PERC	262
-#define TOK_END		262
+#define TOK_PACTION	263
+#define TOK_PCOST	264
+#define TOK_PEMIT	265
+#define TOK_PCOSTMODEL	266
+#define TOK_END		266
 
 extern char *tokstr;
 extern size_t lineno;
+extern int tflag;
 
 int yylex(void);
 void verbatim(void);
@@ -60,6 +65,7 @@ struct rule *rule(const char *);
 void rule_addpattern(struct rule *, struct pattern *);
 
 #define P_MAXSTR	2048
+#define P_MAXCOSTS	8
 
 struct pattern {
 	SIMPLEQ_ENTRY(pattern) p_rlink;
@@ -70,12 +76,17 @@ struct pattern {
 	char	p_action[P_MAXSTR];
 	char	p_cost[P_MAXSTR];
 	char	p_emit[P_MAXSTR];
+	char	*p_costv[P_MAXCOSTS];	/* cost per cost model */
 	short	p_id;
 	short	p_ntsidx;
 };
 
 struct pattern *pattern(struct tree *);
-void pattern_addace(struct pattern *, int, int, int);
+char *pattern_ace(struct pattern *, int);
+
+void costmodel(const char *);
+char *fragment(int, const char *);
+char *findfragment(int, const char *);
 
 #define T_MAXKIDS	2
 #define T_MAXSTR	256
@@ -17,24 +17,28 @@
 #include <ctype.h>
 #include <err.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "cgg.h"
 
 static int tok;
 
 static char *toknames[] = {
-	"identifier", "cost", "emit", "action", "%{", "%}", "%%"
+	"identifier", "cost", "emit", "action", "%{", "%}", "%%",
+	"%action", "%cost", "%emit", "%costmodel"
 };
 
 static int gettok(void);
 static void expect(int);
 static void synexpect(const char *);
 
+static void parsefragments(void);
 static void parserules(void);
 static void parsepatterns(struct rule *);
 static struct tree *parsetree(void);
 static void parseconstraint(struct tree *);
 static void parseace(struct pattern *);
+static void parsecode(char *);
 
 static int
 gettok(void)
@@ -86,25 +90,75 @@ parse(void)
 		for (gettok(); tok != TOK_RVERB; gettok()) {
 			if (tok == 0)
 				fatalsynh("premature end of file");
-			putchar(tok);
+			if (!tflag)
+				putchar(tok);
 		}
 		noverbatim();
 		gettok();
 	}
 
+	parsefragments();
 	expect(TOK_PERC);
 	parserules();
 	verbatim();
 	if (tok != TOK_PERC)
 		synexpect("%%");
 	gettok();
-	printf("\n");
+	if (!tflag)
+		printf("\n");
 	verbatim();
-	for (gettok(); tok != 0; gettok())
-		putchar(tok);
+	for (gettok(); tok != 0; gettok()) {
+		if (!tflag)
+			putchar(tok);
+	}
 	noverbatim();
 }
 
+/*
+ * Named fragments: %action name { code }, %cost name { expr } and
+ * %emit name { "string" }. Patterns refer to them with action name,
+ * cost name and emit name. %costmodel name, ... declares the columns
+ * of cost vectors.
+ */
+static void
+parsefragments(void)
+{
+	int op;
+	char *buf;
+
+	for (;;) {
+		switch (tok) {
+		case TOK_PACTION:
+			op = TOK_ACTION;
+			break;
+		case TOK_PCOST:
+			op = TOK_COST;
+			break;
+		case TOK_PEMIT:
+			op = TOK_EMIT;
+			break;
+		case TOK_PCOSTMODEL:
+			do {
+				if (gettok() != TOK_ID) {
+					synexpect("cost model");
+					return;
+				}
+				costmodel(tokstr);
+			} while (gettok() == ',');
+			continue;
+		default:
+			return;
+		}
+		if (gettok() != TOK_ID) {
+			synexpect("fragment name");
+			return;
+		}
+		buf = fragment(op, tokstr);
+		gettok();
+		parsecode(buf);
+	}
+}
+
 static void
 parserules(void)
 {
@@ -198,31 +252,55 @@ parseconstraint(struct tree *t)
 static void
 parseace(struct pattern *p)
 {
-	int braces, i, op;
+	int op;
+	char *frag;
 
 	for (;;) {
 		if (tok != TOK_ACTION && tok != TOK_COST && tok != TOK_EMIT)
 			return;
 		op = tok;
-		gettok();
-		verbatim();
-		if (tok != '{')
-			synexpect("{");
-		else
+		if (gettok() == TOK_ID) {
+			if ((frag = findfragment(op, tokstr)) == NULL)
+				errh("unknown %s fragment: %s",
+				    toknames[op - TOK_START], tokstr);
+			else
+				strlcpy(pattern_ace(p, op), frag, P_MAXSTR);
 			gettok();
-		for (braces = 1, i = 0; braces != 0; gettok(), i++) {
-			if (tok == 0)
-				fatalsynh("premature end of file");
-			else if (tok == '{')
-				braces++;
-			else if (tok == '}') {
-				if (--braces == 0) {
-					noverbatim();
-					gettok();
-					break;
-				}
+			continue;
+		}
+		parsecode(pattern_ace(p, op));
+	}
+}
+
+/* Copy the text between { and the matching } into buf. */
+static void
+parsecode(char *buf)
+{
+	int braces, i;
+
+	verbatim();
+	if (tok != '{')
+		synexpect("{");
+	else
+		gettok();
+	buf[0] = '\0';
+	for (braces = 1, i = 0; braces != 0; gettok(), i++) {
+		if (tok == 0)
+			fatalsynh("premature end of file");
+		else if (tok == '{')
+			braces++;
+		else if (tok == '}') {
+			if (--braces == 0) {
+				noverbatim();
+				gettok();
+				break;
 			}
-			pattern_addace(p, op, i, tok);
 		}
+		if (i >= P_MAXSTR - 1) {
+			errh("parsecode: too many chars for buffer: %s", buf);
+			continue;
+		}
+		buf[i] = tok;
+		buf[i + 1] = '\0';
 	}
 }
@@ -28,16 +28,19 @@ int yylex(void);
 void yyerror(const char *);
 %}
 
-%token TOK_CLASS TOK_CONFLICTS TOK_IDENT TOK_OF TOK_VOLATILE
+%token TOK_CLASS TOK_CONFLICTS TOK_COST TOK_IDENT TOK_LIMIT TOK_NUM TOK_OF
+%token TOK_ORDER TOK_VOLATILE
 
 %union {
 	char	*y_str;
+	int	y_num;
 	struct	regq *y_regq;
 	struct	regclass *y_rclass;
 }
 
 %type <y_str> TOK_IDENT
-%type <y_regq> reglist
+%type <y_num> TOK_NUM volat cost limit
+%type <y_regq> reglist conflicts order
 
 %%
 
@@ -48,13 +51,21 @@ regs:	reg
 	| regs reg
 	;
 
-reg:	TOK_IDENT ';'				{ regdef($1, 0, NULL); }
-	| TOK_IDENT TOK_CONFLICTS reglist ';'	{ regdef($1, 0, $3); }
-	| TOK_VOLATILE TOK_IDENT ';'		{ regdef($2, 1, NULL); }
-	| TOK_VOLATILE TOK_IDENT TOK_CONFLICTS reglist ';'
-	    { regdef($2, 1, $4); }
+reg:	volat TOK_IDENT cost conflicts ';'	{ regdef($2, $1, $3, $4); }
 	;
 
+volat:	/* empty */		{ $$ = 0; }
+	| TOK_VOLATILE		{ $$ = 1; }
+	;
+
+cost:	/* empty */		{ $$ = -1; }
+	| TOK_COST TOK_NUM	{ $$ = $2; }
+	;
+
+conflicts:	/* empty */		{ $$ = NULL; }
+		| TOK_CONFLICTS reglist	{ $$ = $2; }
+		;
+
 reglist:	TOK_IDENT		{ $$ = regq($1); }
 		| reglist ',' TOK_IDENT { $$ = $1; regq_enq($1, $3); }
 		;
@@ -63,7 +74,16 @@ classes:	class
 		| classes class
 		;
 
-class:	TOK_CLASS TOK_IDENT '=' '{' reglist '}' ';'	{ regclass($2, $5); }
+class:	TOK_CLASS TOK_IDENT '=' '{' reglist '}' order limit ';'
+	    { regclass($2, $5, $7, $8); }
+	;
+
+order:	/* empty */			{ $$ = NULL; }
+	| TOK_ORDER '{' reglist '}'	{ $$ = $3; }
+	;
+
+limit:	/* empty */		{ $$ = -1; }
+	| TOK_LIMIT TOK_NUM	{ $$ = $2; }
 	;
 
 %%
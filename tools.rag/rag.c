@@ -34,6 +34,9 @@ static int nclasses;
 
 static void calcpq(void);
 static void printconflicts(void);
+static void printmask(int8_t *);
+static void printorder(void);
+static void printpressure(void);
 static struct reg *reg(char *);
 static struct regdef *regdef_find(char *);
 static void *xmalloc(size_t);
@@ -45,6 +48,7 @@ main(int argc, char **argv)
 {
 	char *p;
 	int i;
+	int8_t *mask;
 	struct reg *r;
 	struct regdef *rd;
 	struct regclass *rc;
@@ -134,62 +138,187 @@ main(int argc, char **argv)
 	}
 
 	fprintf(hfilefp, "\n");
-	printf("struct regset reg_nonvolat;\n");
-	printf("struct regset reg_volat;\n");
-	printf("struct regset regclasses[%d];\n", nclasses);
+	mask = xcalloc(nregs, sizeof *mask);
+	SIMPLEQ_FOREACH(rd, &regdefs, r_link)
+		mask[rd->r_id] = !rd->r_volatile;
+	printf("struct regset reg_nonvolat = ");
+	printmask(mask);
+	printf(";\n");
+	for (i = 0; i < nregs; i++)
+		mask[i] = !mask[i];
+	printf("struct regset reg_volat = ");
+	printmask(mask);
+	printf(";\n");
+	printf("struct regset regclasses[%d] = {\n", nclasses);
+	SIMPLEQ_FOREACH(rc, &regclasses, r_link) {
+		memset(mask, 0, nregs * sizeof *mask);
+		SIMPLEQ_FOREACH(r, rc->r_regs, r_link)
+			mask[r->r_def->r_id] = 1;
+		printf("\t");
+		printmask(mask);
+		if (SIMPLEQ_NEXT(rc, r_link) != NULL)
+			printf(",");
+		printf("\n");
+	}
+	printf("};\n\n");
+	free(mask);
 
 	printf("void\nreginit(void)\n{\n");
 	printf("\tint i;\n");
-	printf("\n\n");
+	printf("\n");
 	printf("\tfor (i = 0; i < REG_NREGS; i++)\n");
 	printf("\t\tphysregs[i] = ir_physregsym(regnames[i], i);\n");
-	printf("\n\tregset_init(&reg_nonvolat);\n");
-	printf("\tregset_init(&reg_volat);\n");
-	SIMPLEQ_FOREACH(rd, &regdefs, r_link) {
-		if (!rd->r_volatile)
-			printf("\tregset_addreg(&reg_nonvolat, %d);\n",
-			    rd->r_id);
-		else
-			printf("\tregset_addreg(&reg_volat, %d);\n", rd->r_id);
-	}
-	SIMPLEQ_FOREACH(rc, &regclasses, r_link) {
-		printf("\tregset_init(&regclasses[%d]);\n", rc->r_id);
-		SIMPLEQ_FOREACH(r, rc->r_regs, r_link)
-			printf("\tregset_addreg(&regclasses[%d], %d);\n",
-			    rc->r_id, r->r_def->r_id);
-	}
-	printf("}\n");
+	printf("}\n\n");
 
 	printconflicts();
+	printorder();
+	printpressure();
 	calcpq();
 	fprintf(hfilefp, "#endif /* REG_H */\n");
 	fprintf(hfilefp, "#endif /* REG_NREGS_ONLY */\n");
 	return 0;
 }
 
+/*
+ * Print a statically initialized struct regset with the bits set
+ * that are nonzero in mask.
+ */
+static void
+printmask(int8_t *mask)
+{
+	int i, j, nelem;
+	unsigned int bits;
+
+	nelem = (nregs + 31) / 32;
+	printf("{ REG_NREGS, %d, {", nelem);
+	for (i = 0; i < nelem; i++) {
+		bits = 0;
+		for (j = 0; j < 32 && i * 32 + j < nregs; j++) {
+			if (mask[i * 32 + j])
+				bits |= 1U << j;
+		}
+		printf(" 0x%08xU", bits);
+		if (i != nelem - 1)
+			printf(",");
+	}
+	printf(" } }");
+}
+
+/*
+ * For each register, print the set of registers it conflicts with.
+ * The allocator can then block or test all overlapping registers
+ * with a few word operations.
+ */
 static void
 printconflicts(void)
 {
-	int i, j;
+	int i;
 
-	fprintf(hfilefp, "extern short *reg_conflicts[];\n");
+	fprintf(hfilefp, "extern struct regset reg_confsets[];\n");
 
+	printf("struct regset reg_confsets[] = {\n");
 	for (i = 0; i < nregs; i++) {
-		printf("static short reg%dconf[] = {", i);
-		for (j = 0; j < nregs; j++) {
-			if (conflict[i][j])
-				printf(" %d,", j);
-		}
-		printf(" -1 };\n");
+		printf("\t");
+		printmask(conflict[i]);
+		if (i != nregs - 1)
+			printf(",");
+		printf("\t/* %%%s */\n", linregdef[i]->r_name);
 	}
-	printf("\nshort *reg_conflicts[] = {\n");
+	printf("};\n\n");
+}
+
+/*
+ * Print the register costs and the order in which the allocator tries
+ * the registers of each class. Values whose live ranges do not cross a
+ * call should go into volatile registers, which need not be saved. For
+ * values that are live across calls, callee-saved registers come first.
+ * Within each group, the order given in the specification is kept.
+ */
+static void
+printorder(void)
+{
+	int call, i, pass;
+	struct reg *r;
+	struct regclass *rc;
+	static const char *names[] = { "order", "callorder" };
+
+	fprintf(hfilefp, "extern int reg_cost[];\n");
+	fprintf(hfilefp, "extern short *reg_order[];\n");
+	fprintf(hfilefp, "extern short *reg_callorder[];\n");
+
+	printf("int reg_cost[] = {");
 	for (i = 0; i < nregs; i++) {
-		printf("\treg%dconf", i);
+		printf(" %d", linregdef[i]->r_cost);
 		if (i != nregs - 1)
 			printf(",");
-		printf("\n");
 	}
-	printf("};\n");
+	printf(" };\n\n");
+
+	SIMPLEQ_FOREACH(rc, &regclasses, r_link) {
+		for (call = 0; call < 2; call++) {
+			printf("static short class%d%s[] = {", rc->r_id,
+			    names[call]);
+			for (pass = 0; pass < 2; pass++) {
+				SIMPLEQ_FOREACH(r, rc->r_order, r_link) {
+					if (r->r_def->r_volatile ==
+					    (pass == call))
+						printf(" %d,", r->r_def->r_id);
+				}
+			}
+			printf(" -1 };\n");
+		}
+	}
+	for (call = 0; call < 2; call++) {
+		printf("\nshort *reg_%s[] = {\n", names[call]);
+		SIMPLEQ_FOREACH(rc, &regclasses, r_link) {
+			printf("\tclass%d%s", rc->r_id, names[call]);
+			if (SIMPLEQ_NEXT(rc, r_link) != NULL)
+				printf(",");
+			printf("\n");
+		}
+		printf("};\n");
+	}
+	printf("\n");
+}
+
+/*
+ * Print the number of values of each class that can be held in
+ * registers at the same time. Unless the specification gives a limit,
+ * this is the number of registers of the class that do not overlap.
+ */
+static void
+printpressure(void)
+{
+	int *chosen, i, n;
+	struct reg *r;
+	struct regclass *rc;
+
+	fprintf(hfilefp, "extern int reg_plimit[];\n");
+
+	chosen = xcalloc(nregs, sizeof *chosen);
+	printf("int reg_plimit[] = {");
+	SIMPLEQ_FOREACH(rc, &regclasses, r_link) {
+		n = 0;
+		SIMPLEQ_FOREACH(r, rc->r_order, r_link) {
+			for (i = 0; i < n; i++) {
+				if (conflict[chosen[i]][r->r_def->r_id])
+					break;
+			}
+			if (i == n)
+				chosen[n++] = r->r_def->r_id;
+		}
+		if (rc->r_limit != -1) {
+			if (rc->r_limit == 0 || rc->r_limit > n)
+				errx(1, "class %s: limit %d not in 1..%d",
+				    rc->r_name, rc->r_limit, n);
+			n = rc->r_limit;
+		}
+		printf(" %d", n);
+		if (SIMPLEQ_NEXT(rc, r_link) != NULL)
+			printf(",");
+	}
+	printf(" };\n\n");
+	free(chosen);
 }
 
 static void
@@ -286,12 +415,16 @@ regdef_find(char *name)
 	rd->r_name = name;
 	rd->r_id = -1;
 	rd->r_volatile = 0;
+	rd->r_cost = 0;
 	SIMPLEQ_INSERT_TAIL(&regdefs, rd, r_link);
 	return rd;
 }
 
+/*
+ * A callee-saved register costs one save and restore by default.
+ */
 void
-regdef(char *name, int volat, struct regq *conflicts)
+regdef(char *name, int volat, int cost, struct regq *conflicts)
 {
 	struct regdef *rd;
 
@@ -303,14 +436,18 @@ regdef(char *name, int volat, struct regq *conflicts)
 	rd->r_id = nextid++;
 	rd->r_conflicts = conflicts;
 	rd->r_volatile = volat;
+	rd->r_cost = cost == -1 ? !volat : cost;
 	nregs++;
 }
 
+/*
+ * Registers of the class that are missing in the order are tried last.
+ */
 void
-regclass(char *name, struct regq *regs)
+regclass(char *name, struct regq *regs, struct regq *order, int limit)
 {
 	int n = 0;
-	struct reg *r;
+	struct reg *r, *r2;
 	struct regclass *rc;
 
 	static int nextid;
@@ -322,11 +459,34 @@ regclass(char *name, struct regq *regs)
 	n = 0;
 	SIMPLEQ_FOREACH(r, regs, r_link)
 		n++;
+	if (order == NULL)
+		order = regs;
+	else {
+		SIMPLEQ_FOREACH(r, order, r_link) {
+			SIMPLEQ_FOREACH(r2, regs, r_link) {
+				if (r->r_def == r2->r_def)
+					break;
+			}
+			if (r2 == NULL)
+				errx(1, "register %s is not in class %s",
+				    r->r_def->r_name, name);
+		}
+		SIMPLEQ_FOREACH(r, regs, r_link) {
+			SIMPLEQ_FOREACH(r2, order, r_link) {
+				if (r->r_def == r2->r_def)
+					break;
+			}
+			if (r2 == NULL)
+				regq_enq(order, r->r_def->r_name);
+		}
+	}
 	rc = xmalloc(sizeof *rc);
 	rc->r_regs = regs;
+	rc->r_order = order;
 	rc->r_name = name;
 	rc->r_id = nextid++;
 	rc->r_nregs = n;
+	rc->r_limit = limit;
 	SIMPLEQ_INSERT_TAIL(&regclasses, rc, r_link);
 	nclasses++;
 }
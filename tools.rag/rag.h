@@ -27,6 +27,7 @@ struct regdef {
 	struct	regq *r_conflicts;
 	int	r_id;
 	int	r_volatile;
+	int	r_cost;
 };
 
 struct reg {
@@ -37,14 +38,16 @@ struct reg {
 struct regclass {
 	SIMPLEQ_ENTRY(regclass) r_link;
 	struct	regq *r_regs;
+	struct	regq *r_order;
 	char	*r_name;
 	int	r_id;
 	int	r_nregs;
+	int	r_limit;
 };
 
 struct regq *regq(char *);
 void regq_enq(struct regq *, char *);
-void regdef(char *, int, struct regq *);
-void regclass(char *, struct regq *);
+void regdef(char *, int, int, struct regq *);
+void regclass(char *, struct regq *, struct regq *, int);
 
 #endif /* TOOLS_RAG_RAG_H */